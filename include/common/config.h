@@ -6,5 +6,9 @@
 #define DEFAULT_BUFFER 16
 #define DEFAULT_INPUT_PATH "./input"
 #define DEFAULT_OUTPUT_PATH "./output"
+#define BLOCK_SIZE (STATE_SIZE * STATE_SIZE)
+#define BLOCK_HEX_SIZE (BLOCK_SIZE * 2)
+#define STREAM_BUFFER_SIZE (64 * 1024)
+#define STDIO_PATH "-"
 
 #endif /* UTILS_CONFIG_H */
\ No newline at end of file
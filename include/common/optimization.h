@@ -20,12 +20,14 @@ typedef struct {
 extern OptimizationSettings g_opt_settings;
 
 void init_optimization_settings(OptimizationSettings* settings);
+void detect_optimization_settings(OptimizationSettings* settings);
+const OptimizationSettings* get_optimization_settings(void);
 
 void* get_optimal_implementation(void* original_func, 
     void* sse2_func, 
     void* avx_func,
     void* avx2_func,
-    OptimizationSettings* settings);
+    const OptimizationSettings* settings);
 
 const char* get_optimization_level_name(OptimizationLevel level);
 
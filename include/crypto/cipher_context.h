@@ -0,0 +1,52 @@
+#ifndef CRYPTO_CIPHER_CONTEXT_H
+#define CRYPTO_CIPHER_CONTEXT_H
+
+#include <stddef.h>
+#include "../../include/common/config.h"
+
+typedef enum {
+    AXON_ENCRYPT = 0,
+    AXON_DECRYPT = 1
+} AxonCipherMode;
+
+// Incremental form of chain_encryptor/chain_decryptor. Input may be fed in
+// slices of any size; output is produced as soon as whole blocks are
+// available, straight into the caller's buffer. The context owns no heap
+// memory, so it can live on the stack and be reused after axon_cipher_init.
+typedef struct {
+    AxonCipherMode mode;
+    char chain_key[BLOCK_HEX_SIZE + 1];
+    char state_rows[STATE_SIZE][STATE_SIZE];
+    unsigned char partial[BLOCK_HEX_SIZE];
+    size_t partial_len;
+    unsigned char held_block[BLOCK_SIZE];
+    int has_held_block;
+} AxonCipherContext;
+
+int axon_cipher_init(AxonCipherContext* ctx, AxonCipherMode mode, const char* password);
+// Starts the chain from a raw 16-byte key instead of a password, e.g. a
+// file's data key
+int axon_cipher_init_key(AxonCipherContext* ctx, AxonCipherMode mode, const char key[BLOCK_SIZE]);
+// The key a password chain starts from
+int axon_password_key(const char* password, char key_out[BLOCK_SIZE]);
+// One raw block under key, outside any chain (key derivation and wrapping)
+void axon_encrypt_block(const char key[BLOCK_SIZE], const unsigned char in[BLOCK_SIZE],
+                        unsigned char out[BLOCK_SIZE]);
+size_t axon_cipher_output_bound(const AxonCipherContext* ctx, size_t in_len);
+int axon_cipher_update(AxonCipherContext* ctx, const unsigned char* in, size_t in_len,
+                       unsigned char* out, size_t out_capacity, size_t* out_len);
+int axon_cipher_final(AxonCipherContext* ctx, unsigned char* out, size_t out_capacity, size_t* out_len);
+void axon_cipher_wipe(AxonCipherContext* ctx);
+
+// Payload size of the chain alone, as in the container formats
+size_t axon_encrypted_size(size_t plain_len);
+// In-memory counterpart of a container file: header with a wrapped random
+// data key, payload and MAC trailer. Decryption checks the key and the MAC
+// before producing anything and returns exactly the sealed length.
+size_t axon_sealed_size(size_t plain_len);
+int axon_encrypt_buffer(const unsigned char* in, size_t in_len, const char* password,
+                        unsigned char* out, size_t out_capacity, size_t* out_len);
+int axon_decrypt_buffer(const unsigned char* in, size_t in_len, const char* password,
+                        unsigned char* out, size_t out_capacity, size_t* out_len);
+
+#endif // CRYPTO_CIPHER_CONTEXT_H
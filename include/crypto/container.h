@@ -0,0 +1,61 @@
+#ifndef CRYPTO_CONTAINER_H
+#define CRYPTO_CONTAINER_H
+
+#include <stddef.h>
+#include "../../include/common/config.h"
+
+// Files written by the stream engine start with a fixed-size text header:
+//   "AXON" <version: 2 hex> <flags: 4 hex> <key check value: 16 hex>
+//   [version 2: <salt: 32 hex> <wrapped data key: 32 hex>] "\n"
+// 'X', 'O' and 'N' are not hex digits, so a legacy headerless file can
+// never be mistaken for one.
+//
+// Version 1 chains start from the password. Version 2 chains start from a
+// random per-file data key, stored XORed with E_password(salt); changing
+// the password only rewrites this header (see container_rekey).
+#define CONTAINER_MAGIC "AXON"
+#define CONTAINER_VERSION 2
+#define CONTAINER_V1_HEADER_SIZE 27
+#define CONTAINER_HEADER_SIZE 91
+#define CONTAINER_PREFIX_SIZE 10  // magic, version and flags
+#define KCV_HEX_SIZE 16
+// Flag bits
+#define CONTAINER_FLAG_MAC 0x0001  // payload is followed by a MAC trailer (see mac.h)
+#define CONTAINER_FLAG_SPARSE 0x0002  // payload is an extent table and data extents (see sparse.h)
+#define CONTAINER_FLAG_COMPRESSED 0x0004  // plaintext is a sequence of compressed segments (see compress.h)
+#define CONTAINER_KNOWN_FLAGS (CONTAINER_FLAG_MAC | CONTAINER_FLAG_SPARSE | CONTAINER_FLAG_COMPRESSED)
+#define WRONG_KEY_FAILURE "Wrong key: the key check value does not match\n"
+
+typedef struct {
+    unsigned int version;
+    unsigned int flags;
+    char kcv[KCV_HEX_SIZE + 1];
+    char salt[BLOCK_HEX_SIZE + 1];
+    char wrapped_key[BLOCK_HEX_SIZE + 1];
+} ContainerHeader;
+
+// Fills a header for password. Costs one block encryption.
+int container_header_init(ContainerHeader* header, const char* password);
+size_t container_header_size(const ContainerHeader* header);
+void container_header_format(const ContainerHeader* header, char out[CONTAINER_HEADER_SIZE]);
+// The header as the MAC sees it: in version 2 the key slot (check value,
+// salt, wrapped key) is blanked so that rekeying leaves the tag valid
+void container_header_format_authenticated(const ContainerHeader* header, char out[CONTAINER_HEADER_SIZE]);
+// Full header length announced by the first CONTAINER_PREFIX_SIZE bytes,
+// or 0 when data has no magic
+size_t container_header_length(const unsigned char* data, size_t len);
+// 1 when data holds a header, 0 when it has no magic (legacy raw hex),
+// -1 when it has the magic but cannot be read
+int container_header_parse(const unsigned char* data, size_t len, ContainerHeader* header);
+int container_key_matches(const ContainerHeader* found, const ContainerHeader* expected);
+
+// Version 2 key slot. password_key is axon_password_key of the password.
+int container_wrap_key(ContainerHeader* header, const char password_key[BLOCK_SIZE], const char data_key[BLOCK_SIZE]);
+int container_unwrap_key(const ContainerHeader* header, const char password_key[BLOCK_SIZE], char data_key[BLOCK_SIZE]);
+// Re-wraps the data key of the file at path under new_password, in place.
+// The new header is journaled to <path>.rekey first; rerunning the same
+// rekey after a crash finishes it from there.
+#define CONTAINER_REKEY_SUFFIX ".rekey"
+int container_rekey(const char* path, const char* old_password, const char* new_password);
+
+#endif // CRYPTO_CONTAINER_H
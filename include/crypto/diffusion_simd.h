@@ -3,6 +3,8 @@
 
 void mix_columns_simd(char** state);
 void init_diffusion_simd(void);
+// Name of the mix_columns implementation the dispatcher chose
+const char* mix_columns_kernel(void);
 
 void mix_columns_sse2(char** state);
 void mix_columns_avx(char** state); 
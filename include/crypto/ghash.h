@@ -0,0 +1,48 @@
+#ifndef CRYPTO_GHASH_H
+#define CRYPTO_GHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GHASH_BLOCK_SIZE 16
+
+// GHASH from GCM: a polynomial hash over GF(2^128) keyed by H. Blocks are
+// folded in as Y = (Y ^ X) * H, so independently hashed segments combine
+// as Y = Y_left * H^n ^ Y_right, where n is the right segment's block count.
+typedef struct {
+    uint64_t h_hi;
+    uint64_t h_lo;
+    uint64_t table_hi[16];  // multiples of H for the 4-bit table method
+    uint64_t table_lo[16];
+} GhashKey;
+
+typedef struct {
+    const GhashKey* key;
+    uint64_t y_hi;
+    uint64_t y_lo;
+    unsigned char partial[GHASH_BLOCK_SIZE];
+    size_t partial_len;
+    unsigned long long total_len;
+} GhashState;
+
+void ghash_key_init(GhashKey* key, const unsigned char h[GHASH_BLOCK_SIZE]);
+void ghash_start(GhashState* state, const GhashKey* key);
+void ghash_update(GhashState* state, const void* data, size_t len);
+// Zero-pads a trailing partial block and returns Y without the length block
+void ghash_flush(GhashState* state, unsigned char y_out[GHASH_BLOCK_SIZE]);
+
+// Y over the whole blocks hashed so far, and a state continuing from such
+// a Y after total_len bytes (a multiple of the block size)
+void ghash_peek(const GhashState* state, unsigned char y_out[GHASH_BLOCK_SIZE]);
+void ghash_resume(GhashState* state, const GhashKey* key, const unsigned char y[GHASH_BLOCK_SIZE],
+                  unsigned long long total_len);
+
+// Helpers for joining segment results
+void ghash_multiply(unsigned char x[GHASH_BLOCK_SIZE], const unsigned char y[GHASH_BLOCK_SIZE]);
+void ghash_power(const GhashKey* key, unsigned long long n, unsigned char out[GHASH_BLOCK_SIZE]);
+
+void init_ghash(void);
+// Name of the block function the dispatcher chose
+const char* ghash_kernel(void);
+
+#endif // CRYPTO_GHASH_H
@@ -0,0 +1,45 @@
+#ifndef CRYPTO_MAC_H
+#define CRYPTO_MAC_H
+
+#include <stddef.h>
+#include "../../include/common/config.h"
+#include "../../include/crypto/ghash.h"
+
+// Authenticated files end with a fixed-size text trailer:
+//   "MAC" <plaintext length: 16 hex> <tag: 32 hex> "\n"
+// The tag is E_Kt(GHASH_H(header || payload || "MAC" || length)), with H
+// and Kt derived from the key the file's chain starts from. GHASH splits
+// into segments that can be hashed on separate threads and joined afterwards.
+#define MAC_TRAILER_MAGIC "MAC"
+#define MAC_TRAILER_SIZE 52
+#define MAC_AUTHENTICATED_PREFIX 19
+#define MAC_TAG_HEX_SIZE 32
+#define MAC_FAILURE "Integrity check failed: the file was modified or damaged\n"
+
+typedef struct {
+    GhashKey hash_key;
+    char tag_key[BLOCK_SIZE];
+} MacKey;
+
+typedef struct {
+    GhashState ghash;
+} MacState;
+
+void mac_key_init(MacKey* key, const char file_key[BLOCK_SIZE]);
+void mac_key_wipe(MacKey* key);
+
+void mac_start(MacState* state, const MacKey* key);
+void mac_update(MacState* state, const void* data, size_t len);
+// Builds the trailer, hashing its authenticated prefix on the way
+void mac_finish(MacState* state, const MacKey* key, unsigned long long plain_length,
+                char trailer[MAC_TRAILER_SIZE]);
+
+// Tag for a message whose flushed GHASH value (no length block) is y
+void mac_tag_from_hash(const MacKey* key, const unsigned char y[GHASH_BLOCK_SIZE],
+                       unsigned long long message_length, char tag_hex[MAC_TAG_HEX_SIZE + 1]);
+int mac_parse_trailer(const unsigned char* trailer, unsigned long long* plain_length,
+                      char tag_hex[MAC_TAG_HEX_SIZE + 1]);
+// Constant time, so a forger learns nothing from how fast a guess fails
+int mac_tags_equal(const char* a, const char* b);
+
+#endif // CRYPTO_MAC_H
@@ -0,0 +1,22 @@
+#ifndef CRYPTO_MULTIBUFFER_H
+#define CRYPTO_MULTIBUFFER_H
+
+#include <stddef.h>
+#include "../../include/crypto/cipher_context.h"
+
+#define MULTI_BUFFER_LANES 8
+
+// Encrypts one block for each of up to MULTI_BUFFER_LANES independent
+// chains in lockstep. keys[i] is lane i's chain key, as passed to
+// single_state_encyption; the result equals running it once per lane.
+void multi_buffer_encrypt_blocks(const unsigned char* const* blocks, const char* const* keys,
+                                 unsigned char* const* cipher_out, size_t num_lanes);
+
+// axon_cipher_update for several contexts at once. Encryption contexts
+// advance their full blocks through the lockstep kernel; decryption
+// contexts are processed one after another.
+int axon_cipher_update_lanes(AxonCipherContext* const* ctxs, const unsigned char* const* in,
+                             const size_t* in_len, unsigned char* const* out,
+                             const size_t* out_capacity, size_t* out_len, size_t num_lanes);
+
+#endif // CRYPTO_MULTIBUFFER_H
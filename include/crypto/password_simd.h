@@ -4,5 +4,22 @@
 void chunker_sse2(char* key, int size, char* xor_res);
 void chunker_avx(char* key, int size, char* xor_res);
 void chunker_avx2(char* key, int size, char* xor_res);
+void init_password_simd(void);
+// Name of the chunker implementation the dispatcher chose
+const char* chunker_kernel(void);
+
+// What each entry point runs in this build: without its extension it forwards down
+#if defined(__AVX2__)
+#define CHUNKER_AVX2_KERNEL "avx2"
+#elif defined(__AVX__)
+#define CHUNKER_AVX2_KERNEL "avx"
+#else
+#define CHUNKER_AVX2_KERNEL "sse2"
+#endif
+#if defined(__AVX__)
+#define CHUNKER_AVX_KERNEL "avx"
+#else
+#define CHUNKER_AVX_KERNEL "sse2"
+#endif
 
 #endif // PASSWORD_SIMD_H
\ No newline at end of file
@@ -0,0 +1,10 @@
+#ifndef CRYPTO_RANDOM_H
+#define CRYPTO_RANDOM_H
+
+#include <stddef.h>
+
+// Fills out with bytes from the operating system's CSPRNG. Returns 0, or
+// -1 (with a message) when none is available; never falls back to rand().
+int random_bytes(void* out, size_t len);
+
+#endif // CRYPTO_RANDOM_H
@@ -6,6 +6,7 @@ typedef struct {
     int has_sse4_1;
     int has_avx;
     int has_avx2;
+    int has_pclmul;
 } CPUFeatures;
 
 void init_cpu_features(CPUFeatures* features);
@@ -14,5 +15,6 @@ void init_cpu_features(CPUFeatures* features);
 #define HAS_SSE4_1(features) ((features)->has_sse4_1)
 #define HAS_AVX(features) ((features)->has_avx)
 #define HAS_AVX2(features) ((features)->has_avx2)
+#define HAS_PCLMUL(features) ((features)->has_pclmul)
 
 #endif //SIMD_COMPAT_H
\ No newline at end of file
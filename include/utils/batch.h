@@ -0,0 +1,37 @@
+#ifndef UTILS_BATCH_H
+#define UTILS_BATCH_H
+
+#include <stddef.h>
+#include "../../include/crypto/cipher_context.h"
+
+// status is 0 once an entry has been processed, -1 until then or on failure
+#define BATCH_ENTRY_SKIPPED 1
+
+typedef struct {
+    char* source;
+    char* destination;
+    unsigned long long size;
+    int status;
+} BatchEntry;
+
+typedef struct {
+    BatchEntry* entries;
+    size_t count;
+    size_t capacity;
+} BatchPlan;
+
+typedef struct {
+    size_t succeeded;
+    size_t failed;
+    size_t skipped;
+    unsigned long long bytes;
+} BatchResult;
+
+// source is either a directory (walked recursively, mirrored under
+// dest_dir) or a list file with one "source" or "source<TAB>destination"
+// per line
+int batch_plan_load(BatchPlan* plan, const char* source, const char* dest_dir);
+void batch_plan_free(BatchPlan* plan);
+int batch_run(BatchPlan* plan, AxonCipherMode mode, const char* password, size_t num_threads, BatchResult* result);
+
+#endif // UTILS_BATCH_H
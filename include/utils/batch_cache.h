@@ -0,0 +1,48 @@
+#ifndef UTILS_BATCH_CACHE_H
+#define UTILS_BATCH_CACHE_H
+
+#include <stdint.h>
+#include "../../include/utils/batch.h"
+
+#define BATCH_CACHE_MAGIC "AXONCACHE"
+#define BATCH_CACHE_VERSION 1
+
+// Identity of a file on disk: cheap to collect with a single stat
+typedef struct {
+    unsigned long long size;
+    long long mtime_sec;
+    long mtime_nsec;
+    unsigned long long inode;
+} FileStamp;
+
+typedef struct {
+    char* source;
+    char* destination;
+    char mode;
+    uint64_t key_check;
+    FileStamp source_stamp;
+    uint64_t source_hash;
+    FileStamp output_stamp;
+} BatchCacheRecord;
+
+typedef struct {
+    BatchCacheRecord* records;
+    size_t count;
+    size_t sorted_count;
+    size_t capacity;
+    char mode;
+    uint64_t key_check;
+} BatchCache;
+
+// A missing cache file is an empty cache
+int batch_cache_load(BatchCache* cache, const char* path, AxonCipherMode mode, const char* password);
+// Marks entries whose source and output are unchanged since the last run
+// as BATCH_ENTRY_SKIPPED. verify_hash also re-hashes each source.
+size_t batch_cache_apply(BatchCache* cache, BatchPlan* plan, int verify_hash);
+// Records every entry that was processed successfully. Sources are only
+// re-read for their hash when hash_sources is set (--cache-check=hash).
+void batch_cache_record(BatchCache* cache, const BatchPlan* plan, int hash_sources);
+int batch_cache_save(BatchCache* cache, const char* path);
+void batch_cache_free(BatchCache* cache);
+
+#endif // UTILS_BATCH_CACHE_H
@@ -0,0 +1,38 @@
+#ifndef UTILS_BUFFER_POOL_H
+#define UTILS_BUFFER_POOL_H
+
+#include <stddef.h>
+
+// Huge pages are 2 MiB on x86-64 and most arm64 kernels
+#define BUFFER_POOL_ARENA_SIZE (2 * 1024 * 1024)
+#define BUFFER_POOL_ALIGNMENT 4096
+
+typedef struct {
+    unsigned long long hits;    // served from a returned buffer
+    unsigned long long misses;  // carved from fresh memory
+    unsigned long long mapped_bytes;  // mapped right now
+    int huge_pages;             // 1 with MAP_HUGETLB, 2 with transparent huge pages, 0 without
+} BufferPoolStats;
+
+// Window-sized buffers (read, hex, compression frames) for the streaming
+// paths. Fresh memory comes from 2 MiB aligned arenas backed by huge pages
+// where the system has them; a buffer handed back is kept on a free list
+// for its size and reused by the next window or job instead of going back
+// to malloc. Buffers are page aligned.
+//
+// Under --max-memory each mapping is charged to the memory budget whole,
+// and taking a buffer may wait for room there. An arena whose buffers have
+// all come back stays in a small reserve (a quarter of the budget, 8 MiB
+// at most) for the next job, and is unmapped with its charge released
+// once the reserve is full or another caller is waiting for room. Without
+// a limit the pool keeps everything it has mapped.
+void* buffer_pool_get(size_t size);
+// What a buffer of size costs the budget under the current limit: its own
+// pages below 64 MiB, its share of an arena above. Planners size their
+// workers with it.
+size_t buffer_pool_charge(size_t size);
+// size must be the size the buffer was taken with; NULL is ignored
+void buffer_pool_put(void* buffer, size_t size);
+void buffer_pool_stats(BufferPoolStats* stats);
+
+#endif // UTILS_BUFFER_POOL_H
@@ -0,0 +1,26 @@
+#ifndef UTILS_BUNDLE_H
+#define UTILS_BUNDLE_H
+
+#include "../../include/crypto/container.h"
+#include "../../include/utils/batch.h"
+
+// Layout: a fixed text header, every member's ciphertext back to back, then
+// the encrypted index and its MAC trailer. The header holds the magic, a
+// version, the offset and ciphertext length of the index, and a container
+// key slot (check value and the bundle's wrapped random data key). Each
+// index line is "offset<TAB>size<TAB>tag<TAB>name", tag being the MAC of
+// that member's ciphertext. Every member is its own chain, keyed from the
+// data key and its line number, so one member can be extracted and checked
+// without touching the rest of the bundle.
+#define BUNDLE_MAGIC "AXONBNDL"
+#define BUNDLE_VERSION 2
+#define BUNDLE_PREFIX_SIZE 42  // magic, version, index offset and length
+#define BUNDLE_HEADER_SIZE (BUNDLE_PREFIX_SIZE + CONTAINER_HEADER_SIZE)
+
+// source is a directory or file list as accepted by batch_plan_load
+int bundle_pack(const char* source, const char* bundle_path, const char* password, BatchResult* result);
+// member limits extraction to one name; dest may then be - for stdout
+int bundle_extract(const char* bundle_path, const char* dest_dir, const char* member,
+                   const char* password, BatchResult* result);
+
+#endif // UTILS_BUNDLE_H
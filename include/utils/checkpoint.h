@@ -0,0 +1,32 @@
+#ifndef UTILS_CHECKPOINT_H
+#define UTILS_CHECKPOINT_H
+
+#include <stddef.h>
+
+#define CHECKPOINT_SUFFIX ".ckpt"
+#define CHECKPOINT_MAGIC "AXONCKPT"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_DEFAULT_INTERVAL (256ULL * 1024 * 1024)
+
+typedef struct {
+    unsigned long long interval;  // plaintext bytes between checkpoints
+    int resume;
+    size_t threads;               // for re-hashing the output prefix on resume
+} CheckpointOptions;
+
+typedef struct {
+    unsigned long long resumed_at;  // plaintext offset the run started from
+    unsigned long long bytes;
+    size_t checkpoints;
+} CheckpointResult;
+
+// File-to-file encryption that can survive being killed. Every interval
+// bytes the output is synced and <destination>.ckpt records the input
+// offset, output offset and MAC state; the chain state needs no saving,
+// it is the last ciphertext block already in the output. With resume the
+// run continues from the checkpoint once the output prefix hashes to the
+// recorded MAC state. The sidecar is removed when the file is complete.
+int checkpoint_encrypt(const char* source, const char* destination, const char* password,
+                       const CheckpointOptions* options, CheckpointResult* result);
+
+#endif // UTILS_CHECKPOINT_H
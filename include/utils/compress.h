@@ -0,0 +1,52 @@
+#ifndef UTILS_COMPRESS_H
+#define UTILS_COMPRESS_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Optional stage ahead of the cipher. The plaintext is cut into segments
+// that are compressed independently (no shared dictionary), so each one
+// can be handled on its own. Every segment becomes a frame:
+//   <type: 'Z' compressed or 'R' raw> <raw length: u32 LE> <stored length: u32 LE> <stored bytes>
+// A segment that does not shrink is stored raw.
+#define COMPRESS_SEGMENT_SIZE (64 * 1024)
+#define COMPRESS_FRAME_HEADER 9
+#define COMPRESS_FRAME_LZ 'Z'
+#define COMPRESS_FRAME_RAW 'R'
+
+// LZ77 codec in the LZ4 block format: 4-byte minimum match, 64 KiB window,
+// greedy hash-table matching. Fast rather than thorough.
+size_t lz_compress_bound(size_t len);
+// Returns the compressed size, or 0 when it would not fit in capacity
+size_t lz_compress(const unsigned char* in, size_t len, unsigned char* out, size_t capacity);
+// Succeeds only when in decodes to exactly out_len bytes
+int lz_decompress(const unsigned char* in, size_t len, unsigned char* out, size_t out_len);
+
+size_t compress_frame_bound(void);
+// Writes the frame for one segment (at most COMPRESS_SEGMENT_SIZE bytes)
+size_t compress_frame(const unsigned char* segment, size_t len, unsigned char* frame);
+
+typedef int (*compress_write_fn)(void* arg, const unsigned char* data, size_t len);
+
+// Decoding side: fed the framed stream in slices of any size, passes the
+// decompressed bytes on to write
+typedef struct {
+    compress_write_fn write;
+    void* arg;
+    unsigned char header[COMPRESS_FRAME_HEADER];
+    size_t header_len;
+    unsigned char* stored;
+    size_t stored_len;
+    size_t stored_have;
+    unsigned char* raw;
+    size_t raw_len;
+    unsigned char type;
+} Inflater;
+
+int inflater_init(Inflater* inflater, compress_write_fn write, void* arg);
+int inflater_feed(Inflater* inflater, const unsigned char* data, size_t len);
+// Fails when the stream stopped inside a frame
+int inflater_finish(Inflater* inflater);
+void inflater_free(Inflater* inflater);
+
+#endif // UTILS_COMPRESS_H
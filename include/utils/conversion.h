@@ -1,7 +1,11 @@
 #ifndef UTILS_CONVERSION_H
 #define UTILS_CONVERSION_H
 
+#include <stddef.h>
+
 char* bytes_to_hex(const unsigned char* data, size_t len);
 char* hex_to_bytes(const char* hex_string, size_t* out_len);
+void bytes_to_hex_into(const unsigned char* data, size_t len, char* hex_out);
+int hex_to_bytes_into(const char* hex, size_t hex_len, unsigned char* bytes_out);
 
 #endif // UTILS_CONVERSION_H
\ No newline at end of file
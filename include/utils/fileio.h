@@ -4,6 +4,16 @@
 #include <stdio.h>
 #include "../../include/crypto/chunked_file.h"
 
+// An output written under a temporary name in the destination's directory
+// and renamed over it only once complete, so a reader sees either the old
+// file or the whole new one. For STDIO_PATH it is plain stdout.
+typedef struct {
+    FILE* file;
+    char* path;
+    char* temp;
+    unsigned long long reserved;
+} AtomicFile;
+
 FILE* open_file(const char* filename, const char* mode);
 void flush_stream(FILE *file);
 char* read_file(const char* filename);
@@ -14,5 +24,25 @@ void write_file(const char* filename, const char* content, const int content_siz
 int chunk_writer(const char* filename, char** chunks, size_t chunks_len);
 void init_state_from_contents(const char* contents, char** state);
 ChunkedFile file_chunker(const char* filename);
+FILE* open_stream(const char* filename, const char* mode);
+int close_stream(FILE* file);
+int make_parent_dirs(const char* path);
+int is_directory(const char* path);
+int seek_file(FILE* file, unsigned long long offset);
+long long tell_file(FILE* file);
+int replace_file(const char* from, const char* to);
+int sync_file(FILE* file);
+// Makes a rename into path's directory durable; a no-op on Windows
+int sync_parent_dir(const char* path);
+int truncate_file(FILE* file, unsigned long long size);
+int allocate_file(FILE* file, unsigned long long size);
+char* suffixed_path(const char* path, const char* suffix);
+char* temp_path_for(const char* path);
+// expected_size is reserved up front when non-zero (see allocate_file)
+// and need not be exact: commit trims the file at the current position,
+// so a writer that seeks back must return to the end first
+int atomic_open(AtomicFile* out, const char* path, unsigned long long expected_size);
+int atomic_commit(AtomicFile* out);
+void atomic_abort(AtomicFile* out);
 
 #endif // UTILS_FILEIO_H
\ No newline at end of file
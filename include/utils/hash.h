@@ -0,0 +1,22 @@
+#ifndef UTILS_HASH_H
+#define UTILS_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// XXH64: a fast non-cryptographic hash used to fingerprint content. It
+// detects change; it does not authenticate anything.
+typedef struct {
+    uint64_t total_len;
+    uint64_t acc[4];
+    unsigned char buffer[32];
+    size_t buffered;
+    uint64_t seed;
+} Hash64State;
+
+void hash64_init(Hash64State* state, uint64_t seed);
+void hash64_update(Hash64State* state, const void* data, size_t len);
+uint64_t hash64_final(const Hash64State* state);
+uint64_t hash64(const void* data, size_t len, uint64_t seed);
+
+#endif // UTILS_HASH_H
@@ -0,0 +1,36 @@
+#ifndef UTILS_IN_PLACE_H
+#define UTILS_IN_PLACE_H
+
+#include <stddef.h>
+
+#define IN_PLACE_SUFFIX ".journal"
+#define IN_PLACE_MAGIC "AXONJRNL"
+#define IN_PLACE_VERSION 1
+// Plaintext per window; a multiple of STREAM_BUFFER_SIZE
+#define IN_PLACE_WINDOW (4 * 1024 * 1024)
+
+typedef struct {
+    unsigned long long plain_length;
+    unsigned long long file_size;  // after the run
+    size_t windows;
+    int resumed;
+} InPlaceResult;
+
+// Rewrites the file at path without a second copy on disk. Progress is
+// kept in <path>.journal, synced after every window, and a run that finds
+// one resumes from it, so an interrupted run leaves the file recoverable
+// by running the same command again.
+//
+// The ciphertext is twice the plaintext, so encryption grows the file and
+// has to fill it from the end: a forward pass records the chain key at
+// every window and the MAC, then the windows are written back last first,
+// each over plaintext that is already encrypted. Window 0 is the one that
+// overwrites itself; its plaintext is copied into the journal first.
+int in_place_encrypt(const char* path, const char* password, InPlaceResult* result);
+// Checks the MAC first, so nothing is overwritten for a damaged file, then
+// decrypts forward. Windows are kept smaller than the gap between the
+// write and read positions, so a crash never reaches ciphertext that a
+// resumed run still needs.
+int in_place_decrypt(const char* path, const char* password, size_t num_threads, InPlaceResult* result);
+
+#endif // UTILS_IN_PLACE_H
@@ -0,0 +1,35 @@
+#ifndef UTILS_INCREMENTAL_H
+#define UTILS_INCREMENTAL_H
+
+#include <stddef.h>
+
+// Content-defined chunking bounds; a cut is taken where the rolling gear
+// hash has its low CDC_AVERAGE_BITS clear
+#define CDC_MIN_CHUNK (16 * 1024)
+#define CDC_AVERAGE_BITS 16
+#define CDC_MAX_CHUNK (256 * 1024)
+
+#define INCREMENTAL_MANIFEST "manifest"
+#define INCREMENTAL_MAGIC "AXONCDC"
+#define INCREMENTAL_VERSION 2
+
+typedef struct {
+    size_t chunks;
+    size_t reused;
+    size_t written;
+    size_t removed;
+    unsigned long long bytes_in;
+    unsigned long long bytes_written;
+} IncrementalResult;
+
+// A store is a directory holding an encrypted manifest and one ciphertext
+// file per distinct chunk, in a subdirectory per name prefix. The manifest
+// is framed like a container file: its header wraps the store's random data
+// key, from which the chunk, manifest and name keys are derived, and a MAC
+// trailer covers the chunk list. Chunks are named by a keyed MAC of their
+// plaintext. Every chunk is its own chain, so an edit only rewrites the
+// chunks around it.
+int incremental_encrypt(const char* source, const char* store_dir, const char* password, IncrementalResult* result);
+int incremental_decrypt(const char* store_dir, const char* destination, const char* password, IncrementalResult* result);
+
+#endif // UTILS_INCREMENTAL_H
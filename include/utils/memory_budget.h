@@ -0,0 +1,43 @@
+#ifndef UTILS_MEMORY_BUDGET_H
+#define UTILS_MEMORY_BUDGET_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+// Headroom left for what the budget does not track: stdio buffers, thread
+// stacks actually touched, allocator overhead
+#define MEMORY_BUDGET_RESERVE (1024 * 1024)
+
+// A process-wide cap (--max-memory) on the large buffers a run allocates.
+// Planners ask how many workers fit before starting them; the buffer pool
+// then charges every mapping it makes, and a request that does not fit
+// waits for another thread to give memory back instead of growing past
+// the limit.
+// Without a limit every call succeeds at once.
+
+// Parses a byte count with an optional K, M or G suffix (powers of 1024)
+int memory_budget_parse(const char* text, unsigned long long* bytes);
+// limit covers the whole process: what is resident already and
+// MEMORY_BUDGET_RESERVE are taken off the top. 0 removes the limit.
+int memory_budget_init(unsigned long long limit);
+unsigned long long memory_budget_limit(void);
+// Bytes the buffers may use in total, or 0 without a limit
+unsigned long long memory_budget_available(void);
+// The most buffer memory taken at once
+unsigned long long memory_budget_peak(void);
+// How many units of unit_bytes fit at once, between 1 and wanted
+size_t memory_budget_fit(size_t wanted, size_t unit_bytes);
+// Blocks until bytes fit. Fails if they never can: more than the budget,
+// or the calling thread already holds everything in use, so there is
+// nobody to wait for.
+int memory_budget_acquire(size_t bytes);
+// As memory_budget_acquire, but when bytes do not fit calls reclaim (with
+// no lock held) before every wait, so a cache charged to the budget can
+// make room. memory_budget_waiting() is true from then until it returns.
+int memory_budget_acquire_reclaiming(size_t bytes, void (*reclaim)(void));
+int memory_budget_waiting(void);
+void memory_budget_release(size_t bytes);
+// For memory given back by another thread than the one that took it
+void memory_budget_release_for(pthread_t holder, size_t bytes);
+
+#endif // UTILS_MEMORY_BUDGET_H
@@ -0,0 +1,24 @@
+#ifndef UTILS_PARALLEL_DECRYPT_H
+#define UTILS_PARALLEL_DECRYPT_H
+
+#include <stddef.h>
+
+// Ciphertext per region; a multiple of BLOCK_HEX_SIZE
+#define PARALLEL_REGION_SIZE (4 * 1024 * 1024)
+
+typedef struct {
+    unsigned long long plain_length;
+    size_t regions;
+} ParallelResult;
+
+// Decryption has no serial dependency: the key of every block is the
+// ciphertext before it, which is already on disk. The MAC is checked
+// first (in parallel, as verify does), then each region is decrypted by
+// its own worker and pwritten straight to its place in the preallocated
+// output, so no plaintext is written for a file that fails to authenticate.
+// Returns 1 without touching destination when the container cannot be
+// split (headerless, no MAC, sparse or compressed); the caller streams it.
+int parallel_decrypt_file(const char* source, const char* destination, const char* password,
+                          size_t num_threads, ParallelResult* result);
+
+#endif // UTILS_PARALLEL_DECRYPT_H
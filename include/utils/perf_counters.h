@@ -0,0 +1,37 @@
+#ifndef UTILS_PERF_COUNTERS_H
+#define UTILS_PERF_COUNTERS_H
+
+#include <stdint.h>
+
+// Hardware counters for the calling thread via perf_event_open (Linux).
+// Each counter is opened on its own, so a host that lacks one (LLC events
+// in many VMs) still reports the others, and a container that forbids
+// perf_event_open simply reports none.
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTER_COUNT
+} PerfCounter;
+
+typedef struct {
+    int fds[PERF_COUNTER_COUNT];
+    int opened;
+} PerfCounters;
+
+typedef struct {
+    uint64_t value[PERF_COUNTER_COUNT];
+    int valid[PERF_COUNTER_COUNT];
+} PerfSample;
+
+// Returns how many counters could be opened; 0 is not an error
+int perf_counters_open(PerfCounters* counters);
+void perf_counters_start(PerfCounters* counters);
+// Values are scaled up when the kernel had to multiplex the counters
+void perf_counters_stop(PerfCounters* counters, PerfSample* sample);
+void perf_counters_close(PerfCounters* counters);
+const char* perf_counter_name(PerfCounter counter);
+
+#endif // UTILS_PERF_COUNTERS_H
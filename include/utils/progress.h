@@ -0,0 +1,22 @@
+#ifndef UTILS_PROGRESS_H
+#define UTILS_PROGRESS_H
+
+#include <stdio.h>
+
+// Live progress for long runs. Workers add to a counter of their own (one
+// cache line per thread, relaxed atomics: no lock, no syscall) and a
+// background thread sums them every interval, printing a status line on a
+// terminal or one JSON object per line otherwise.
+extern int progress_enabled;
+
+void progress_count(unsigned long long bytes);
+#define PROGRESS_ADD(bytes) do { if (progress_enabled) progress_count(bytes); } while (0)
+
+// total_bytes may be 0 when unknown (no percentage or ETA then)
+int progress_start(unsigned long long total_bytes, double interval_seconds, FILE* out);
+// For callers that only learn the total once planning is done
+void progress_set_total(unsigned long long total_bytes);
+// Prints a final report and joins the sampler
+void progress_stop(void);
+
+#endif // UTILS_PROGRESS_H
@@ -0,0 +1,23 @@
+#ifndef UTILS_REGION_WRITER_H
+#define UTILS_REGION_WRITER_H
+
+#include <stddef.h>
+
+typedef struct RegionWriter RegionWriter;
+
+// An output file of known size that workers fill in any order. It is
+// preallocated up front (fallocate, then ftruncate to the exact size) and
+// every worker pwrites its own region through the one descriptor, so no
+// thread funnels the output and no file position is shared.
+// Completion is tracked per region. The file is written under a temporary
+// name and close only renames it into place when every region reported
+// success, so the destination is never seen half written.
+RegionWriter* region_writer_open(const char* path, unsigned long long size, size_t num_regions);
+int region_writer_write(RegionWriter* writer, unsigned long long offset, const void* data, size_t len);
+void region_writer_complete(RegionWriter* writer, size_t region, int status);
+size_t region_writer_completed(RegionWriter* writer);
+// Returns 0 when the file is whole and in place; otherwise the temporary
+// is removed and the destination left untouched
+int region_writer_close(RegionWriter* writer);
+
+#endif // UTILS_REGION_WRITER_H
@@ -0,0 +1,64 @@
+#ifndef UTILS_SPARSE_H
+#define UTILS_SPARSE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// A sparse container encrypts an extent table followed by the bytes of
+// each data extent, and nothing for the holes between them:
+//   "SPARSE" <apparent size: 16 hex> <extent count: 16 hex> "\n"
+//   then per extent: <offset: 16 hex> <length: 16 hex> "\n"
+#define SPARSE_MAGIC "SPARSE"
+#define SPARSE_HEADER_SIZE 39
+#define SPARSE_RECORD_SIZE 33
+
+typedef struct {
+    unsigned long long offset;
+    unsigned long long length;
+} SparseExtent;
+
+typedef struct {
+    SparseExtent* extents;
+    size_t count;
+    size_t capacity;
+    unsigned long long apparent_size;
+    unsigned long long data_bytes;
+} SparseMap;
+
+typedef struct {
+    unsigned long long apparent_size;
+    unsigned long long data_bytes;
+    size_t extents;
+} SparseResult;
+
+// Data extents from SEEK_DATA/SEEK_HOLE; where those are missing the whole
+// file is one extent
+int sparse_map_file(FILE* file, SparseMap* map);
+void sparse_map_free(SparseMap* map);
+
+// Encrypts only the data extents of source
+int sparse_encrypt(const char* source, const char* destination, const char* password, SparseResult* result);
+
+// Decoding side, fed the decrypted stream. A regular output file gets its
+// holes back by seeking past them and a final ftruncate; anything else
+// (a pipe) gets them as written zeros.
+typedef struct {
+    FILE* out;
+    int seekable;
+    unsigned char header[SPARSE_HEADER_SIZE];
+    size_t header_len;
+    unsigned char record[SPARSE_RECORD_SIZE];
+    size_t record_len;
+    SparseMap map;
+    size_t expected_extents;
+    size_t extent;           // extent being filled
+    unsigned long long filled;
+    unsigned long long position;  // where out currently stands
+} SparseWriter;
+
+void sparse_writer_init(SparseWriter* writer, FILE* out);
+int sparse_writer_feed(SparseWriter* writer, const unsigned char* data, size_t len);
+int sparse_writer_finish(SparseWriter* writer);
+void sparse_writer_free(SparseWriter* writer);
+
+#endif // UTILS_SPARSE_H
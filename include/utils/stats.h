@@ -0,0 +1,40 @@
+#ifndef UTILS_STATS_H
+#define UTILS_STATS_H
+
+#include <stdio.h>
+#include "../../include/utils/buffer_pool.h"
+
+// Run-wide numbers for --stats and --metrics-file. The byte and block
+// counts are what went through the cipher, summed over every thread.
+typedef struct {
+    unsigned long long bytes_in;
+    unsigned long long bytes_out;
+    unsigned long long blocks;
+    double wall_seconds;
+    double user_seconds;
+    double system_seconds;
+    long peak_rss_kb;
+    long minor_faults;
+    long major_faults;
+    long long mallocs;  // -1 when the build does not count allocations
+    long long malloc_bytes;
+    unsigned long long max_memory;   // 0 without --max-memory
+    unsigned long long budget_peak;  // most buffer memory held at once under it
+    BufferPoolStats pool;
+    size_t numa_nodes;
+    size_t cpus;
+    char placement[128];
+} RunStats;
+
+// Called by the cipher once per update, not per block
+void stats_add_cipher(unsigned long long bytes_in, unsigned long long bytes_out, unsigned long long blocks);
+
+void stats_start(void);
+// Everything but the allocation counts, which only the executable knows
+void stats_collect(RunStats* stats);
+// Also names the kernel the dispatcher chose for each primitive
+void stats_print_text(const RunStats* stats, int status, FILE* out);
+void stats_print_json(const RunStats* stats, int status, FILE* out);
+int stats_write_json(const RunStats* stats, int status, const char* path);
+
+#endif // UTILS_STATS_H
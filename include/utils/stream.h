@@ -0,0 +1,94 @@
+#ifndef UTILS_STREAM_H
+#define UTILS_STREAM_H
+
+#include <stdio.h>
+#include "../../include/crypto/cipher_context.h"
+#include "../../include/crypto/container.h"
+#include "../../include/crypto/mac.h"
+
+#define UNAUTHENTICATED_FAILURE "The input has no MAC and cannot be checked; " \
+                                "pass --allow-unauthenticated to decrypt it anyway\n"
+
+// Read and write buffers for stream_run; long-lived callers such as batch
+// workers allocate them once and reuse them for every file
+typedef struct {
+    unsigned char* in;
+    unsigned char* out;
+    size_t out_capacity;
+    size_t in_pending;  // bytes already at the start of in, consumed before reading more
+} StreamBuffers;
+
+
+// Everything derived from the password that the container needs, worked
+// out once per run rather than once per file
+typedef struct {
+    ContainerHeader header;  // template for new files: version, flags, key check
+    char password_key[BLOCK_SIZE];
+} StreamKeys;
+
+// One file's chain and running MAC, keyed by its data key (version 2) or
+// the password (older files). mac points into mac_key, so do not copy it.
+typedef struct {
+    AxonCipherContext ctx;
+    ContainerHeader header;
+    MacKey mac_key;
+    MacState mac;
+    int authenticated;
+} StreamFile;
+
+// Streaming counterparts of the file_chunker/chain_encryptor/chunk_writer pipeline.
+// They never seek, so either side may be a pipe (see open_stream).
+int stream_encrypt(FILE* in, FILE* out, const char* password);
+// stream_encrypt with extra container flags, e.g. CONTAINER_FLAG_COMPRESSED
+int stream_encrypt_flags(FILE* in, FILE* out, const char* password, unsigned int flags);
+int stream_decrypt(FILE* in, FILE* out, const char* password);
+int stream_run(FILE* in, FILE* out, AxonCipherContext* ctx, StreamBuffers* buffers);
+// stream_run with the container: on encryption a header carrying a fresh
+// wrapped data key goes ahead of the ciphertext and the MAC trailer after
+// it; on decryption the header is checked before any payload and the
+// trailer once the payload is read. Headerless input is decrypted as
+// legacy raw hex.
+int stream_run_container(FILE* in, FILE* out, AxonCipherMode mode, const StreamKeys* keys,
+                         StreamBuffers* buffers);
+int stream_write_header(FILE* out, const ContainerHeader* header);
+// found gets the header actually read; a legacy file leaves it zeroed
+int stream_read_header(FILE* in, const ContainerHeader* expected, ContainerHeader* found,
+                       StreamBuffers* buffers);
+// The key the chain and MAC of a file with this header start from
+int stream_file_key(const StreamKeys* keys, const ContainerHeader* header, char file_key[BLOCK_SIZE]);
+
+// The ends of the container path, for callers that drive the cipher
+// themselves: on encryption every ciphertext byte written between begin
+// and end goes through file->mac
+int stream_begin_encrypt(FILE* out, const StreamKeys* keys, StreamFile* file);
+// stream_begin_encrypt without writing the header, for callers that place
+// it themselves
+int stream_start_encrypt(const StreamKeys* keys, StreamFile* file);
+int stream_end_encrypt(FILE* out, StreamFile* file, unsigned long long plain_length);
+// Encrypts, MACs and writes len bytes; stream_finish_encrypt flushes the
+// last partial block and writes the trailer
+int stream_feed(FILE* out, StreamFile* file, const void* data, size_t len, StreamBuffers* buffers);
+int stream_finish_encrypt(FILE* out, StreamFile* file, StreamBuffers* buffers, unsigned long long plain_length);
+// Refuses a file without a MAC (legacy raw hex or a version 1 header)
+// unless stream_allow_unauthenticated was called
+int stream_begin_decrypt(FILE* in, const StreamKeys* keys, StreamFile* file, StreamBuffers* buffers);
+// Process-wide opt-out for the check above (--allow-unauthenticated)
+void stream_allow_unauthenticated(int allow);
+void stream_file_wipe(StreamFile* file);
+
+// Output size of an uncompressed run over the file at source, for
+// preallocating it; 0 when it cannot be told (not a regular file, or a
+// sparse or compressed container). A decryption may come out up to a
+// block shorter, as the padding is only known at the end.
+unsigned long long stream_output_size(AxonCipherMode mode, const char* source);
+
+int stream_keys_init(StreamKeys* keys, const char* password);
+void stream_keys_wipe(StreamKeys* keys);
+
+int stream_buffers_init(StreamBuffers* buffers);
+// What one StreamBuffers takes from the memory budget: the read window and
+// room for its hex, as the buffer pool charges them
+size_t stream_buffers_charge(void);
+void stream_buffers_free(StreamBuffers* buffers);
+
+#endif // UTILS_STREAM_H
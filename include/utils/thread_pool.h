@@ -0,0 +1,18 @@
+#ifndef UTILS_THREAD_POOL_H
+#define UTILS_THREAD_POOL_H
+
+#include <stddef.h>
+
+typedef void (*thread_pool_task_fn)(void* arg);
+
+typedef struct ThreadPool ThreadPool;
+
+ThreadPool* thread_pool_create(size_t num_threads);
+int thread_pool_submit(ThreadPool* pool, thread_pool_task_fn fn, void* arg);
+void thread_pool_wait(ThreadPool* pool);
+void thread_pool_destroy(ThreadPool* pool);
+size_t thread_pool_size(const ThreadPool* pool);
+int thread_pool_worker_index(void);
+size_t default_thread_count(void);
+
+#endif // UTILS_THREAD_POOL_H
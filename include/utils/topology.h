@@ -0,0 +1,36 @@
+#ifndef UTILS_TOPOLOGY_H
+#define UTILS_TOPOLOGY_H
+
+#include <stddef.h>
+
+#define TOPOLOGY_MAX_CPUS 1024
+#define TOPOLOGY_MAX_NODES 64
+
+// The CPUs this process may run on and the NUMA node of each, read from
+// sysfs; without it everything is one node
+typedef struct {
+    size_t num_nodes;
+    size_t num_cpus;
+    short node_of_cpu[TOPOLOGY_MAX_CPUS];  // -1 where the CPU is not available
+} Topology;
+
+const Topology* topology_get(void);
+// Node the calling thread is running on, 0 when unknown
+int topology_current_node(void);
+// Parses a list such as "0-3,8,10-11" into set (TOPOLOGY_MAX_CPUS entries)
+int topology_parse_cpus(const char* list, unsigned char* set);
+
+// Worker placement (--cpus, --numa=local). With a CPU list, worker i runs
+// on the i-th CPU of the list, round robin. With numa_local, workers are
+// dealt out across the nodes and each may run on any allowed CPU of its
+// own node. Buffers are first touched by the worker that uses them, so
+// they land on its node. cpus may be NULL for all of them.
+int placement_configure(const char* cpus, int numa_local);
+int placement_enabled(void);
+// CPUs the placement may use, or 0 without a placement
+size_t placement_cpu_count(void);
+// Called by every pool worker as it starts; a no-op without a placement
+void placement_bind_worker(size_t index);
+void placement_describe(char* text, size_t size);
+
+#endif // UTILS_TOPOLOGY_H
@@ -0,0 +1,57 @@
+#ifndef UTILS_TRACE_H
+#define UTILS_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Hot-path instrumentation. Built in when AXON_TRACE is defined (the
+// ENABLE_TRACE CMake option) and switched on at run time by trace_start;
+// until then every probe costs one predictable branch.
+//
+// Coarse stages are recorded as per-thread spans and written as Chrome
+// trace-event JSON (chrome://tracing, Perfetto). Per-block stages run
+// millions of times, so they only add to the per-thread counters that
+// trace_finish sums up. Times are inclusive: a cipher span contains the
+// key expansion, rounds and hex conversion of its blocks.
+typedef enum {
+    TRACE_READ,
+    TRACE_CHUNK,        // content-defined chunking (incremental stores)
+    TRACE_CIPHER,       // one buffer through the chain
+    TRACE_PASSWORD,
+    TRACE_KEY_EXPANSION,
+    TRACE_ADD_ROUND_KEY,
+    TRACE_SUB_BYTES,    // and inv_sub_bytes
+    TRACE_SHIFT_ROWS,   // and inv_shift_rows
+    TRACE_MIX_COLUMNS,  // and inv_mix_columns
+    TRACE_HEX,
+    TRACE_WRITE,
+    TRACE_STAGE_COUNT
+} TraceStage;
+
+#ifdef AXON_TRACE
+extern int trace_enabled;
+
+uint64_t trace_now(void);
+void trace_count(TraceStage stage, uint64_t start);
+void trace_span(TraceStage stage, uint64_t start);
+
+#define TRACE_START(name) uint64_t name = trace_enabled ? trace_now() : 0
+#define TRACE_COUNT(stage, name) do { if (name) trace_count(stage, name); } while (0)
+#define TRACE_SPAN(stage, name) do { if (name) trace_span(stage, name); } while (0)
+#else
+#define TRACE_START(name)
+#define TRACE_COUNT(stage, name) do { } while (0)
+#define TRACE_SPAN(stage, name) do { } while (0)
+#endif
+
+// Times a single call into the counters
+#define TRACE_PRIMITIVE(stage, call) do { TRACE_START(primitive_started); call; \
+                                          TRACE_COUNT(stage, primitive_started); } while (0)
+
+// path gets the trace-event JSON; NULL keeps only the counters
+int trace_start(const char* path);
+// Writes the trace and prints the counters to info. Call once every
+// worker thread has finished.
+int trace_finish(FILE* info);
+
+#endif // UTILS_TRACE_H
@@ -0,0 +1,32 @@
+#ifndef UTILS_VERIFY_H
+#define UTILS_VERIFY_H
+
+#include <stddef.h>
+#include "../../include/crypto/container.h"
+#include "../../include/crypto/ghash.h"
+#include "../../include/utils/stream.h"
+
+// Work unit of the parallel pass; a multiple of the GHASH block size
+#define VERIFY_SEGMENT_SIZE (4 * 1024 * 1024)
+
+typedef struct {
+    unsigned long long file_size;
+    unsigned long long plain_length;
+    size_t segments;
+} VerifyResult;
+
+// Checks a container's MAC without decrypting it. The authenticated range
+// is cut into segments hashed on num_threads threads (0 picks a default)
+// and the partial hashes are joined, so the pass runs at read speed.
+// Returns 0 when the file is intact, -1 otherwise.
+int verify_file(const char* path, const char* password, size_t num_threads, VerifyResult* result);
+// verify_file with keys already derived, also handing back the header
+int verify_container(const char* path, const StreamKeys* keys, size_t num_threads, ContainerHeader* found,
+                     VerifyResult* result);
+
+// Flushed GHASH of the first length bytes of path, with prefix standing in
+// for its first prefix_len bytes, hashed in segments on num_threads threads
+int verify_hash_range(const char* path, const GhashKey* key, const char* prefix, size_t prefix_len,
+                      unsigned long long length, size_t num_threads, unsigned char y_out[GHASH_BLOCK_SIZE]);
+
+#endif // UTILS_VERIFY_H
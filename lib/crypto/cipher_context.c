@@ -0,0 +1,377 @@
+#include "../../include/crypto/cipher_context.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../include/common/failures.h"
+#include "../../include/crypto/container.h"
+#include "../../include/crypto/mac.h"
+#include "../../include/crypto/password.h"
+#include "../../include/crypto/random.h"
+#include "../../include/crypto/encryptor.h"
+#include "../../include/crypto/decryptor.h"
+#include "../../include/utils/conversion.h"
+#include "../../include/utils/progress.h"
+#include "../../include/utils/stats.h"
+#include "../../include/utils/trace.h"
+
+#define OUTPUT_BUFFER_TOO_SMALL "Output buffer too small\n"
+
+static void bind_state(AxonCipherContext* ctx, char** state){
+    for (size_t i = 0; i < STATE_SIZE; i++) {
+        state[i] = ctx->state_rows[i];
+    }
+}
+
+// One step of chain_encryptor: the chain key becomes the hex of this block
+static void encrypt_block(AxonCipherContext* ctx, char** state, const unsigned char* block, unsigned char* hex_out){
+    unsigned char flat_state[BLOCK_SIZE];
+
+    for (size_t i = 0; i < STATE_SIZE; i++) {
+        for (size_t j = 0; j < STATE_SIZE; j++) {
+            state[i][j] = (char)block[i * STATE_SIZE + j];
+        }
+    }
+    single_state_encyption(state, ctx->chain_key);
+    for (size_t i = 0; i < STATE_SIZE; i++) {
+        for (size_t j = 0; j < STATE_SIZE; j++) {
+            flat_state[i * STATE_SIZE + j] = (unsigned char)state[i][j];
+        }
+    }
+    bytes_to_hex_into(flat_state, BLOCK_SIZE, (char*)hex_out);
+    memcpy(ctx->chain_key, hex_out, BLOCK_HEX_SIZE);
+}
+
+static int decrypt_block(AxonCipherContext* ctx, char** state, const unsigned char* hex_in, unsigned char* block_out){
+    unsigned char cipher[BLOCK_SIZE];
+
+    if (hex_to_bytes_into((const char*)hex_in, BLOCK_HEX_SIZE, cipher) != 0) {
+        fprintf(stderr, "Error converting hex to bytes\n");
+        return -1;
+    }
+    for (size_t i = 0; i < STATE_SIZE; i++) {
+        for (size_t j = 0; j < STATE_SIZE; j++) {
+            state[i][j] = (char)cipher[i * STATE_SIZE + j];
+        }
+    }
+    single_state_decryption(state, ctx->chain_key);
+    for (size_t i = 0; i < STATE_SIZE; i++) {
+        for (size_t j = 0; j < STATE_SIZE; j++) {
+            block_out[i * STATE_SIZE + j] = (unsigned char)state[i][j];
+        }
+    }
+    memcpy(ctx->chain_key, hex_in, BLOCK_HEX_SIZE);
+    return 0;
+}
+
+static int process_block(AxonCipherContext* ctx, char** state, const unsigned char* block,
+                         unsigned char* out, size_t* produced){
+    if (ctx->mode == AXON_ENCRYPT) {
+        encrypt_block(ctx, state, block, out + *produced);
+        *produced += BLOCK_HEX_SIZE;
+        return 0;
+    }
+    // The held block is only released once a later block proves it is not
+    // the padded final one
+    if (ctx->has_held_block) {
+        memcpy(out + *produced, ctx->held_block, BLOCK_SIZE);
+        *produced += BLOCK_SIZE;
+    }
+    if (decrypt_block(ctx, state, block, ctx->held_block) != 0) return -1;
+    ctx->has_held_block = 1;
+    return 0;
+}
+
+int axon_password_key(const char* password, char key_out[BLOCK_SIZE]){
+    // The validated password is the initial_pass of chain_encryptor/chain_decryptor
+    char* final_pass = validate_password(password);
+    if (!final_pass) {
+        fprintf(stderr, PASSWORD_VAL_FAILURE);
+        return -1;
+    }
+    memcpy(key_out, final_pass, BLOCK_SIZE);
+    memset(final_pass, 0, BLOCK_SIZE);
+    free(final_pass);
+    return 0;
+}
+
+int axon_cipher_init_key(AxonCipherContext* ctx, AxonCipherMode mode, const char key[BLOCK_SIZE]){
+    if (!ctx || !key) return -1;
+    memset(ctx, 0, sizeof(AxonCipherContext));
+    ctx->mode = mode;
+    memcpy(ctx->chain_key, key, BLOCK_SIZE);
+    return 0;
+}
+
+int axon_cipher_init(AxonCipherContext* ctx, AxonCipherMode mode, const char* password){
+    char key[BLOCK_SIZE];
+    if (!ctx) return -1;
+    memset(ctx, 0, sizeof(AxonCipherContext));
+    if (axon_password_key(password, key) != 0) return -1;
+    int status = axon_cipher_init_key(ctx, mode, key);
+    memset(key, 0, sizeof(key));
+    return status;
+}
+
+void axon_encrypt_block(const char key[BLOCK_SIZE], const unsigned char in[BLOCK_SIZE],
+                        unsigned char out[BLOCK_SIZE]){
+    char rows[STATE_SIZE][STATE_SIZE];
+    char* state[STATE_SIZE];
+    char round_key[BLOCK_SIZE];
+
+    memcpy(round_key, key, BLOCK_SIZE);
+    for (size_t i = 0; i < STATE_SIZE; i++) {
+        state[i] = rows[i];
+        for (size_t j = 0; j < STATE_SIZE; j++) {
+            rows[i][j] = (char)in[i * STATE_SIZE + j];
+        }
+    }
+    single_state_encyption(state, round_key);
+    for (size_t i = 0; i < STATE_SIZE; i++) {
+        for (size_t j = 0; j < STATE_SIZE; j++) {
+            out[i * STATE_SIZE + j] = (unsigned char)rows[i][j];
+        }
+    }
+    memset(round_key, 0, sizeof(round_key));
+}
+
+size_t axon_cipher_output_bound(const AxonCipherContext* ctx, size_t in_len){
+    size_t available = ctx->partial_len + in_len;
+    if (ctx->mode == AXON_ENCRYPT) {
+        return (available / BLOCK_SIZE) * BLOCK_HEX_SIZE;
+    }
+    return (available / BLOCK_HEX_SIZE) * BLOCK_SIZE;
+}
+
+static int cipher_update(AxonCipherContext* ctx, const unsigned char* in, size_t in_len,
+                         unsigned char* out, size_t out_capacity, size_t* out_len){
+    if (!ctx || (!in && in_len > 0) || !out_len) return -1;
+    *out_len = 0;
+    if (axon_cipher_output_bound(ctx, in_len) > out_capacity) {
+        fprintf(stderr, OUTPUT_BUFFER_TOO_SMALL);
+        return -1;
+    }
+
+    char* state[STATE_SIZE];
+    bind_state(ctx, state);
+    size_t in_block = ctx->mode == AXON_ENCRYPT ? BLOCK_SIZE : BLOCK_HEX_SIZE;
+    size_t produced = 0;
+
+    // Top up a block left over from the previous call first, then work
+    // directly on the caller's input without copying it
+    if (ctx->partial_len > 0) {
+        size_t take = in_block - ctx->partial_len;
+        if (take > in_len) take = in_len;
+        memcpy(ctx->partial + ctx->partial_len, in, take);
+        ctx->partial_len += take;
+        in += take;
+        in_len -= take;
+        if (ctx->partial_len < in_block) return 0;
+        ctx->partial_len = 0;
+        if (process_block(ctx, state, ctx->partial, out, &produced) != 0) return -1;
+    }
+
+    while (in_len >= in_block) {
+        if (process_block(ctx, state, in, out, &produced) != 0) {
+            *out_len = produced;
+            return -1;
+        }
+        in += in_block;
+        in_len -= in_block;
+    }
+
+    if (in_len > 0) {
+        memcpy(ctx->partial, in, in_len);
+        ctx->partial_len = in_len;
+    }
+    *out_len = produced;
+    return 0;
+}
+
+int axon_cipher_update(AxonCipherContext* ctx, const unsigned char* in, size_t in_len,
+                       unsigned char* out, size_t out_capacity, size_t* out_len){
+    TRACE_START(started);
+    size_t buffered = ctx ? ctx->partial_len : 0;
+    int status = cipher_update(ctx, in, in_len, out, out_capacity, out_len);
+    if (status == 0) {
+        size_t in_block = ctx->mode == AXON_ENCRYPT ? BLOCK_SIZE : BLOCK_HEX_SIZE;
+        stats_add_cipher(in_len, *out_len, (buffered + in_len) / in_block);
+        PROGRESS_ADD(in_len);
+    }
+    TRACE_SPAN(TRACE_CIPHER, started);
+    return status;
+}
+
+int axon_cipher_final(AxonCipherContext* ctx, unsigned char* out, size_t out_capacity, size_t* out_len){
+    if (!ctx || !out_len) return -1;
+    *out_len = 0;
+
+    char* state[STATE_SIZE];
+    bind_state(ctx, state);
+
+    if (ctx->mode == AXON_ENCRYPT) {
+        if (ctx->partial_len == 0) return 0;
+        if (out_capacity < BLOCK_HEX_SIZE) {
+            fprintf(stderr, OUTPUT_BUFFER_TOO_SMALL);
+            return -1;
+        }
+        // Same zero padding file_chunker applies to the final partial block
+        memset(ctx->partial + ctx->partial_len, 0, BLOCK_SIZE - ctx->partial_len);
+        encrypt_block(ctx, state, ctx->partial, out);
+        ctx->partial_len = 0;
+        *out_len = BLOCK_HEX_SIZE;
+        stats_add_cipher(0, BLOCK_HEX_SIZE, 1);
+        return 0;
+    }
+
+    if (ctx->partial_len > 0 && !(ctx->partial_len == 1 && ctx->partial[0] == '\n')) {
+        fprintf(stderr, "Warning: Ignoring %zu trailing characters that do not form a full block\n",
+                ctx->partial_len);
+    }
+    ctx->partial_len = 0;
+    if (!ctx->has_held_block) return 0;
+
+    size_t tail_len = BLOCK_SIZE;
+    while (tail_len > 0 && ctx->held_block[tail_len - 1] == 0) tail_len--;
+    if (out_capacity < tail_len) {
+        fprintf(stderr, OUTPUT_BUFFER_TOO_SMALL);
+        return -1;
+    }
+    memcpy(out, ctx->held_block, tail_len);
+    ctx->has_held_block = 0;
+    *out_len = tail_len;
+    stats_add_cipher(0, tail_len, 0);
+    return 0;
+}
+
+void axon_cipher_wipe(AxonCipherContext* ctx){
+    if (!ctx) return;
+    volatile unsigned char* bytes = (volatile unsigned char*)ctx;
+    for (size_t i = 0; i < sizeof(AxonCipherContext); i++) {
+        bytes[i] = 0;
+    }
+}
+
+size_t axon_encrypted_size(size_t plain_len){
+    return ((plain_len + BLOCK_SIZE - 1) / BLOCK_SIZE) * BLOCK_HEX_SIZE;
+}
+
+size_t axon_sealed_size(size_t plain_len){
+    return CONTAINER_HEADER_SIZE + axon_encrypted_size(plain_len) + MAC_TRAILER_SIZE;
+}
+
+// The MAC of a sealed buffer, with the header as container files present it
+static void seal_mac(const ContainerHeader* header, const char data_key[BLOCK_SIZE], const unsigned char* payload,
+                     size_t payload_len, unsigned long long plain_len, char trailer[MAC_TRAILER_SIZE]){
+    char text[CONTAINER_HEADER_SIZE];
+    MacKey mac_key;
+    MacState mac;
+
+    container_header_format_authenticated(header, text);
+    mac_key_init(&mac_key, data_key);
+    mac_start(&mac, &mac_key);
+    mac_update(&mac, text, CONTAINER_HEADER_SIZE);
+    mac_update(&mac, payload, payload_len);
+    mac_finish(&mac, &mac_key, plain_len, trailer);
+    mac_key_wipe(&mac_key);
+}
+
+int axon_encrypt_buffer(const unsigned char* in, size_t in_len, const char* password,
+                        unsigned char* out, size_t out_capacity, size_t* out_len){
+    ContainerHeader header;
+    AxonCipherContext ctx;
+    char password_key[BLOCK_SIZE];
+    char data_key[BLOCK_SIZE];
+    size_t body_len = 0;
+    size_t tail_len = 0;
+    int status = -1;
+
+    if (!out_len || (!in && in_len > 0)) return -1;
+    *out_len = 0;
+    if (out_capacity < axon_sealed_size(in_len)) {
+        fprintf(stderr, OUTPUT_BUFFER_TOO_SMALL);
+        return -1;
+    }
+    if (container_header_init(&header, password) == 0 && axon_password_key(password, password_key) == 0
+        && random_bytes(data_key, sizeof(data_key)) == 0
+        && container_wrap_key(&header, password_key, data_key) == 0) {
+        header.flags = CONTAINER_FLAG_MAC;
+        container_header_format(&header, (char*)out);
+        unsigned char* payload = out + CONTAINER_HEADER_SIZE;
+        size_t payload_capacity = axon_encrypted_size(in_len);
+        axon_cipher_init_key(&ctx, AXON_ENCRYPT, data_key);
+        if (axon_cipher_update(&ctx, in, in_len, payload, payload_capacity, &body_len) == 0
+            && axon_cipher_final(&ctx, payload + body_len, payload_capacity - body_len, &tail_len) == 0) {
+            seal_mac(&header, data_key, payload, body_len + tail_len, in_len,
+                     (char*)payload + body_len + tail_len);
+            *out_len = axon_sealed_size(in_len);
+            status = 0;
+        }
+        axon_cipher_wipe(&ctx);
+    }
+    memset(password_key, 0, sizeof(password_key));
+    memset(data_key, 0, sizeof(data_key));
+    return status;
+}
+
+// Nothing is decrypted until the key check value and the MAC pass, and the
+// output is exactly the authenticated length, trailing zero bytes included
+int axon_decrypt_buffer(const unsigned char* in, size_t in_len, const char* password,
+                        unsigned char* out, size_t out_capacity, size_t* out_len){
+    ContainerHeader found;
+    ContainerHeader expected;
+    AxonCipherContext ctx;
+    char password_key[BLOCK_SIZE];
+    char data_key[BLOCK_SIZE];
+    char tag[MAC_TAG_HEX_SIZE + 1];
+    char trailer[MAC_TRAILER_SIZE];
+    unsigned long long plain_len = 0;
+    int status = -1;
+
+    if (!out_len || !in) return -1;
+    *out_len = 0;
+    if (in_len < CONTAINER_HEADER_SIZE + MAC_TRAILER_SIZE || container_header_parse(in, in_len, &found) != 1
+        || found.version < 2 || found.flags != CONTAINER_FLAG_MAC) {
+        fprintf(stderr, "Not a sealed buffer\n");
+        return -1;
+    }
+    const unsigned char* payload = in + CONTAINER_HEADER_SIZE;
+    size_t payload_len = in_len - CONTAINER_HEADER_SIZE - MAC_TRAILER_SIZE;
+    if (container_header_init(&expected, password) != 0 || axon_password_key(password, password_key) != 0) return -1;
+    int authentic = 0;
+    if (!container_key_matches(&found, &expected)) {
+        fprintf(stderr, WRONG_KEY_FAILURE);
+    } else if (container_unwrap_key(&found, password_key, data_key) == 0
+               && mac_parse_trailer(payload + payload_len, &plain_len, tag) == 0
+               && plain_len <= payload_len && axon_encrypted_size((size_t)plain_len) == payload_len) {
+        seal_mac(&found, data_key, payload, payload_len, plain_len, trailer);
+        authentic = mac_tags_equal(tag, trailer + MAC_AUTHENTICATED_PREFIX);
+        if (!authentic) fprintf(stderr, MAC_FAILURE);
+    } else {
+        fprintf(stderr, MAC_FAILURE);
+    }
+    if (authentic && out_capacity < plain_len) {
+        fprintf(stderr, OUTPUT_BUFFER_TOO_SMALL);
+    } else if (authentic) {
+        // The last block stays held by the chain; its length is the
+        // authenticated one, not the chain's guess from trailing zeros
+        unsigned char released[BLOCK_SIZE];
+        size_t body_len = 0;
+        size_t last_len = 0;
+        size_t split = payload_len > 0 ? payload_len - BLOCK_HEX_SIZE : 0;
+        axon_cipher_init_key(&ctx, AXON_DECRYPT, data_key);
+        if (axon_cipher_update(&ctx, payload, split, out, out_capacity, &body_len) == 0
+            && axon_cipher_update(&ctx, payload + split, payload_len - split, released, sizeof(released),
+                                  &last_len) == 0) {
+            memcpy(out + body_len, released, last_len);
+            body_len += last_len;
+            if (ctx.has_held_block) memcpy(out + body_len, ctx.held_block, (size_t)plain_len - body_len);
+            *out_len = (size_t)plain_len;
+            status = 0;
+        }
+        axon_cipher_wipe(&ctx);
+        memset(released, 0, sizeof(released));
+    }
+    memset(password_key, 0, sizeof(password_key));
+    memset(data_key, 0, sizeof(data_key));
+    return status;
+}
@@ -0,0 +1,278 @@
+#include "../../include/crypto/container.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "../../include/common/failures.h"
+#include "../../include/crypto/cipher_context.h"
+#include "../../include/crypto/mac.h"
+#include "../../include/crypto/random.h"
+#include "../../include/utils/conversion.h"
+#include "../../include/utils/fileio.h"
+
+// A block no real file is likely to start with, so the check value says
+// nothing about the first ciphertext block of the payload
+static const unsigned char kcv_block[BLOCK_SIZE] = "axon:key-check:1";
+
+// One raw block under the password key: the first step of a chain, but
+// not a chain, so it shows up in neither --stats nor --progress
+int container_header_init(ContainerHeader* header, const char* password){
+    char key[BLOCK_SIZE];
+    unsigned char cipher[BLOCK_SIZE];
+
+    memset(header, 0, sizeof(ContainerHeader));
+    header->version = CONTAINER_VERSION;
+    if (axon_password_key(password, key) != 0) return -1;
+    axon_encrypt_block(key, kcv_block, cipher);
+    memset(key, 0, sizeof(key));
+    // Half a block is plenty to catch a typo and leaves the rest unknown
+    bytes_to_hex_into(cipher, KCV_HEX_SIZE / 2, header->kcv);
+    header->kcv[KCV_HEX_SIZE] = '\0';
+    return 0;
+}
+
+size_t container_header_size(const ContainerHeader* header){
+    return header->version == 1 ? CONTAINER_V1_HEADER_SIZE : CONTAINER_HEADER_SIZE;
+}
+
+static void format_header(const ContainerHeader* header, int blank_key_slot, char out[CONTAINER_HEADER_SIZE]){
+    char text[CONTAINER_HEADER_SIZE + 1];
+    if (header->version == 1) {
+        snprintf(text, sizeof(text), "%s%02x%04x%s\n", CONTAINER_MAGIC, header->version & 0xff,
+                 header->flags & 0xffff, header->kcv);
+    } else if (blank_key_slot) {
+        snprintf(text, sizeof(text), "%s%02x%04x%0*d\n", CONTAINER_MAGIC, header->version & 0xff,
+                 header->flags & 0xffff, KCV_HEX_SIZE + 2 * BLOCK_HEX_SIZE, 0);
+    } else {
+        snprintf(text, sizeof(text), "%s%02x%04x%s%s%s\n", CONTAINER_MAGIC, header->version & 0xff,
+                 header->flags & 0xffff, header->kcv, header->salt, header->wrapped_key);
+    }
+    memcpy(out, text, container_header_size(header));
+}
+
+void container_header_format(const ContainerHeader* header, char out[CONTAINER_HEADER_SIZE]){
+    format_header(header, 0, out);
+}
+
+void container_header_format_authenticated(const ContainerHeader* header, char out[CONTAINER_HEADER_SIZE]){
+    format_header(header, 1, out);
+}
+
+size_t container_header_length(const unsigned char* data, size_t len){
+    size_t magic_len = strlen(CONTAINER_MAGIC);
+    if (len < magic_len || memcmp(data, CONTAINER_MAGIC, magic_len) != 0) return 0;
+    if (len >= magic_len + 2 && memcmp(data + magic_len, "01", 2) == 0) return CONTAINER_V1_HEADER_SIZE;
+    return CONTAINER_HEADER_SIZE;
+}
+
+static int is_hex(const char* text, size_t len){
+    for (size_t i = 0; i < len; i++) {
+        char c = text[i];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'))) return 0;
+    }
+    return 1;
+}
+
+int container_header_parse(const unsigned char* data, size_t len, ContainerHeader* header){
+    size_t magic_len = strlen(CONTAINER_MAGIC);
+    size_t size = container_header_length(data, len);
+    if (size == 0) return 0;
+
+    char text[CONTAINER_HEADER_SIZE + 1];
+    if (len < CONTAINER_V1_HEADER_SIZE) {
+        fprintf(stderr, "Truncated container header\n");
+        return -1;
+    }
+    memset(header, 0, sizeof(ContainerHeader));
+    memcpy(text, data, CONTAINER_V1_HEADER_SIZE);
+    text[CONTAINER_V1_HEADER_SIZE] = '\0';
+    if (sscanf(text + magic_len, "%2x%4x", &header->version, &header->flags) != 2
+        || header->version < 1 || header->version > CONTAINER_VERSION) {
+        fprintf(stderr, "Unsupported container version\n");
+        return -1;
+    }
+    if (len < size) {
+        fprintf(stderr, "Truncated container header\n");
+        return -1;
+    }
+    memcpy(text, data, size);
+    text[size] = '\0';
+    if (text[size - 1] != '\n' || !is_hex(text + CONTAINER_PREFIX_SIZE, size - CONTAINER_PREFIX_SIZE - 1)) {
+        fprintf(stderr, "Damaged container header\n");
+        return -1;
+    }
+    if (header->flags & ~CONTAINER_KNOWN_FLAGS) {
+        fprintf(stderr, "Unsupported container flags: %04x\n", header->flags);
+        return -1;
+    }
+    // Every version 2 writer appends the MAC, and the key check value does
+    // not cover the flags, so a cleared bit can only mean a stripped trailer
+    if (header->version >= 2 && !(header->flags & CONTAINER_FLAG_MAC)) {
+        fprintf(stderr, MAC_FAILURE);
+        return -1;
+    }
+    memcpy(header->kcv, text + CONTAINER_PREFIX_SIZE, KCV_HEX_SIZE);
+    if (header->version >= 2) {
+        memcpy(header->salt, text + CONTAINER_PREFIX_SIZE + KCV_HEX_SIZE, BLOCK_HEX_SIZE);
+        memcpy(header->wrapped_key, text + CONTAINER_PREFIX_SIZE + KCV_HEX_SIZE + BLOCK_HEX_SIZE, BLOCK_HEX_SIZE);
+    }
+    return 1;
+}
+
+int container_key_matches(const ContainerHeader* found, const ContainerHeader* expected){
+    return memcmp(found->kcv, expected->kcv, KCV_HEX_SIZE) == 0;
+}
+
+// The key slot is a one-block counter mode: data key XOR E_password(salt),
+// with a fresh random salt on every wrap
+static int apply_key_stream(const char* salt_hex, const char password_key[BLOCK_SIZE],
+                            const unsigned char* in, unsigned char* out){
+    unsigned char salt[BLOCK_SIZE];
+    unsigned char stream[BLOCK_SIZE];
+    if (hex_to_bytes_into(salt_hex, BLOCK_HEX_SIZE, salt) != 0) return -1;
+    axon_encrypt_block(password_key, salt, stream);
+    for (size_t i = 0; i < BLOCK_SIZE; i++) {
+        out[i] = in[i] ^ stream[i];
+    }
+    memset(stream, 0, sizeof(stream));
+    return 0;
+}
+
+int container_wrap_key(ContainerHeader* header, const char password_key[BLOCK_SIZE], const char data_key[BLOCK_SIZE]){
+    unsigned char salt[BLOCK_SIZE];
+    unsigned char wrapped[BLOCK_SIZE];
+    if (random_bytes(salt, sizeof(salt)) != 0) return -1;
+    bytes_to_hex_into(salt, BLOCK_SIZE, header->salt);
+    header->salt[BLOCK_HEX_SIZE] = '\0';
+    if (apply_key_stream(header->salt, password_key, (const unsigned char*)data_key, wrapped) != 0) return -1;
+    bytes_to_hex_into(wrapped, BLOCK_SIZE, header->wrapped_key);
+    header->wrapped_key[BLOCK_HEX_SIZE] = '\0';
+    return 0;
+}
+
+int container_unwrap_key(const ContainerHeader* header, const char password_key[BLOCK_SIZE], char data_key[BLOCK_SIZE]){
+    unsigned char wrapped[BLOCK_SIZE];
+    if (header->version < 2 || hex_to_bytes_into(header->wrapped_key, BLOCK_HEX_SIZE, wrapped) != 0) return -1;
+    return apply_key_stream(header->salt, password_key, wrapped, (unsigned char*)data_key);
+}
+
+// The new header goes to <path>.rekey before it overwrites the old one, so
+// a crash mid-write leaves a copy to finish from
+static char* rekey_journal_path(const char* path){
+    return suffixed_path(path, CONTAINER_REKEY_SUFFIX);
+}
+
+static int save_rekey_journal(const char* journal, const char header[CONTAINER_HEADER_SIZE]){
+    char* temp = temp_path_for(journal);
+    if (!temp) return -1;
+    FILE* file = fopen(temp, "wb");
+    int status = file ? 0 : -1;
+    if (file) {
+        if (fwrite(header, 1, CONTAINER_HEADER_SIZE, file) != CONTAINER_HEADER_SIZE || sync_file(file) != 0) status = -1;
+        if (fclose(file) != 0) status = -1;
+        if (status == 0) status = replace_file(temp, journal);
+        if (status == 0) status = sync_parent_dir(journal);
+        if (status != 0) remove(temp);
+    }
+    if (status != 0) fprintf(stderr, "Failed to write %s\n", journal);
+    free(temp);
+    return status;
+}
+
+// Header first, synced, then the journal is dropped: the file is never
+// without a complete header somewhere on disk
+static int write_rekeyed_header(FILE* file, const char* journal, const char header[CONTAINER_HEADER_SIZE]){
+    if (fseek(file, 0, SEEK_SET) != 0 || fwrite(header, 1, CONTAINER_HEADER_SIZE, file) != CONTAINER_HEADER_SIZE
+        || sync_file(file) != 0) {
+        fprintf(stderr, "Failed to write the new header\n");
+        return -1;
+    }
+    if (remove(journal) != 0 || sync_parent_dir(journal) != 0) {
+        fprintf(stderr, "Failed to remove %s\n", journal);
+        return -1;
+    }
+    return 0;
+}
+
+// A journal left by an interrupted rekey to new_password is completed
+// rather than started over; the header in the file may be torn
+static int finish_rekey(FILE* file, const char* journal, const char* new_password){
+    unsigned char text[CONTAINER_HEADER_SIZE];
+    ContainerHeader saved;
+    ContainerHeader expected;
+
+    FILE* in = fopen(journal, "rb");
+    if (!in) {
+        fprintf(stderr, "Failed to open %s\n", journal);
+        return -1;
+    }
+    size_t got = fread(text, 1, CONTAINER_HEADER_SIZE, in);
+    fclose(in);
+    if (container_header_parse(text, got, &saved) != 1 || saved.version < 2) {
+        fprintf(stderr, "%s is damaged\n", journal);
+        return -1;
+    }
+    if (container_header_init(&expected, new_password) != 0) return -1;
+    if (!container_key_matches(&saved, &expected)) {
+        fprintf(stderr, "%s holds an interrupted rekey to another key; rerun that rekey first\n", journal);
+        return -1;
+    }
+    return write_rekeyed_header(file, journal, (const char*)text);
+}
+
+int container_rekey(const char* path, const char* old_password, const char* new_password){
+    unsigned char text[CONTAINER_HEADER_SIZE];
+    ContainerHeader found;
+    ContainerHeader old_header;
+    ContainerHeader new_header;
+    char old_key[BLOCK_SIZE];
+    char new_key[BLOCK_SIZE];
+    char data_key[BLOCK_SIZE];
+    int status = -1;
+
+    char* journal = rekey_journal_path(path);
+    if (!journal) return -1;
+    FILE* file = fopen(path, "r+b");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        free(journal);
+        return -1;
+    }
+    struct stat info;
+    if (stat(journal, &info) == 0) {
+        status = finish_rekey(file, journal, new_password);
+        if (fclose(file) != 0) status = -1;
+        free(journal);
+        return status;
+    }
+
+    size_t got = fread(text, 1, CONTAINER_HEADER_SIZE, file);
+    int parsed = container_header_parse(text, got, &found);
+    if (parsed == 0 || (parsed > 0 && found.version < 2)) {
+        fprintf(stderr, "%s has no wrapped data key; decrypt and re-encrypt it once to enable rekeying\n", path);
+    } else if (parsed > 0 && container_header_init(&old_header, old_password) == 0
+               && container_header_init(&new_header, new_password) == 0
+               && axon_password_key(old_password, old_key) == 0
+               && axon_password_key(new_password, new_key) == 0) {
+        if (!container_key_matches(&found, &old_header)) {
+            fprintf(stderr, WRONG_KEY_FAILURE);
+        } else if (container_unwrap_key(&found, old_key, data_key) == 0) {
+            // Same size, same offset: only the key slot of the header changes,
+            // and the MAC does not cover it
+            memcpy(found.kcv, new_header.kcv, sizeof(found.kcv));
+            char out[CONTAINER_HEADER_SIZE];
+            if (container_wrap_key(&found, new_key, data_key) == 0) {
+                container_header_format(&found, out);
+                if (save_rekey_journal(journal, out) == 0 && write_rekeyed_header(file, journal, out) == 0) {
+                    status = 0;
+                }
+            }
+        }
+    }
+    if (fclose(file) != 0) status = -1;
+    free(journal);
+    memset(old_key, 0, sizeof(old_key));
+    memset(new_key, 0, sizeof(new_key));
+    memset(data_key, 0, sizeof(data_key));
+    return status;
+}
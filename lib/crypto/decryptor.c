@@ -6,6 +6,7 @@
 #include "../../include/utils/conversion.h"
 #include "../../include/utils/memory.h"
 #include "../../include/common/config.h"
+#include "../../include/utils/trace.h"
 
 char* chunk_decryptor(char* hex_bytes, char* final_pass, int block_size){
     size_t binary_len;
@@ -28,7 +29,7 @@ char* chunk_decryptor(char* hex_bytes, char* final_pass, int block_size){
     single_state_decryption(state, final_pass);
     free(binary_data);
 
-    char* flat_state = (char*)malloc(block_size * block_size * sizeof(char));
+    char* flat_state = (char*)malloc(block_size * block_size * sizeof(char) + 1);
     if (flat_state == NULL) {
         fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
         free_matrix_memory(state, block_size);
@@ -39,6 +40,7 @@ char* chunk_decryptor(char* hex_bytes, char* final_pass, int block_size){
             flat_state[i * block_size + j] = state[i][j];
         }
     }
+    flat_state[block_size * block_size] = '\0'; // chunk_writer relies on strlen
     free_matrix_memory(state, block_size);
     return flat_state;
 }
@@ -122,23 +124,18 @@ char** parse_encrypted_file(const char* file_content, size_t* num_blocks_out){
 }
 
 void single_state_decryption(char** state, char* final_key) {
-    char* expanded_key = malloc(EXPANDED_KEY_SIZE);
-    if (expanded_key == NULL) {
-        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
-        return;
-    }
+    // Round keys live on the stack: this runs once per block on every hot path
+    char expanded_key[EXPANDED_KEY_SIZE];
     expand_key(final_key, 16, expanded_key, EXPANDED_KEY_SIZE);
-    add_round_key(state, expanded_key + (10 * STATE_SIZE * STATE_SIZE));
+    TRACE_PRIMITIVE(TRACE_ADD_ROUND_KEY, add_round_key(state, expanded_key + (10 * STATE_SIZE * STATE_SIZE)));
     for (size_t round = 0; round < 9; round++) {
-        inv_shift_rows(state);
-        inv_sub_bytes(state);
-        add_round_key(state, expanded_key + ((9 - round) * STATE_SIZE * STATE_SIZE));
-        inv_mix_columns(state);
+        TRACE_PRIMITIVE(TRACE_SHIFT_ROWS, inv_shift_rows(state));
+        TRACE_PRIMITIVE(TRACE_SUB_BYTES, inv_sub_bytes(state));
+        TRACE_PRIMITIVE(TRACE_ADD_ROUND_KEY, add_round_key(state, expanded_key + ((9 - round) * STATE_SIZE * STATE_SIZE)));
+        TRACE_PRIMITIVE(TRACE_MIX_COLUMNS, inv_mix_columns(state));
     }
     
-    inv_shift_rows(state);
-    inv_sub_bytes(state);
-    add_round_key(state, expanded_key);
-    
-    free(expanded_key);
+    TRACE_PRIMITIVE(TRACE_SHIFT_ROWS, inv_shift_rows(state));
+    TRACE_PRIMITIVE(TRACE_SUB_BYTES, inv_sub_bytes(state));
+    TRACE_PRIMITIVE(TRACE_ADD_ROUND_KEY, add_round_key(state, expanded_key));
 }
\ No newline at end of file
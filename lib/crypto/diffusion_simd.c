@@ -2,11 +2,14 @@
 #include "../../include/crypto/diffusion.h"
 #include "../../include/common/optimization.h"
 #include <string.h>
+#include <pthread.h>
 
 // Forward declare the original scalar implementation
 extern void mix_columns_original(char** state);
 
+// Written exactly once under pthread_once, read-only afterwards
 static void (*optimal_mix_columns)(char** state) = NULL;
+static pthread_once_t mix_columns_once = PTHREAD_ONCE_INIT;
 
 #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
 #include <immintrin.h>
@@ -32,7 +35,7 @@ void mix_columns_sse2(char** state) {
         has_high_mask = _mm_cmpeq_epi8(has_high_mask, high_bit_mask);
 
         __m128i shifted_bytes = _mm_slli_epi16(column_bytes, 1);
-        shifted_bytes = _mm_and_si128(shifted_bytes, _mm_set1_epi8(0xFF));
+        shifted_bytes = _mm_and_si128(shifted_bytes, _mm_set1_epi8((char)0xFE));
 
         __m128i reduction_mask = _mm_and_si128(has_high_mask, _mm_set1_epi8(0x1B));
         __m128i multiplied_by_2 = _mm_xor_si128(shifted_bytes, reduction_mask);
@@ -58,6 +61,7 @@ void mix_columns_sse2(char** state) {
 
 #if defined(__AVX__) && !defined(__AVX2__)
 #include <immintrin.h>
+#define MIX_COLUMNS_AVX_KERNEL "avx"
 
 void mix_columns_avx(char** state) {
     char temp[STATE_SIZE][STATE_SIZE];
@@ -80,7 +84,7 @@ void mix_columns_avx(char** state) {
         has_high_mask = _mm_cmpeq_epi8(has_high_mask, high_bit_mask);
 
         __m128i shifted_bytes = _mm_slli_epi16(column_bytes, 1);
-        shifted_bytes = _mm_and_si128(shifted_bytes, _mm_set1_epi8(0xFF));
+        shifted_bytes = _mm_and_si128(shifted_bytes, _mm_set1_epi8((char)0xFE));
 
         __m128i reduction_mask = _mm_and_si128(has_high_mask, _mm_set1_epi8(0x1B));
         __m128i multiplied_by_2 = _mm_xor_si128(shifted_bytes, reduction_mask);
@@ -112,6 +116,7 @@ void mix_columns_avx(char** state) {
     }
 }
 #else
+#define MIX_COLUMNS_AVX_KERNEL "sse2"
 void mix_columns_avx(char** state) {
     mix_columns_sse2(state);
 }
@@ -119,6 +124,7 @@ void mix_columns_avx(char** state) {
 
 
 #if defined(__AVX2__)
+#define MIX_COLUMNS_AVX2_KERNEL "avx2"
 void mix_columns_avx2(char** state) {
     char temp[STATE_SIZE][STATE_SIZE];
     for (int i = 0; i < STATE_SIZE; i++) {
@@ -151,7 +157,7 @@ void mix_columns_avx2(char** state) {
         has_high_bit = _mm256_cmpeq_epi8(has_high_bit, high_bit_mask);
         
         __m256i shifted = _mm256_slli_epi16(columns, 1);
-        shifted = _mm256_and_si256(shifted, _mm256_set1_epi8(0xFF));
+        shifted = _mm256_and_si256(shifted, _mm256_set1_epi8((char)0xFE));
         
         __m256i reduction = _mm256_and_si256(has_high_bit, _mm256_set1_epi8(0x1B));
         __m256i multiplied_by_2 = _mm256_xor_si256(shifted, reduction);
@@ -190,14 +196,19 @@ void mix_columns_avx2(char** state) {
     }
 }
 #else
+#define MIX_COLUMNS_AVX2_KERNEL "sse2"
 void mix_columns_avx2(char** state) {
     mix_columns_sse2(state);
 }
 #endif // AVX2
+#define MIX_COLUMNS_SSE2_KERNEL "sse2"
 
 #else
 // Forward declare the original implementation
 extern void mix_columns_original(char** state);
+#define MIX_COLUMNS_SSE2_KERNEL "scalar"
+#define MIX_COLUMNS_AVX_KERNEL "scalar"
+#define MIX_COLUMNS_AVX2_KERNEL "scalar"
 
 void mix_columns_sse2(char** state) {
     mix_columns_original(state);
@@ -213,23 +224,31 @@ void mix_columns_avx2(char** state) {
 #endif // SSE2
 
 
-void init_diffusion_simd(void) {
-    if (optimal_mix_columns != NULL) {
-        return;
-    }
-    
+static void resolve_mix_columns(void) {
     optimal_mix_columns = get_optimal_implementation(
         (void*)mix_columns_original,      
         (void*)mix_columns_sse2,  
         (void*)mix_columns_avx,                     
         (void*)mix_columns_avx2,  
-        &g_opt_settings
+        get_optimization_settings()
     );
 }
 
+void init_diffusion_simd(void) {
+    pthread_once(&mix_columns_once, resolve_mix_columns);
+}
+
+// The entry points compiled without their extension forward to a lower
+// one, so name the code that actually runs
+const char* mix_columns_kernel(void) {
+    init_diffusion_simd();
+    if (optimal_mix_columns == mix_columns_avx2) return MIX_COLUMNS_AVX2_KERNEL;
+    if (optimal_mix_columns == mix_columns_avx) return MIX_COLUMNS_AVX_KERNEL;
+    if (optimal_mix_columns == mix_columns_sse2) return MIX_COLUMNS_SSE2_KERNEL;
+    return "scalar";
+}
+
 void mix_columns_simd(char** state) {
-    if (optimal_mix_columns == NULL) {
-        init_diffusion_simd();
-    }
+    init_diffusion_simd();
     optimal_mix_columns(state);
-}
\ No newline at end of file
+}
@@ -8,6 +8,7 @@
 #include "../../include/crypto/confusion.h"
 #include "../../include/crypto/diffusion.h"
 #include "../../include/crypto/key_expansion.h"
+#include "../../include/utils/trace.h"
 
 
 char* chunk_encryptor(char** state, char* final_pass, int block_size){
@@ -68,20 +69,16 @@ char** chain_encryptor(char*** states, char* initial_pass, int block_size, int n
 
 
 void single_state_encyption(char** state, char* final_key){
-    char* expanded_key = malloc(EXPANDED_KEY_SIZE);
-    if (expanded_key == NULL) {
-        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
-        return;
-    }
+    // Round keys live on the stack: this runs once per block on every hot path
+    char expanded_key[EXPANDED_KEY_SIZE];
     expand_key(final_key, 16, expanded_key, EXPANDED_KEY_SIZE);
-    add_round_key(state, expanded_key);
+    TRACE_PRIMITIVE(TRACE_ADD_ROUND_KEY, add_round_key(state, expanded_key));
     for (size_t round = 0; round < 10; round++) {
-        sub_bytes(state);
-        shift_rows(state);
+        TRACE_PRIMITIVE(TRACE_SUB_BYTES, sub_bytes(state));
+        TRACE_PRIMITIVE(TRACE_SHIFT_ROWS, shift_rows(state));
         if (round != 9){
-            mix_columns(state);
+            TRACE_PRIMITIVE(TRACE_MIX_COLUMNS, mix_columns(state));
         }        
-        add_round_key(state, expanded_key + ((round + 1) * STATE_SIZE * STATE_SIZE));
+        TRACE_PRIMITIVE(TRACE_ADD_ROUND_KEY, add_round_key(state, expanded_key + ((round + 1) * STATE_SIZE * STATE_SIZE)));
     }
-    free(expanded_key);
 }
\ No newline at end of file
@@ -0,0 +1,234 @@
+#include "../../include/crypto/ghash.h"
+#include <pthread.h>
+#include <string.h>
+#include "../../include/common/optimization.h"
+
+// Reduction constants for the 4-bit table method (Shoup)
+static const uint64_t last4[16] = {
+    0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+    0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+};
+
+static void (*optimal_ghash_blocks)(const GhashKey* key, uint64_t* y_hi, uint64_t* y_lo,
+                                    const unsigned char* blocks, size_t num_blocks) = NULL;
+static pthread_once_t ghash_once = PTHREAD_ONCE_INIT;
+
+static uint64_t load_be64(const unsigned char* p){
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) value = (value << 8) | p[i];
+    return value;
+}
+
+static void store_be64(unsigned char* p, uint64_t value){
+    for (int i = 7; i >= 0; i--) {
+        p[i] = (unsigned char)value;
+        value >>= 8;
+    }
+}
+
+// Bit-serial multiply from the GCM specification; only used a handful of
+// times per message to join segments
+void ghash_multiply(unsigned char x[GHASH_BLOCK_SIZE], const unsigned char y[GHASH_BLOCK_SIZE]){
+    uint64_t z_hi = 0, z_lo = 0;
+    uint64_t v_hi = load_be64(y), v_lo = load_be64(y + 8);
+
+    for (int i = 0; i < 128; i++) {
+        if ((x[i / 8] >> (7 - i % 8)) & 1) {
+            z_hi ^= v_hi;
+            z_lo ^= v_lo;
+        }
+        uint64_t carry = v_lo & 1;
+        v_lo = (v_lo >> 1) | (v_hi << 63);
+        v_hi = (v_hi >> 1) ^ (carry ? 0xe100000000000000ULL : 0);
+    }
+    store_be64(x, z_hi);
+    store_be64(x + 8, z_lo);
+}
+
+void ghash_power(const GhashKey* key, unsigned long long n, unsigned char out[GHASH_BLOCK_SIZE]){
+    unsigned char base[GHASH_BLOCK_SIZE];
+    store_be64(base, key->h_hi);
+    store_be64(base + 8, key->h_lo);
+    memset(out, 0, GHASH_BLOCK_SIZE);
+    out[0] = 0x80;  // the field's one
+    while (n > 0) {
+        if (n & 1) ghash_multiply(out, base);
+        ghash_multiply(base, base);
+        n >>= 1;
+    }
+}
+
+static void ghash_blocks_table(const GhashKey* key, uint64_t* y_hi, uint64_t* y_lo,
+                               const unsigned char* blocks, size_t num_blocks){
+    unsigned char x[GHASH_BLOCK_SIZE];
+    for (size_t b = 0; b < num_blocks; b++, blocks += GHASH_BLOCK_SIZE) {
+        store_be64(x, *y_hi ^ load_be64(blocks));
+        store_be64(x + 8, *y_lo ^ load_be64(blocks + 8));
+
+        uint64_t z_hi = key->table_hi[x[15] & 0xf];
+        uint64_t z_lo = key->table_lo[x[15] & 0xf];
+        for (int i = 15; i >= 0; i--) {
+            unsigned lo = x[i] & 0xf;
+            unsigned hi = x[i] >> 4;
+            unsigned rem;
+            if (i != 15) {
+                rem = (unsigned)(z_lo & 0xf);
+                z_lo = (z_hi << 60) | (z_lo >> 4);
+                z_hi = (z_hi >> 4) ^ (last4[rem] << 48);
+                z_hi ^= key->table_hi[lo];
+                z_lo ^= key->table_lo[lo];
+            }
+            rem = (unsigned)(z_lo & 0xf);
+            z_lo = (z_hi << 60) | (z_lo >> 4);
+            z_hi = (z_hi >> 4) ^ (last4[rem] << 48);
+            z_hi ^= key->table_hi[hi];
+            z_lo ^= key->table_lo[hi];
+        }
+        *y_hi = z_hi;
+        *y_lo = z_lo;
+    }
+}
+
+#if defined(__PCLMUL__) && defined(__SSSE3__)
+#include <immintrin.h>
+
+// Carry-less multiply with the shift-and-reduce of Gueron and Kounavis,
+// operating on byte-reversed (bit-reflected) values
+static __m128i clmul_gf128(__m128i a, __m128i b){
+    __m128i lo = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i mid = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+    __m128i hi = _mm_clmulepi64_si128(a, b, 0x11);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+    // Shift the 256-bit product left by one for the reflected convention
+    __m128i lo_carry = _mm_srli_epi32(lo, 31);
+    __m128i hi_carry = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    __m128i cross = _mm_srli_si128(lo_carry, 12);
+    hi_carry = _mm_slli_si128(hi_carry, 4);
+    lo_carry = _mm_slli_si128(lo_carry, 4);
+    lo = _mm_or_si128(lo, lo_carry);
+    hi = _mm_or_si128(hi, hi_carry);
+    hi = _mm_or_si128(hi, cross);
+
+    // Reduce modulo x^128 + x^7 + x^2 + x + 1
+    __m128i t = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+    __m128i t_high = _mm_srli_si128(t, 4);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(t, 12));
+    __m128i u = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+    u = _mm_xor_si128(u, t_high);
+    lo = _mm_xor_si128(lo, u);
+    return _mm_xor_si128(hi, lo);
+}
+
+static void ghash_blocks_pclmul(const GhashKey* key, uint64_t* y_hi, uint64_t* y_lo,
+                                const unsigned char* blocks, size_t num_blocks){
+    const __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i h = _mm_set_epi64x((long long)key->h_hi, (long long)key->h_lo);
+    __m128i y = _mm_set_epi64x((long long)*y_hi, (long long)*y_lo);
+
+    for (size_t b = 0; b < num_blocks; b++, blocks += GHASH_BLOCK_SIZE) {
+        __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)blocks), reverse);
+        y = clmul_gf128(_mm_xor_si128(y, x), h);
+    }
+    *y_hi = (uint64_t)_mm_extract_epi64(y, 1);
+    *y_lo = (uint64_t)_mm_cvtsi128_si64(y);
+}
+#endif
+
+static void resolve_ghash(void){
+    optimal_ghash_blocks = ghash_blocks_table;
+#if defined(__PCLMUL__) && defined(__SSSE3__)
+    const OptimizationSettings* settings = get_optimization_settings();
+    if (settings->current_level != OPT_LEVEL_NONE && HAS_PCLMUL(&settings->cpu_features)) {
+        optimal_ghash_blocks = ghash_blocks_pclmul;
+    }
+#endif
+}
+
+void init_ghash(void){
+    pthread_once(&ghash_once, resolve_ghash);
+}
+
+const char* ghash_kernel(void){
+    init_ghash();
+    return optimal_ghash_blocks == ghash_blocks_table ? "table" : "pclmul";
+}
+
+void ghash_key_init(GhashKey* key, const unsigned char h[GHASH_BLOCK_SIZE]){
+    uint64_t vh = load_be64(h);
+    uint64_t vl = load_be64(h + 8);
+
+    memset(key, 0, sizeof(GhashKey));
+    key->h_hi = vh;
+    key->h_lo = vl;
+    key->table_hi[8] = vh;
+    key->table_lo[8] = vl;
+    for (int i = 4; i > 0; i >>= 1) {
+        uint64_t carry = (vl & 1) ? 0xe100000000000000ULL : 0;
+        vl = (vh << 63) | (vl >> 1);
+        vh = (vh >> 1) ^ carry;
+        key->table_hi[i] = vh;
+        key->table_lo[i] = vl;
+    }
+    for (int i = 2; i <= 8; i *= 2) {
+        for (int j = 1; j < i; j++) {
+            key->table_hi[i + j] = key->table_hi[i] ^ key->table_hi[j];
+            key->table_lo[i + j] = key->table_lo[i] ^ key->table_lo[j];
+        }
+    }
+}
+
+void ghash_start(GhashState* state, const GhashKey* key){
+    init_ghash();
+    memset(state, 0, sizeof(GhashState));
+    state->key = key;
+}
+
+void ghash_resume(GhashState* state, const GhashKey* key, const unsigned char y[GHASH_BLOCK_SIZE],
+                  unsigned long long total_len){
+    ghash_start(state, key);
+    state->y_hi = load_be64(y);
+    state->y_lo = load_be64(y + 8);
+    state->total_len = total_len;
+}
+
+void ghash_peek(const GhashState* state, unsigned char y_out[GHASH_BLOCK_SIZE]){
+    store_be64(y_out, state->y_hi);
+    store_be64(y_out + 8, state->y_lo);
+}
+
+void ghash_update(GhashState* state, const void* data, size_t len){
+    const unsigned char* p = data;
+    state->total_len += len;
+
+    if (state->partial_len > 0) {
+        size_t take = GHASH_BLOCK_SIZE - state->partial_len;
+        if (take > len) take = len;
+        memcpy(state->partial + state->partial_len, p, take);
+        state->partial_len += take;
+        p += take;
+        len -= take;
+        if (state->partial_len < GHASH_BLOCK_SIZE) return;
+        optimal_ghash_blocks(state->key, &state->y_hi, &state->y_lo, state->partial, 1);
+        state->partial_len = 0;
+    }
+    size_t whole = len / GHASH_BLOCK_SIZE;
+    if (whole > 0) {
+        optimal_ghash_blocks(state->key, &state->y_hi, &state->y_lo, p, whole);
+    }
+    memcpy(state->partial, p + whole * GHASH_BLOCK_SIZE, len - whole * GHASH_BLOCK_SIZE);
+    state->partial_len = len - whole * GHASH_BLOCK_SIZE;
+}
+
+void ghash_flush(GhashState* state, unsigned char y_out[GHASH_BLOCK_SIZE]){
+    if (state->partial_len > 0) {
+        memset(state->partial + state->partial_len, 0, GHASH_BLOCK_SIZE - state->partial_len);
+        optimal_ghash_blocks(state->key, &state->y_hi, &state->y_lo, state->partial, 1);
+        state->partial_len = 0;
+    }
+    store_be64(y_out, state->y_hi);
+    store_be64(y_out + 8, state->y_lo);
+}
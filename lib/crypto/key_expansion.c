@@ -6,8 +6,9 @@
 #include "../../include/crypto/key_expansion.h"
 #include <stdint.h>
 #include "../../include/common/transformation_config.h"
+#include "../../include/utils/trace.h"
 
-void expand_key(const char* key, size_t key_size, char* expanded_key, size_t expanded_key_size)
+static void expand(const char* key, size_t key_size, char* expanded_key, size_t expanded_key_size)
 {
     if (key_size != STATE_SIZE * STATE_SIZE) {
         fprintf(stderr, "Invalid key size\n");
@@ -43,13 +44,21 @@ void expand_key(const char* key, size_t key_size, char* expanded_key, size_t exp
             }
 
             // Rcon
-            temp[0] ^= rcon[i / 4 - 1];
+            temp[0] ^= rcon[i / 4];
+        }
+
+        for (int j = 0; j < 4; j++) {
+            expanded_key[i * 4 + j] = expanded_key[(i - 4) * 4 + j] ^ temp[j];
         }
     }
 
 }
 
 
+void expand_key(const char* key, size_t key_size, char* expanded_key, size_t expanded_key_size)
+{
+    TRACE_PRIMITIVE(TRACE_KEY_EXPANSION, expand(key, key_size, expanded_key, expanded_key_size));
+}
 
 void print_expanded_key(const uint8_t *expanded_key) {
     for (int round = 0; round < 11; round++) {
@@ -0,0 +1,89 @@
+#include "../../include/crypto/mac.h"
+#include <stdio.h>
+#include <string.h>
+#include "../../include/crypto/cipher_context.h"
+#include "../../include/utils/conversion.h"
+
+// Domain-separated constants: each subkey is the encryption of its own
+// block under the file key, so neither reveals the other
+static const unsigned char hash_key_block[BLOCK_SIZE] = "axon:mac-hash:k1";
+static const unsigned char tag_key_block[BLOCK_SIZE] = "axon:mac-tag:k1!";
+
+void mac_key_init(MacKey* key, const char file_key[BLOCK_SIZE]){
+    unsigned char h[BLOCK_SIZE];
+    memset(key, 0, sizeof(MacKey));
+    axon_encrypt_block(file_key, hash_key_block, h);
+    axon_encrypt_block(file_key, tag_key_block, (unsigned char*)key->tag_key);
+    ghash_key_init(&key->hash_key, h);
+    memset(h, 0, sizeof(h));
+}
+
+void mac_key_wipe(MacKey* key){
+    volatile unsigned char* bytes = (volatile unsigned char*)key;
+    for (size_t i = 0; i < sizeof(MacKey); i++) {
+        bytes[i] = 0;
+    }
+}
+
+void mac_start(MacState* state, const MacKey* key){
+    ghash_start(&state->ghash, &key->hash_key);
+}
+
+void mac_update(MacState* state, const void* data, size_t len){
+    ghash_update(&state->ghash, data, len);
+}
+
+void mac_tag_from_hash(const MacKey* key, const unsigned char y[GHASH_BLOCK_SIZE],
+                       unsigned long long message_length, char tag_hex[MAC_TAG_HEX_SIZE + 1]){
+    unsigned char s[GHASH_BLOCK_SIZE];
+    unsigned char h[GHASH_BLOCK_SIZE];
+    unsigned long long bits = message_length * 8;
+
+    // Closing length block, as in GCM with no associated data
+    memcpy(s, y, GHASH_BLOCK_SIZE);
+    for (int i = 0; i < 8; i++) {
+        s[15 - i] ^= (unsigned char)(bits >> (8 * i));
+    }
+    ghash_power(&key->hash_key, 1, h);
+    ghash_multiply(s, h);
+
+    axon_encrypt_block(key->tag_key, s, s);
+    bytes_to_hex_into(s, GHASH_BLOCK_SIZE, tag_hex);
+    tag_hex[MAC_TAG_HEX_SIZE] = '\0';
+}
+
+void mac_finish(MacState* state, const MacKey* key, unsigned long long plain_length,
+                char trailer[MAC_TRAILER_SIZE]){
+    char text[MAC_TRAILER_SIZE + 1];
+    unsigned char y[GHASH_BLOCK_SIZE];
+
+    snprintf(text, sizeof(text), "%s%016llx", MAC_TRAILER_MAGIC, plain_length);
+    mac_update(state, text, MAC_AUTHENTICATED_PREFIX);
+    unsigned long long message_length = state->ghash.total_len;
+    ghash_flush(&state->ghash, y);
+    mac_tag_from_hash(key, y, message_length, text + MAC_AUTHENTICATED_PREFIX);
+    text[MAC_TRAILER_SIZE - 1] = '\n';
+    memcpy(trailer, text, MAC_TRAILER_SIZE);
+}
+
+int mac_parse_trailer(const unsigned char* trailer, unsigned long long* plain_length,
+                      char tag_hex[MAC_TAG_HEX_SIZE + 1]){
+    char text[MAC_AUTHENTICATED_PREFIX + 1];
+    size_t magic_len = strlen(MAC_TRAILER_MAGIC);
+
+    if (memcmp(trailer, MAC_TRAILER_MAGIC, magic_len) != 0 || trailer[MAC_TRAILER_SIZE - 1] != '\n') return -1;
+    memcpy(text, trailer, MAC_AUTHENTICATED_PREFIX);
+    text[MAC_AUTHENTICATED_PREFIX] = '\0';
+    if (sscanf(text + magic_len, "%16llx", plain_length) != 1) return -1;
+    memcpy(tag_hex, trailer + MAC_AUTHENTICATED_PREFIX, MAC_TAG_HEX_SIZE);
+    tag_hex[MAC_TAG_HEX_SIZE] = '\0';
+    return 0;
+}
+
+int mac_tags_equal(const char* a, const char* b){
+    unsigned char difference = 0;
+    for (size_t i = 0; i < MAC_TAG_HEX_SIZE; i++) {
+        difference |= (unsigned char)(a[i] ^ b[i]);
+    }
+    return difference == 0;
+}
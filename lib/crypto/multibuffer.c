@@ -0,0 +1,186 @@
+#include "../../include/crypto/multibuffer.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "../../include/common/config.h"
+#include "../../include/common/failures.h"
+#include "../../include/common/transformation_config.h"
+#include "../../include/crypto/key_expansion.h"
+#include "../../include/utils/conversion.h"
+#include "../../include/utils/progress.h"
+#include "../../include/utils/stats.h"
+#include "../../include/utils/trace.h"
+
+// A single chain is latency bound: the next block's key is the hex of the
+// current ciphertext. Independent chains have no such dependency, so their
+// rounds are interleaved here. States are stored byte-major with the lanes
+// contiguous ([byte][lane]), which keeps every step a short loop over
+// lanes that the compiler can unroll or vectorise.
+//
+// Byte i*STATE_SIZE + j is state[i][j] of the char** kernels, so the steps
+// below mirror sub_bytes, shift_rows, mix_columns_original and add_round_key.
+
+typedef uint8_t LaneBytes[MULTI_BUFFER_LANES];
+
+static uint8_t xtime(uint8_t byte){
+    return (uint8_t)((byte << 1) ^ ((byte >> 7) * 0x1b));
+}
+
+static void lanes_sub_bytes(LaneBytes* state, size_t num_lanes){
+    for (size_t b = 0; b < BLOCK_SIZE; b++) {
+        for (size_t l = 0; l < num_lanes; l++) {
+            state[b][l] = sbox[state[b][l]];
+        }
+    }
+}
+
+// Row i rotates left by i positions
+static void lanes_shift_rows(LaneBytes* state, size_t num_lanes){
+    LaneBytes row[STATE_SIZE];
+    for (size_t i = 1; i < STATE_SIZE; i++) {
+        memcpy(row, state + i * STATE_SIZE, sizeof(row));
+        for (size_t j = 0; j < STATE_SIZE; j++) {
+            for (size_t l = 0; l < num_lanes; l++) {
+                state[i * STATE_SIZE + j][l] = row[(j + i) % STATE_SIZE][l];
+            }
+        }
+    }
+}
+
+static void lanes_mix_columns(LaneBytes* state, size_t num_lanes){
+    for (size_t j = 0; j < STATE_SIZE; j++) {
+        for (size_t l = 0; l < num_lanes; l++) {
+            uint8_t a0 = state[j][l];
+            uint8_t a1 = state[STATE_SIZE + j][l];
+            uint8_t a2 = state[2 * STATE_SIZE + j][l];
+            uint8_t a3 = state[3 * STATE_SIZE + j][l];
+            uint8_t all = a0 ^ a1 ^ a2 ^ a3;
+            // 2a ^ 3b ^ c ^ d == a ^ all ^ xtime(a ^ b), and so on round the column
+            state[j][l] = a0 ^ all ^ xtime(a0 ^ a1);
+            state[STATE_SIZE + j][l] = a1 ^ all ^ xtime(a1 ^ a2);
+            state[2 * STATE_SIZE + j][l] = a2 ^ all ^ xtime(a2 ^ a3);
+            state[3 * STATE_SIZE + j][l] = a3 ^ all ^ xtime(a3 ^ a0);
+        }
+    }
+}
+
+static void lanes_add_round_key(LaneBytes* state, const LaneBytes* round_key, size_t num_lanes){
+    for (size_t b = 0; b < BLOCK_SIZE; b++) {
+        for (size_t l = 0; l < num_lanes; l++) {
+            state[b][l] ^= round_key[b][l];
+        }
+    }
+}
+
+void multi_buffer_encrypt_blocks(const unsigned char* const* blocks, const char* const* keys,
+                                 unsigned char* const* cipher_out, size_t num_lanes){
+    LaneBytes state[BLOCK_SIZE];
+    LaneBytes round_keys[EXPANDED_KEY_SIZE];
+    char expanded_key[EXPANDED_KEY_SIZE];
+
+    if (num_lanes > MULTI_BUFFER_LANES) num_lanes = MULTI_BUFFER_LANES;
+
+    for (size_t l = 0; l < num_lanes; l++) {
+        expand_key(keys[l], BLOCK_SIZE, expanded_key, EXPANDED_KEY_SIZE);
+        for (size_t b = 0; b < EXPANDED_KEY_SIZE; b++) {
+            round_keys[b][l] = (uint8_t)expanded_key[b];
+        }
+        for (size_t b = 0; b < BLOCK_SIZE; b++) {
+            state[b][l] = blocks[l][b];
+        }
+    }
+
+    TRACE_PRIMITIVE(TRACE_ADD_ROUND_KEY, lanes_add_round_key(state, round_keys, num_lanes));
+    for (size_t round = 0; round < 10; round++) {
+        TRACE_PRIMITIVE(TRACE_SUB_BYTES, lanes_sub_bytes(state, num_lanes));
+        TRACE_PRIMITIVE(TRACE_SHIFT_ROWS, lanes_shift_rows(state, num_lanes));
+        if (round != 9) {
+            TRACE_PRIMITIVE(TRACE_MIX_COLUMNS, lanes_mix_columns(state, num_lanes));
+        }
+        TRACE_PRIMITIVE(TRACE_ADD_ROUND_KEY, lanes_add_round_key(state, round_keys + (round + 1) * BLOCK_SIZE, num_lanes));
+    }
+
+    for (size_t l = 0; l < num_lanes; l++) {
+        for (size_t b = 0; b < BLOCK_SIZE; b++) {
+            cipher_out[l][b] = state[b][l];
+        }
+    }
+}
+
+int axon_cipher_update_lanes(AxonCipherContext* const* ctxs, const unsigned char* const* in,
+                             const size_t* in_len, unsigned char* const* out,
+                             const size_t* out_capacity, size_t* out_len, size_t num_lanes){
+    const unsigned char* cursor[MULTI_BUFFER_LANES];
+    size_t remaining[MULTI_BUFFER_LANES];
+    unsigned long long interleaved_blocks = 0;
+
+    if (num_lanes > MULTI_BUFFER_LANES) return -1;
+
+    for (size_t l = 0; l < num_lanes; l++) {
+        out_len[l] = 0;
+        cursor[l] = in[l];
+        remaining[l] = in_len[l];
+
+        if (ctxs[l]->mode != AXON_ENCRYPT) {
+            if (axon_cipher_update(ctxs[l], in[l], in_len[l], out[l], out_capacity[l], &out_len[l]) != 0) return -1;
+            remaining[l] = 0;
+            continue;
+        }
+        if (axon_cipher_output_bound(ctxs[l], in_len[l]) > out_capacity[l]) {
+            fprintf(stderr, "Output buffer too small\n");
+            return -1;
+        }
+        // Complete a block carried over from an earlier call on its own
+        if (ctxs[l]->partial_len > 0) {
+            size_t take = BLOCK_SIZE - ctxs[l]->partial_len;
+            if (take > remaining[l]) take = remaining[l];
+            axon_cipher_update(ctxs[l], cursor[l], take, out[l], out_capacity[l], &out_len[l]);
+            cursor[l] += take;
+            remaining[l] -= take;
+        }
+    }
+
+    for (;;) {
+        const unsigned char* blocks[MULTI_BUFFER_LANES];
+        const char* keys[MULTI_BUFFER_LANES];
+        unsigned char cipher_storage[MULTI_BUFFER_LANES][BLOCK_SIZE];
+        unsigned char* cipher[MULTI_BUFFER_LANES];
+        size_t active[MULTI_BUFFER_LANES];
+        size_t num_active = 0;
+
+        for (size_t l = 0; l < num_lanes; l++) {
+            if (remaining[l] < BLOCK_SIZE) continue;
+            blocks[num_active] = cursor[l];
+            keys[num_active] = ctxs[l]->chain_key;
+            cipher[num_active] = cipher_storage[num_active];
+            active[num_active++] = l;
+        }
+        if (num_active == 0) break;
+
+        multi_buffer_encrypt_blocks(blocks, keys, cipher, num_active);
+        interleaved_blocks += num_active;
+
+        for (size_t a = 0; a < num_active; a++) {
+            size_t l = active[a];
+            char* hex_out = (char*)out[l] + out_len[l];
+            bytes_to_hex_into(cipher[a], BLOCK_SIZE, hex_out);
+            memcpy(ctxs[l]->chain_key, hex_out, BLOCK_HEX_SIZE);
+            out_len[l] += BLOCK_HEX_SIZE;
+            cursor[l] += BLOCK_SIZE;
+            remaining[l] -= BLOCK_SIZE;
+        }
+    }
+
+    // Blocks taken through axon_cipher_update above are counted there
+    stats_add_cipher(interleaved_blocks * BLOCK_SIZE, interleaved_blocks * BLOCK_HEX_SIZE, interleaved_blocks);
+    PROGRESS_ADD(interleaved_blocks * BLOCK_SIZE);
+
+    // Whatever is left is shorter than a block and becomes the partial state
+    for (size_t l = 0; l < num_lanes; l++) {
+        if (remaining[l] == 0) continue;
+        size_t ignored = 0;
+        axon_cipher_update(ctxs[l], cursor[l], remaining[l], out[l] + out_len[l],
+                           out_capacity[l] - out_len[l], &ignored);
+    }
+    return 0;
+}
@@ -3,10 +3,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <pthread.h>
 
 OptimizationSettings g_opt_settings = {0};
 
-void init_optimization_settings(OptimizationSettings* settings) {
+// Set once g_opt_settings has been filled in, either explicitly by the
+// application at startup or lazily by the first kernel dispatch
+static int g_opt_settings_ready = 0;
+static pthread_once_t g_opt_settings_once = PTHREAD_ONCE_INIT;
+
+void detect_optimization_settings(OptimizationSettings* settings) {
     if (settings == NULL) return;
 
     memset(settings, 0, sizeof(OptimizationSettings));
@@ -40,8 +46,30 @@ void init_optimization_settings(OptimizationSettings* settings) {
         settings->current_level = OPT_LEVEL_NONE;
     }
 
-    printf("Axon initialized with optimization level: %s\n", 
-        get_optimization_level_name(settings->current_level));
+    if (settings == &g_opt_settings) {
+        g_opt_settings_ready = 1;
+    }
+}
+
+void init_optimization_settings(OptimizationSettings* settings) {
+    if (settings == NULL) return;
+
+    // The chosen level is reported by --stats, not on every run
+    detect_optimization_settings(settings);
+}
+
+static void init_default_optimization_settings(void) {
+    if (!g_opt_settings_ready) {
+        detect_optimization_settings(&g_opt_settings);
+    }
+}
+
+// Applications may configure g_opt_settings on their main thread before any
+// work starts; embedders that never do get CPU detection on first use. Either
+// way the settings are immutable once the first kernel has been resolved.
+const OptimizationSettings* get_optimization_settings(void) {
+    pthread_once(&g_opt_settings_once, init_default_optimization_settings);
+    return &g_opt_settings;
 }
 
 
@@ -49,7 +77,7 @@ void* get_optimal_implementation(void* original_func,
                                void* sse2_func, 
                                void* avx_func,
                                void* avx2_func,
-                               OptimizationSettings* settings) {
+                               const OptimizationSettings* settings) {
     switch (settings->current_level) {
         case OPT_LEVEL_AVX2:
             if (avx2_func) return avx2_func;            
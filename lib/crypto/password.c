@@ -3,8 +3,10 @@
 #include "../include/crypto/password_simd.h"
 #include "../include/common/config.h"
 #include "../include/common/optimization.h"
+#include "../include/utils/trace.h"
 #include <string.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 void chunker_original(char* key, int size, char* xor_res){
     if (key == NULL || xor_res == NULL || size <= 0) return;
@@ -29,25 +31,40 @@ void chunker_original(char* key, int size, char* xor_res){
 
 typedef void (*chunker_func_t)(char*, int, char*);
 
+// Written exactly once under pthread_once, read-only afterwards
 static chunker_func_t optimal_chunker = NULL;
+static pthread_once_t chunker_once = PTHREAD_ONCE_INIT;
+
+static void resolve_chunker(void) {
+    optimal_chunker = get_optimal_implementation(
+        (void*)chunker_original, 
+        (void*)chunker_sse2, 
+        (void*)chunker_avx, 
+        (void*)chunker_avx2,
+        get_optimization_settings());
+}
+
+void init_password_simd(void) {
+    pthread_once(&chunker_once, resolve_chunker);
+}
+
+const char* chunker_kernel(void) {
+    init_password_simd();
+    if (optimal_chunker == chunker_avx2) return CHUNKER_AVX2_KERNEL;
+    if (optimal_chunker == chunker_avx) return CHUNKER_AVX_KERNEL;
+    if (optimal_chunker == chunker_sse2) return "sse2";
+    return "scalar";
+}
 
 void chunker(char* key, int size, char* xor_res) {
-    if (optimal_chunker == NULL) {
-        optimal_chunker = get_optimal_implementation(
-            (void*)chunker_original, 
-            (void*)chunker_sse2, 
-            (void*)chunker_avx, 
-            (void*)chunker_avx2,
-            &g_opt_settings);
-    }
-    
+    init_password_simd();
     optimal_chunker(key, size, xor_res);
 }
 
 
 
 
-char* validate_password(const char* password){
+static char* fit_password(const char* password){
     if(password == NULL) {
         fprintf(stderr, NULL_PASSWORD);
         return NULL;
@@ -99,3 +116,10 @@ char* validate_password(const char* password){
     }
     return password_copy;
 }
+
+char* validate_password(const char* password){
+    TRACE_START(started);
+    char* final_pass = fit_password(password);
+    TRACE_SPAN(TRACE_PASSWORD, started);
+    return final_pass;
+}
@@ -17,7 +17,7 @@
         memset(key_local, 0, size + 1);
         strncpy(key_local, key, size);
 
-        int key_len = strlen(key);
+        int key_len = strlen(key_local); // only this chunk, key_local holds at most size bytes
         
         int i = 0;
         while (i <= key_len - 16) {
@@ -57,7 +57,7 @@
         memset(key_local, 0, size + 1);
         strncpy(key_local, key, size);
 
-        int key_len = strlen(key);
+        int key_len = strlen(key_local); // only this chunk, key_local holds at most size bytes
         
         int i = 0;
         while (i <= key_len - 32) {
@@ -106,7 +106,7 @@
         memset(key_local, 0, size + 1);
         strncpy(key_local, key, size);
 
-        int key_len = strlen(key);
+        int key_len = strlen(key_local); // only this chunk, key_local holds at most size bytes
         
         int i = 0;
         
@@ -0,0 +1,42 @@
+#ifdef _WIN32
+#define _CRT_RAND_S
+#endif
+#include "../../include/crypto/random.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RANDOM_FAILURE "Failed to read random bytes from the system\n"
+
+#ifdef _WIN32
+int random_bytes(void* out, size_t len){
+    unsigned char* bytes = out;
+    while (len > 0) {
+        unsigned int value;
+        if (rand_s(&value) != 0) {
+            fprintf(stderr, RANDOM_FAILURE);
+            return -1;
+        }
+        size_t take = len < sizeof(value) ? len : sizeof(value);
+        memcpy(bytes, &value, take);
+        bytes += take;
+        len -= take;
+    }
+    return 0;
+}
+#else
+int random_bytes(void* out, size_t len){
+    FILE* source = fopen("/dev/urandom", "rb");
+    size_t got = 0;
+    if (source) {
+        setvbuf(source, NULL, _IONBF, 0);
+        got = fread(out, 1, len, source);
+        fclose(source);
+    }
+    if (got != len) {
+        fprintf(stderr, RANDOM_FAILURE);
+        return -1;
+    }
+    return 0;
+}
+#endif
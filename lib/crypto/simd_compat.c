@@ -10,6 +10,7 @@
         features->has_sse4_1 = 0;
         features->has_avx = 0;
         features->has_avx2 = 0;
+        features->has_pclmul = 0;
         
         int cpu_info[4] = {0};
         
@@ -22,6 +23,7 @@
         // Check ECX register for SSE4.1 (bit 19) and AVX (bit 28)
         features->has_sse4_1 = (cpu_info[2] & (1 << 19)) != 0;
         features->has_avx = (cpu_info[2] & (1 << 28)) != 0;
+        features->has_pclmul = (cpu_info[2] & (1 << 1)) != 0;
         
         // Check for AVX2 which requires a different CPUID leaf
         if (features->has_avx) {
@@ -40,6 +42,7 @@
             features->has_sse4_1 = 0;
             features->has_avx = 0;
             features->has_avx2 = 0;
+            features->has_pclmul = 0;
             
             unsigned int eax, ebx, ecx, edx;
             
@@ -48,6 +51,7 @@
                 features->has_sse2 = (edx & (1 << 26)) != 0;
                 features->has_sse4_1 = (ecx & (1 << 19)) != 0;
                 features->has_avx = (ecx & (1 << 28)) != 0;
+                features->has_pclmul = (ecx & (1 << 1)) != 0;
                 
                 // Check for AVX2
                 if (features->has_avx) {
@@ -65,6 +69,7 @@
             features->has_sse4_1 = 0;
             features->has_avx = 0;
             features->has_avx2 = 0;
+            features->has_pclmul = 0;
             printf("CPU feature detection not supported on this architecture\n");
         }
     #endif
@@ -75,6 +80,7 @@
         features->has_sse4_1 = 0;
         features->has_avx = 0;
         features->has_avx2 = 0;
+        features->has_pclmul = 0;
         printf("CPU feature detection not supported with this compiler\n");
     }
 #endif
\ No newline at end of file
@@ -0,0 +1,400 @@
+#include "../../include/utils/batch.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "../../include/common/config.h"
+#include "../../include/common/failures.h"
+#include "../../include/crypto/multibuffer.h"
+#include "../../include/utils/fileio.h"
+#include "../../include/utils/memory_budget.h"
+#include "../../include/utils/stream.h"
+#include "../../include/utils/thread_pool.h"
+#include "../../include/utils/trace.h"
+
+#define BATCH_LINE_MAX 8192
+
+typedef struct {
+    AxonCipherMode mode;
+    StreamKeys keys;
+} BatchJob;
+
+// A task covers count consecutive entries; encryption runs them as the
+// lanes of one multi-buffer group
+typedef struct {
+    BatchJob* job;
+    BatchEntry* entry;
+    size_t count;
+} BatchTask;
+
+static char* join_path(const char* dir, const char* name){
+    size_t dir_len = strlen(dir);
+    while (dir_len > 1 && dir[dir_len - 1] == '/') dir_len--;
+    size_t len = dir_len + 1 + strlen(name) + 1;
+    char* path = malloc(len);
+    if (!path) {
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        return NULL;
+    }
+    snprintf(path, len, "%.*s/%s", (int)dir_len, dir, name);
+    return path;
+}
+
+static int add_entry(BatchPlan* plan, const char* source, const char* destination){
+    struct stat info;
+    if (stat(source, &info) != 0 || !S_ISREG(info.st_mode)) {
+        fprintf(stderr, "Skipping %s: not a regular file\n", source);
+        return 0;
+    }
+    if (plan->count == plan->capacity) {
+        size_t capacity = plan->capacity ? plan->capacity * 2 : DEFAULT_BUFFER;
+        BatchEntry* entries = realloc(plan->entries, capacity * sizeof(BatchEntry));
+        if (!entries) {
+            fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+            return -1;
+        }
+        plan->entries = entries;
+        plan->capacity = capacity;
+    }
+    BatchEntry* entry = &plan->entries[plan->count];
+    entry->source = strdup(source);
+    entry->destination = strdup(destination);
+    entry->size = (unsigned long long)info.st_size;
+    entry->status = -1;
+    if (!entry->source || !entry->destination) {
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        free(entry->source);
+        free(entry->destination);
+        return -1;
+    }
+    plan->count++;
+    return 0;
+}
+
+static int is_symlink(const char* path){
+#ifdef _WIN32
+    (void)path;
+    return 0;
+#else
+    struct stat info;
+    return lstat(path, &info) == 0 && S_ISLNK(info.st_mode);
+#endif
+}
+
+static int walk_directory(BatchPlan* plan, const char* source_dir, const char* dest_dir){
+    DIR* dir = opendir(source_dir);
+    if (!dir) {
+        fprintf(stderr, "Error opening directory: %s\n", source_dir);
+        return -1;
+    }
+
+    int status = 0;
+    struct dirent* item;
+    while (status == 0 && (item = readdir(dir)) != NULL) {
+        if (strcmp(item->d_name, ".") == 0 || strcmp(item->d_name, "..") == 0) continue;
+
+        char* source = join_path(source_dir, item->d_name);
+        char* destination = join_path(dest_dir, item->d_name);
+        if (!source || !destination) {
+            status = -1;
+        } else if (is_directory(source) && is_symlink(source)) {
+            // Not followed: a link to a parent would make the walk endless
+            fprintf(stderr, "Skipping %s: symbolic link to a directory\n", source);
+        } else if (is_directory(source)) {
+            status = walk_directory(plan, source, destination);
+        } else {
+            status = add_entry(plan, source, destination);
+        }
+        free(source);
+        free(destination);
+    }
+    closedir(dir);
+    return status;
+}
+
+static int read_list(BatchPlan* plan, const char* list_path, const char* dest_dir){
+    FILE* list = open_stream(list_path, "r");
+    if (!list) return -1;
+
+    char line[BATCH_LINE_MAX];
+    int status = 0;
+    while (status == 0 && fgets(line, sizeof(line), list)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') continue;
+
+        char* tab = strchr(line, '\t');
+        if (tab) {
+            *tab = '\0';
+            status = add_entry(plan, line, tab + 1);
+            continue;
+        }
+        // No explicit destination: mirror the listed path under dest_dir
+        const char* relative = line;
+        while (*relative == '/' || (relative[0] == '.' && relative[1] == '/')) {
+            relative += (*relative == '/') ? 1 : 2;
+        }
+        char* destination = join_path(dest_dir, relative);
+        status = destination ? add_entry(plan, line, destination) : -1;
+        free(destination);
+    }
+    close_stream(list);
+    return status;
+}
+
+int batch_plan_load(BatchPlan* plan, const char* source, const char* dest_dir){
+    memset(plan, 0, sizeof(BatchPlan));
+    int status = is_directory(source) ? walk_directory(plan, source, dest_dir)
+                                      : read_list(plan, source, dest_dir);
+    if (status != 0) batch_plan_free(plan);
+    return status;
+}
+
+void batch_plan_free(BatchPlan* plan){
+    for (size_t i = 0; i < plan->count; i++) {
+        free(plan->entries[i].source);
+        free(plan->entries[i].destination);
+    }
+    free(plan->entries);
+    memset(plan, 0, sizeof(BatchPlan));
+}
+
+static int compare_largest_first(const void* a, const void* b){
+    const BatchEntry* left = a;
+    const BatchEntry* right = b;
+    // Skipped entries go last so the runnable ones stay contiguous
+    int left_skipped = left->status == BATCH_ENTRY_SKIPPED;
+    int right_skipped = right->status == BATCH_ENTRY_SKIPPED;
+    if (left_skipped != right_skipped) return left_skipped - right_skipped;
+    if (left->size == right->size) return 0;
+    return left->size > right->size ? -1 : 1;
+}
+
+// Each output goes to a preallocated temporary that finish_entry renames
+// into place, so a failed or interrupted run never leaves a torn file
+static int open_entry(BatchJob* job, BatchEntry* entry, FILE** in, AtomicFile* out){
+    *in = NULL;
+    memset(out, 0, sizeof(AtomicFile));
+    if (make_parent_dirs(entry->destination) != 0) return -1;
+    *in = open_file(entry->source, "rb");
+    if (!*in) return -1;
+    return atomic_open(out, entry->destination, stream_output_size(job->mode, entry->source));
+}
+
+static void finish_entry(BatchEntry* entry, FILE* in, AtomicFile* out, int status){
+    if (in) fclose(in);
+    if (status == EXIT_SUCCESS && atomic_commit(out) != 0) status = EXIT_FAILURE;
+    atomic_abort(out);
+
+    if (status == EXIT_SUCCESS) {
+        entry->status = 0;
+    } else {
+        fprintf(stderr, "Failed: %s\n", entry->source);
+    }
+}
+
+static void run_entry(BatchJob* job, BatchEntry* entry, StreamBuffers* buffers){
+    FILE* in;
+    AtomicFile out;
+    int status = EXIT_FAILURE;
+    if (open_entry(job, entry, &in, &out) == 0) {
+        status = stream_run_container(in, out.file, job->mode, &job->keys, buffers);
+    }
+    finish_entry(entry, in, &out, status);
+}
+
+// Encrypts up to MULTI_BUFFER_LANES files together: every round reads the
+// next chunk of each open file and advances all their chains in lockstep.
+// A lane drops out as soon as its file ends or fails.
+static void run_lanes(BatchJob* job, BatchEntry* entries, size_t count, StreamBuffers* buffers){
+    StreamFile file[MULTI_BUFFER_LANES];
+    AxonCipherContext* lane_ctx[MULTI_BUFFER_LANES];
+    unsigned long long plain_length[MULTI_BUFFER_LANES];
+    FILE* in[MULTI_BUFFER_LANES];
+    AtomicFile out[MULTI_BUFFER_LANES];
+    size_t lane_of[MULTI_BUFFER_LANES];
+    size_t active = 0;
+
+    for (size_t l = 0; l < count; l++) {
+        if (open_entry(job, &entries[l], &in[l], &out[l]) != 0
+            || stream_begin_encrypt(out[l].file, &job->keys, &file[l]) != EXIT_SUCCESS) {
+            finish_entry(&entries[l], in[l], &out[l], EXIT_FAILURE);
+            continue;
+        }
+        plain_length[l] = 0;
+        lane_of[active++] = l;
+    }
+
+    while (active > 0) {
+        const unsigned char* lane_in[MULTI_BUFFER_LANES];
+        unsigned char* lane_out[MULTI_BUFFER_LANES];
+        size_t in_len[MULTI_BUFFER_LANES];
+        size_t out_capacity[MULTI_BUFFER_LANES];
+        size_t out_len[MULTI_BUFFER_LANES];
+
+        TRACE_START(read_started);
+        for (size_t a = 0; a < active; a++) {
+            size_t l = lane_of[a];
+            in_len[a] = fread(buffers[l].in, 1, STREAM_BUFFER_SIZE, in[l]);
+            lane_ctx[a] = &file[l].ctx;
+            lane_in[a] = buffers[l].in;
+            lane_out[a] = buffers[l].out;
+            out_capacity[a] = buffers[l].out_capacity;
+        }
+        TRACE_SPAN(TRACE_READ, read_started);
+        TRACE_START(cipher_started);
+        int updated = axon_cipher_update_lanes(lane_ctx, lane_in, in_len, lane_out, out_capacity, out_len, active);
+        TRACE_SPAN(TRACE_CIPHER, cipher_started);
+        if (updated != 0) {
+            fprintf(stderr, ENCRYPTION_FAILURE);
+            for (size_t a = 0; a < active; a++) {
+                size_t l = lane_of[a];
+                stream_file_wipe(&file[l]);
+                finish_entry(&entries[l], in[l], &out[l], EXIT_FAILURE);
+            }
+            return;
+        }
+
+        size_t still_active = 0;
+        for (size_t a = 0; a < active; a++) {
+            size_t l = lane_of[a];
+            int status = EXIT_SUCCESS;
+            mac_update(&file[l].mac, buffers[l].out, out_len[a]);
+            plain_length[l] += in_len[a];
+            TRACE_START(write_started);
+            size_t written = out_len[a] > 0 ? fwrite(buffers[l].out, 1, out_len[a], out[l].file) : 0;
+            TRACE_SPAN(TRACE_WRITE, write_started);
+            if (written != out_len[a]) {
+                fprintf(stderr, FILE_WRITE_FAILURE);
+                status = EXIT_FAILURE;
+            } else if (in_len[a] > 0) {
+                lane_of[still_active++] = l;
+                continue;
+            } else if (ferror(in[l])) {
+                fprintf(stderr, FILE_PROCESSING_FAILURE);
+                status = EXIT_FAILURE;
+            } else {
+                size_t tail_len = 0;
+                if (axon_cipher_final(&file[l].ctx, buffers[l].out, buffers[l].out_capacity, &tail_len) != 0
+                    || (tail_len > 0 && fwrite(buffers[l].out, 1, tail_len, out[l].file) != tail_len)) {
+                    fprintf(stderr, FILE_WRITE_FAILURE);
+                    status = EXIT_FAILURE;
+                } else {
+                    mac_update(&file[l].mac, buffers[l].out, tail_len);
+                    status = stream_end_encrypt(out[l].file, &file[l], plain_length[l]);
+                }
+            }
+            stream_file_wipe(&file[l]);
+            finish_entry(&entries[l], in[l], &out[l], status);
+        }
+        active = still_active;
+    }
+}
+
+// Lane buffers are held for one task only, so a worker waiting on the
+// memory budget is never the one holding what it waits for. The buffer
+// pool keeps them warm for the next task.
+static void run_task(void* arg){
+    BatchTask* task = arg;
+    StreamBuffers buffers[MULTI_BUFFER_LANES];
+    memset(buffers, 0, sizeof(buffers));
+
+    size_t ready = 0;
+    while (ready < task->count && stream_buffers_init(&buffers[ready]) == 0) ready++;
+    if (ready < task->count) {
+        for (size_t i = 0; i < task->count; i++) {
+            fprintf(stderr, "Failed: %s\n", task->entry[i].source);
+        }
+    } else if (task->count == 1) {
+        run_entry(task->job, task->entry, buffers);
+    } else {
+        run_lanes(task->job, task->entry, task->count, buffers);
+    }
+    for (size_t l = 0; l < ready; l++) stream_buffers_free(&buffers[l]);
+}
+
+int batch_run(BatchPlan* plan, AxonCipherMode mode, const char* password, size_t num_threads, BatchResult* result){
+    memset(result, 0, sizeof(BatchResult));
+
+    size_t runnable = 0;
+    for (size_t i = 0; i < plan->count; i++) {
+        if (plan->entries[i].status != BATCH_ENTRY_SKIPPED) runnable++;
+    }
+    result->skipped = plan->count - runnable;
+    if (runnable == 0) return 0;
+
+    BatchJob job;
+    memset(&job, 0, sizeof(job));
+    // The password is validated once; every file only derives its own keys
+    job.mode = mode;
+    if (stream_keys_init(&job.keys, password) != 0) return -1;
+
+    // Largest first so a big file picked up late cannot stretch the tail
+    qsort(plan->entries, plan->count, sizeof(BatchEntry), compare_largest_first);
+
+    if (num_threads == 0) num_threads = default_thread_count();
+    if (num_threads > runnable) num_threads = runnable;
+
+    // Encryption chains are serial, so once every thread has work the
+    // remaining files are spread across lanes instead. Neighbours in the
+    // sorted plan have similar sizes and finish together. Decryption keys
+    // come straight from the ciphertext and need no interleaving.
+    size_t lanes = 1;
+    if (mode == AXON_ENCRYPT) {
+        lanes = runnable / num_threads;
+        if (lanes < 1) lanes = 1;
+        if (lanes > MULTI_BUFFER_LANES) lanes = MULTI_BUFFER_LANES;
+    }
+    // Every worker holds a lane's buffers for each file of its task, so
+    // under a memory budget lanes give way first and then threads
+    size_t fits = memory_budget_fit(num_threads * lanes, stream_buffers_charge());
+    if (memory_budget_available() != 0 && stream_buffers_charge() > memory_budget_available()) {
+        fprintf(stderr, "--max-memory is too small: one file needs %zu bytes of buffers\n", stream_buffers_charge());
+        stream_keys_wipe(&job.keys);
+        return -1;
+    }
+    if (fits < num_threads * lanes) {
+        if (fits >= num_threads) {
+            lanes = fits / num_threads;
+        } else {
+            num_threads = fits;
+            lanes = 1;
+        }
+    }
+    size_t num_tasks = (runnable + lanes - 1) / lanes;
+
+    BatchTask* tasks = calloc(num_tasks, sizeof(BatchTask));
+    ThreadPool* pool = tasks ? thread_pool_create(num_threads) : NULL;
+    if (!pool) {
+        if (!tasks) fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        free(tasks);
+        stream_keys_wipe(&job.keys);
+        return -1;
+    }
+
+    for (size_t t = 0; t < num_tasks; t++) {
+        size_t first = t * lanes;
+        tasks[t].job = &job;
+        tasks[t].entry = &plan->entries[first];
+        tasks[t].count = runnable - first < lanes ? runnable - first : lanes;
+        if (thread_pool_submit(pool, run_task, &tasks[t]) != 0) {
+            for (size_t i = 0; i < tasks[t].count; i++) {
+                fprintf(stderr, "Failed: %s\n", tasks[t].entry[i].source);
+            }
+        }
+    }
+    thread_pool_wait(pool);
+    thread_pool_destroy(pool);
+
+    for (size_t i = 0; i < runnable; i++) {
+        if (plan->entries[i].status == 0) {
+            result->succeeded++;
+            result->bytes += plan->entries[i].size;
+        } else {
+            result->failed++;
+        }
+    }
+    free(tasks);
+    stream_keys_wipe(&job.keys);
+    return 0;
+}
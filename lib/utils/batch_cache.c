@@ -0,0 +1,283 @@
+#include "../../include/utils/batch_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "../../include/common/config.h"
+#include "../../include/common/failures.h"
+#include "../../include/crypto/container.h"
+#include "../../include/utils/buffer_pool.h"
+#include "../../include/utils/fileio.h"
+#include "../../include/utils/hash.h"
+
+#define CACHE_LINE_MAX (4 * 4096 + 512)
+#define NO_HASH 0  // recorded by stat runs; a hash check always redoes such a file
+
+#if defined(__APPLE__)
+#define STAT_MTIME_NSEC(info) ((info).st_mtimespec.tv_nsec)
+#elif defined(_WIN32)
+#define STAT_MTIME_NSEC(info) 0
+#else
+#define STAT_MTIME_NSEC(info) ((info).st_mtim.tv_nsec)
+#endif
+
+// Set when batch_cache_apply runs: a source modified at or after this
+// second may have changed while it was being processed, so it is not
+// recorded (the same rule git uses for racy index entries)
+static time_t run_started;
+
+static int stamp_file(const char* path, FileStamp* stamp){
+    struct stat info;
+    if (stat(path, &info) != 0) return -1;
+    stamp->size = (unsigned long long)info.st_size;
+    stamp->mtime_sec = (long long)info.st_mtime;
+    stamp->mtime_nsec = (long)STAT_MTIME_NSEC(info);
+    stamp->inode = (unsigned long long)info.st_ino;
+    return 0;
+}
+
+static int same_stamp(const FileStamp* a, const FileStamp* b){
+    return a->size == b->size && a->mtime_sec == b->mtime_sec
+        && a->mtime_nsec == b->mtime_nsec && a->inode == b->inode;
+}
+
+static int hash_file(const char* path, uint64_t* hash){
+    FILE* file = open_file(path, "rb");
+    unsigned char* buffer = buffer_pool_get(STREAM_BUFFER_SIZE);
+    int status = -1;
+    if (file && buffer) {
+        Hash64State state;
+        size_t bytes_read;
+        hash64_init(&state, 0);
+        while ((bytes_read = fread(buffer, 1, STREAM_BUFFER_SIZE, file)) > 0) {
+            hash64_update(&state, buffer, bytes_read);
+        }
+        if (!ferror(file)) {
+            *hash = hash64_final(&state);
+            status = 0;
+        }
+    }
+    if (file) fclose(file);
+    buffer_pool_put(buffer, STREAM_BUFFER_SIZE);
+    return status;
+}
+
+// Outputs made with another key must not count as up to date; the key
+// check value every container header carries identifies the key
+static int compute_key_check(const char* password, uint64_t* key_check){
+    ContainerHeader header;
+    if (container_header_init(&header, password) != 0) return -1;
+    *key_check = strtoull(header.kcv, NULL, 16);
+    return 0;
+}
+
+static int compare_records(const void* a, const void* b){
+    return strcmp(((const BatchCacheRecord*)a)->source, ((const BatchCacheRecord*)b)->source);
+}
+
+static BatchCacheRecord* find_record(BatchCache* cache, const char* source){
+    BatchCacheRecord key;
+    key.source = (char*)source;
+    BatchCacheRecord* record = bsearch(&key, cache->records, cache->sorted_count,
+                                       sizeof(BatchCacheRecord), compare_records);
+    for (size_t i = cache->sorted_count; !record && i < cache->count; i++) {
+        if (strcmp(cache->records[i].source, source) == 0) record = &cache->records[i];
+    }
+    return record;
+}
+
+static BatchCacheRecord* add_record(BatchCache* cache, const char* source, const char* destination){
+    if (cache->count == cache->capacity) {
+        size_t capacity = cache->capacity ? cache->capacity * 2 : DEFAULT_BUFFER;
+        BatchCacheRecord* records = realloc(cache->records, capacity * sizeof(BatchCacheRecord));
+        if (!records) {
+            fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+            return NULL;
+        }
+        cache->records = records;
+        cache->capacity = capacity;
+    }
+    BatchCacheRecord* record = &cache->records[cache->count];
+    memset(record, 0, sizeof(BatchCacheRecord));
+    record->source = strdup(source);
+    record->destination = strdup(destination);
+    if (!record->source || !record->destination) {
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        free(record->source);
+        free(record->destination);
+        return NULL;
+    }
+    cache->count++;
+    return record;
+}
+
+// mode, key check, source stamp and hash, output stamp, then both paths
+static int parse_record(BatchCache* cache, char* line){
+    BatchCacheRecord parsed;
+    unsigned long long key_check = 0;
+    unsigned long long source_hash = 0;
+    int paths_at = 0;
+    memset(&parsed, 0, sizeof(parsed));
+
+    if (sscanf(line, "%c\t%llx\t%llu\t%lld\t%ld\t%llu\t%llx\t%llu\t%lld\t%ld\t%llu\t%n",
+               &parsed.mode, &key_check,
+               &parsed.source_stamp.size, &parsed.source_stamp.mtime_sec,
+               &parsed.source_stamp.mtime_nsec, &parsed.source_stamp.inode, &source_hash,
+               &parsed.output_stamp.size, &parsed.output_stamp.mtime_sec,
+               &parsed.output_stamp.mtime_nsec, &parsed.output_stamp.inode, &paths_at) != 11
+        || paths_at == 0) {
+        return -1;
+    }
+    char* source = line + paths_at;
+    char* tab = strchr(source, '\t');
+    if (!tab) return -1;
+    *tab = '\0';
+
+    BatchCacheRecord* record = add_record(cache, source, tab + 1);
+    if (!record) return -1;
+    parsed.source = record->source;
+    parsed.destination = record->destination;
+    parsed.key_check = key_check;
+    parsed.source_hash = source_hash;
+    *record = parsed;
+    return 0;
+}
+
+int batch_cache_load(BatchCache* cache, const char* path, AxonCipherMode mode, const char* password){
+    memset(cache, 0, sizeof(BatchCache));
+    cache->mode = mode == AXON_ENCRYPT ? 'e' : 'd';
+    if (compute_key_check(password, &cache->key_check) != 0) return -1;
+
+    FILE* file = fopen(path, "r");
+    if (!file) return 0;
+
+    char* line = malloc(CACHE_LINE_MAX);
+    if (!line) {
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        fclose(file);
+        return -1;
+    }
+    unsigned int version = 0;
+    if (!fgets(line, CACHE_LINE_MAX, file)
+        || sscanf(line, BATCH_CACHE_MAGIC "\t%u", &version) != 1 || version != BATCH_CACHE_VERSION) {
+        // An unreadable cache only costs a full run, so start over
+        fprintf(stderr, "Ignoring unrecognised cache file: %s\n", path);
+    } else {
+        while (fgets(line, CACHE_LINE_MAX, file)) {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (parse_record(cache, line) != 0) {
+                fprintf(stderr, "Ignoring damaged cache line in %s\n", path);
+            }
+        }
+    }
+    free(line);
+    fclose(file);
+
+    qsort(cache->records, cache->count, sizeof(BatchCacheRecord), compare_records);
+    cache->sorted_count = cache->count;
+    return 0;
+}
+
+size_t batch_cache_apply(BatchCache* cache, BatchPlan* plan, int verify_hash){
+    size_t skipped = 0;
+    run_started = time(NULL);
+
+    for (size_t i = 0; i < plan->count; i++) {
+        BatchEntry* entry = &plan->entries[i];
+        BatchCacheRecord* record = find_record(cache, entry->source);
+        FileStamp source_stamp;
+        FileStamp output_stamp;
+        uint64_t hash = 0;
+
+        if (!record || record->mode != cache->mode || record->key_check != cache->key_check
+            || strcmp(record->destination, entry->destination) != 0
+            || stamp_file(entry->source, &source_stamp) != 0 || !same_stamp(&source_stamp, &record->source_stamp)
+            || stamp_file(entry->destination, &output_stamp) != 0 || !same_stamp(&output_stamp, &record->output_stamp)) {
+            continue;
+        }
+        if (verify_hash && (record->source_hash == NO_HASH || hash_file(entry->source, &hash) != 0
+                            || hash != record->source_hash)) {
+            continue;
+        }
+
+        entry->status = BATCH_ENTRY_SKIPPED;
+        skipped++;
+    }
+    return skipped;
+}
+
+void batch_cache_record(BatchCache* cache, const BatchPlan* plan, int hash_sources){
+    for (size_t i = 0; i < plan->count; i++) {
+        const BatchEntry* entry = &plan->entries[i];
+        if (entry->status != 0) continue;
+
+        BatchCacheRecord* record = find_record(cache, entry->source);
+        if (!record) record = add_record(cache, entry->source, entry->destination);
+        if (!record) return;
+
+        FileStamp source_stamp;
+        FileStamp output_stamp;
+        uint64_t hash = NO_HASH;
+        if (stamp_file(entry->source, &source_stamp) != 0 || source_stamp.mtime_sec >= (long long)run_started
+            || (hash_sources && hash_file(entry->source, &hash) != 0)
+            || stamp_file(entry->destination, &output_stamp) != 0) {
+            // Not trustworthy: drop the record so the next run redoes the file
+            record->mode = 0;
+            continue;
+        }
+        if (strcmp(record->destination, entry->destination) != 0) {
+            char* destination = strdup(entry->destination);
+            if (!destination) {
+                record->mode = 0;
+                continue;
+            }
+            free(record->destination);
+            record->destination = destination;
+        }
+        record->mode = cache->mode;
+        record->key_check = cache->key_check;
+        record->source_stamp = source_stamp;
+        record->source_hash = hash;
+        record->output_stamp = output_stamp;
+    }
+}
+
+int batch_cache_save(BatchCache* cache, const char* path){
+    qsort(cache->records, cache->count, sizeof(BatchCacheRecord), compare_records);
+    cache->sorted_count = cache->count;
+
+    AtomicFile file;
+    if (make_parent_dirs(path) != 0 || atomic_open(&file, path, 0) != 0) {
+        fprintf(stderr, "Failed to write cache file: %s\n", path);
+        return -1;
+    }
+    fprintf(file.file, "%s\t%u\n", BATCH_CACHE_MAGIC, BATCH_CACHE_VERSION);
+    for (size_t i = 0; i < cache->count; i++) {
+        const BatchCacheRecord* r = &cache->records[i];
+        // The format is line and tab separated; such paths are simply not cached
+        if (r->mode == 0 || strpbrk(r->source, "\t\r\n") || strpbrk(r->destination, "\t\r\n")) continue;
+        fprintf(file.file, "%c\t%016llx\t%llu\t%lld\t%ld\t%llu\t%016llx\t%llu\t%lld\t%ld\t%llu\t%s\t%s\n",
+                r->mode, (unsigned long long)r->key_check,
+                r->source_stamp.size, r->source_stamp.mtime_sec, r->source_stamp.mtime_nsec,
+                r->source_stamp.inode, (unsigned long long)r->source_hash,
+                r->output_stamp.size, r->output_stamp.mtime_sec, r->output_stamp.mtime_nsec,
+                r->output_stamp.inode, r->source, r->destination);
+    }
+    if (ferror(file.file)) {
+        atomic_abort(&file);
+    } else if (atomic_commit(&file) == 0) {
+        return 0;
+    }
+    fprintf(stderr, "Failed to write cache file: %s\n", path);
+    return -1;
+}
+
+void batch_cache_free(BatchCache* cache){
+    for (size_t i = 0; i < cache->count; i++) {
+        free(cache->records[i].source);
+        free(cache->records[i].destination);
+    }
+    free(cache->records);
+    memset(cache, 0, sizeof(BatchCache));
+}
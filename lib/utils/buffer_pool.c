@@ -0,0 +1,353 @@
+#include "../../include/utils/buffer_pool.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../../include/common/failures.h"
+#include "../../include/utils/memory_budget.h"
+#include "../../include/utils/topology.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#define BUFFER_POOL_CLASSES 16
+// One fault on a huge page commits all 2 MiB of it, which a tight
+// --max-memory cannot absorb
+#define BUFFER_POOL_HUGE_MIN_BUDGET (64ULL * 1024 * 1024)
+// Empty mappings kept under a limit, so a job that takes and returns one
+// buffer at a time does not map and fault it in every time
+#define BUFFER_POOL_IDLE_RESERVE (8ULL * 1024 * 1024)
+
+// A returned buffer stores the link to the next one in its first bytes
+typedef struct FreeBuffer {
+    struct FreeBuffer* next;
+} FreeBuffer;
+
+typedef struct {
+    size_t size;
+    FreeBuffer* free;
+} SizeClass;
+
+// One mapping: a shared 2 MiB arena, or a buffer mapped on its own.
+// live counts the buffers handed out of it and not yet returned; an idle
+// one has none out and is held in the reserve. node is the NUMA node of the
+// thread that mapped it, and so of its pages; the budget charge is
+// released on behalf of that thread, whichever one unmaps it.
+typedef struct {
+    unsigned char* base;
+    size_t size;
+    size_t used;
+    size_t live;
+    size_t node;
+    pthread_t holder;
+    int idle;
+} Arena;
+
+// One pool per NUMA node. Memory is placed by first touch, and the thread
+// that takes a fresh buffer is the one that writes it, so a node's free
+// lists only hold memory that lives on that node.
+typedef struct {
+    SizeClass classes[BUFFER_POOL_CLASSES];
+    size_t num_classes;
+    Arena* arena;
+} NodePool;
+
+static NodePool nodes[TOPOLOGY_MAX_NODES];
+static Arena** arenas;
+static size_t num_arenas;
+static size_t arenas_capacity;
+static unsigned long long idle_bytes;
+static BufferPoolStats totals;
+#if defined(MAP_HUGETLB)
+static int no_hugetlb;
+#endif
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t round_up(size_t size, size_t unit){
+    return (size + unit - 1) / unit * unit;
+}
+
+// Huge pages only pay off once the budget can absorb whole 2 MiB faults
+static int want_huge_pages(void){
+    unsigned long long budget = memory_budget_available();
+    return budget == 0 || budget >= BUFFER_POOL_HUGE_MIN_BUDGET;
+}
+
+// Without huge pages an arena saves nothing, so a small budget maps every
+// buffer on its own and is charged for no more than the buffer
+static size_t mapping_size(size_t size){
+    if (!want_huge_pages()) return size;
+    return round_up(size, BUFFER_POOL_ARENA_SIZE);
+}
+
+size_t buffer_pool_charge(size_t size){
+    size = round_up(size ? size : 1, BUFFER_POOL_ALIGNMENT);
+    if (size >= BUFFER_POOL_ARENA_SIZE || !want_huge_pages()) return mapping_size(size);
+    // Its share of an arena filled with buffers of its size, including the
+    // end too small for one more
+    size_t per_arena = BUFFER_POOL_ARENA_SIZE / size;
+    return (BUFFER_POOL_ARENA_SIZE + per_arena - 1) / per_arena;
+}
+
+// A quarter of the budget at most, so the reserve never crowds out work
+static unsigned long long idle_limit(void){
+    unsigned long long limit = memory_budget_available() / 4;
+    return limit < BUFFER_POOL_IDLE_RESERVE ? limit : BUFFER_POOL_IDLE_RESERVE;
+}
+
+#ifndef _WIN32
+// Over-maps by one arena so the start can be aligned to a huge page
+static void* map_aligned(size_t size){
+    void* mapped = mmap(NULL, size + BUFFER_POOL_ARENA_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) return NULL;
+    uintptr_t start = (uintptr_t)mapped;
+    uintptr_t aligned = round_up(start, BUFFER_POOL_ARENA_SIZE);
+    if (aligned > start) munmap(mapped, aligned - start);
+    size_t tail = BUFFER_POOL_ARENA_SIZE - (aligned - start);
+    if (tail > 0) munmap((void*)(aligned + size), tail);
+    return (void*)aligned;
+}
+#endif
+
+static void* map_memory(size_t size){
+    int want_huge = want_huge_pages();
+#ifndef _WIN32
+    if (!want_huge) {
+        void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return memory == MAP_FAILED ? NULL : memory;
+    }
+#endif
+#if defined(MAP_HUGETLB)
+    // Only succeeds where huge pages have been reserved (vm.nr_hugepages),
+    // so the first failure stops further attempts
+    if (!no_hugetlb) {
+        void* huge = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (huge != MAP_FAILED) {
+            totals.huge_pages = 1;
+            return huge;
+        }
+        no_hugetlb = 1;
+    }
+#endif
+#ifndef _WIN32
+    void* memory = map_aligned(size);
+#if defined(MADV_HUGEPAGE)
+    if (memory && madvise(memory, size, MADV_HUGEPAGE) == 0 && totals.huge_pages == 0) {
+        totals.huge_pages = 2;
+    }
+#endif
+    return memory;
+#else
+    (void)want_huge;
+    return malloc(size);
+#endif
+}
+
+static void unmap_memory(void* memory, size_t size){
+#ifndef _WIN32
+    munmap(memory, size);
+#else
+    (void)size;
+    free(memory);
+#endif
+}
+
+static SizeClass* find_class(NodePool* node, size_t size){
+    for (size_t i = 0; i < node->num_classes; i++) {
+        if (node->classes[i].size == size) return &node->classes[i];
+    }
+    if (node->num_classes == BUFFER_POOL_CLASSES) return NULL;
+    node->classes[node->num_classes].size = size;
+    node->classes[node->num_classes].free = NULL;
+    return &node->classes[node->num_classes++];
+}
+
+static Arena* find_arena(const void* buffer){
+    const unsigned char* bytes = buffer;
+    for (size_t i = 0; i < num_arenas; i++) {
+        if (bytes >= arenas[i]->base && bytes < arenas[i]->base + arenas[i]->size) return arenas[i];
+    }
+    return NULL;
+}
+
+static int add_arena(Arena* arena){
+    if (num_arenas == arenas_capacity) {
+        size_t capacity = arenas_capacity ? arenas_capacity * 2 : 16;
+        Arena** grown = realloc(arenas, capacity * sizeof(Arena*));
+        if (!grown) return -1;
+        arenas = grown;
+        arenas_capacity = capacity;
+    }
+    arenas[num_arenas++] = arena;
+    return 0;
+}
+
+// Takes an arena nothing is using out of the pool: its returned buffers
+// leave the free lists and it stops being anyone's current arena. The
+// caller unmaps it and gives its charge back once the lock is dropped.
+static void detach_arena(Arena* arena){
+    for (size_t n = 0; n < TOPOLOGY_MAX_NODES; n++) {
+        if (nodes[n].arena == arena) nodes[n].arena = NULL;
+        for (size_t c = 0; c < nodes[n].num_classes; c++) {
+            FreeBuffer** link = &nodes[n].classes[c].free;
+            while (*link) {
+                unsigned char* entry = (unsigned char*)*link;
+                if (entry >= arena->base && entry < arena->base + arena->size) {
+                    *link = (*link)->next;
+                } else {
+                    link = &(*link)->next;
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < num_arenas; i++) {
+        if (arenas[i] == arena) {
+            arenas[i] = arenas[--num_arenas];
+            break;
+        }
+    }
+    if (arena->idle) idle_bytes -= arena->size;
+    totals.mapped_bytes -= arena->size;
+}
+
+static void free_arena(Arena* arena){
+    unmap_memory(arena->base, arena->size);
+    memory_budget_release_for(arena->holder, arena->size);
+    free(arena);
+}
+
+// Hands the reserve back to the budget for a caller that has to wait
+static void reclaim_idle(void){
+    for (;;) {
+        Arena* idle = NULL;
+        pthread_mutex_lock(&pool_lock);
+        for (size_t i = 0; i < num_arenas && !idle; i++) {
+            if (arenas[i]->idle) idle = arenas[i];
+        }
+        if (idle) detach_arena(idle);
+        pthread_mutex_unlock(&pool_lock);
+        if (!idle) return;
+        free_arena(idle);
+    }
+}
+
+// Under --max-memory every mapping is charged to the budget as a whole,
+// so waiting for room happens here, outside the pool lock
+static Arena* map_arena(size_t size, size_t node){
+    Arena* arena = calloc(1, sizeof(Arena));
+    if (!arena) return NULL;
+    arena->size = mapping_size(size);
+    arena->node = node;
+    arena->holder = pthread_self();
+    if (memory_budget_acquire_reclaiming(arena->size, reclaim_idle) != 0) {
+        free(arena);
+        return NULL;
+    }
+    arena->base = map_memory(arena->size);
+    if (!arena->base) {
+        memory_budget_release(arena->size);
+        free(arena);
+        return NULL;
+    }
+    return arena;
+}
+
+static void claim(Arena* arena){
+    if (arena->live++ == 0 && arena->idle) {
+        arena->idle = 0;
+        idle_bytes -= arena->size;
+    }
+}
+
+static void* take_from(Arena* arena, size_t size){
+    void* buffer = arena->base + arena->used;
+    arena->used += size;
+    claim(arena);
+    return buffer;
+}
+
+static void* take_free(NodePool* node, size_t size){
+    SizeClass* class = find_class(node, size);
+    if (!class || !class->free) return NULL;
+    FreeBuffer* buffer = class->free;
+    class->free = buffer->next;
+    Arena* arena = find_arena(buffer);
+    if (arena) claim(arena);
+    totals.hits++;
+    return buffer;
+}
+
+void* buffer_pool_get(size_t size){
+    size = round_up(size ? size : 1, BUFFER_POOL_ALIGNMENT);
+    size_t node_index = topology_current_node() % TOPOLOGY_MAX_NODES;
+    NodePool* node = &nodes[node_index];
+    pthread_mutex_lock(&pool_lock);
+    void* buffer = take_free(node, size);
+    // Small buffers are carved from the node's current arena
+    if (!buffer && node->arena && node->arena->size - node->arena->used >= size) {
+        buffer = take_from(node->arena, size);
+        totals.misses++;
+    }
+    pthread_mutex_unlock(&pool_lock);
+    if (buffer) return buffer;
+
+    Arena* arena = map_arena(size, node_index);
+    pthread_mutex_lock(&pool_lock);
+    if (arena && add_arena(arena) != 0) {
+        pthread_mutex_unlock(&pool_lock);
+        free_arena(arena);
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        return NULL;
+    }
+    if (arena) {
+        totals.mapped_bytes += arena->size;
+        totals.misses++;
+        buffer = take_from(arena, size);
+        // What is left of the previous arena is abandoned; under a limit
+        // it goes back once its last buffer does
+        if (arena->size - arena->used >= BUFFER_POOL_ALIGNMENT) node->arena = arena;
+    }
+    pthread_mutex_unlock(&pool_lock);
+    if (!buffer) fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+    return buffer;
+}
+
+void buffer_pool_put(void* buffer, size_t size){
+    if (!buffer) return;
+    size = round_up(size ? size : 1, BUFFER_POOL_ALIGNMENT);
+    Arena* idle = NULL;
+    pthread_mutex_lock(&pool_lock);
+    Arena* arena = find_arena(buffer);
+    // Back to the node its memory lives on, whichever thread frees it
+    NodePool* node = &nodes[arena ? arena->node : (size_t)topology_current_node() % TOPOLOGY_MAX_NODES];
+    if (arena && arena->live > 0) arena->live--;
+    // Without a limit the memory stays for the next job. Under one an
+    // arena whose buffers are all back joins the reserve if it fits and
+    // nobody is waiting for room; otherwise it leaves the budget.
+    int emptied = arena && arena->live == 0 && memory_budget_available() != 0;
+    if (emptied && (memory_budget_waiting() || idle_bytes + arena->size > idle_limit())) {
+        detach_arena(arena);
+        idle = arena;
+    } else {
+        if (emptied) {
+            arena->idle = 1;
+            idle_bytes += arena->size;
+        }
+        SizeClass* class = find_class(node, size);
+        // With every class taken the buffer is simply dropped; it comes
+        // back with its arena
+        if (class) {
+            FreeBuffer* entry = buffer;
+            entry->next = class->free;
+            class->free = entry;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+    if (idle) free_arena(idle);
+}
+
+void buffer_pool_stats(BufferPoolStats* stats){
+    pthread_mutex_lock(&pool_lock);
+    *stats = totals;
+    pthread_mutex_unlock(&pool_lock);
+}
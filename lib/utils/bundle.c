@@ -0,0 +1,573 @@
+#include "../../include/utils/bundle.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../include/common/config.h"
+#include "../../include/common/failures.h"
+#include "../../include/crypto/random.h"
+#include "../../include/utils/fileio.h"
+#include "../../include/utils/stream.h"
+
+#define BUNDLE_CORRUPT "Bundle is corrupt or was modified\n"
+#define MEMBER_LABEL "axbmembr"
+#define INDEX_LABEL "axbindex"
+
+typedef struct {
+    unsigned long long offset;
+    unsigned long long size;
+    const char* tag;
+    const char* name;
+} BundleMember;
+
+typedef struct {
+    char* text;
+    size_t length;
+    size_t capacity;
+} IndexBuffer;
+
+static int index_append(IndexBuffer* index, unsigned long long offset, unsigned long long size,
+                        const char* tag, const char* name){
+    size_t needed = strlen(name) + 2 * 21 + MAC_TAG_HEX_SIZE + 4;
+    if (index->length + needed > index->capacity) {
+        size_t capacity = index->capacity ? index->capacity * 2 : STREAM_BUFFER_SIZE;
+        while (capacity < index->length + needed) capacity *= 2;
+        char* text = realloc(index->text, capacity);
+        if (!text) {
+            fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+            return -1;
+        }
+        index->text = text;
+        index->capacity = capacity;
+    }
+    index->length += (size_t)snprintf(index->text + index->length, index->capacity - index->length,
+                                      "%llu\t%llu\t%s\t%s\n", offset, size, tag, name);
+    return 0;
+}
+
+// Every member and the index start their own chain from a key derived from
+// the bundle's data key, E_data_key(label || ordinal), so no two chains in
+// a bundle, or across bundles, begin alike
+static void derive_key(const char data_key[BLOCK_SIZE], const char* label, unsigned long long ordinal,
+                       char key[BLOCK_SIZE]){
+    unsigned char block[BLOCK_SIZE];
+    memcpy(block, label, 8);
+    for (int i = 0; i < 8; i++) {
+        block[8 + i] = (unsigned char)(ordinal >> (56 - 8 * i));
+    }
+    axon_encrypt_block(data_key, block, (unsigned char*)key);
+}
+
+static void format_header(const ContainerHeader* key_slot, unsigned long long index_offset,
+                          unsigned long long index_length, char out[BUNDLE_HEADER_SIZE]){
+    char prefix[BUNDLE_PREFIX_SIZE + 1];
+    snprintf(prefix, sizeof(prefix), "%s%02x%016llx%016llx", BUNDLE_MAGIC, BUNDLE_VERSION,
+             index_offset, index_length);
+    memcpy(out, prefix, BUNDLE_PREFIX_SIZE);
+    container_header_format(key_slot, out + BUNDLE_PREFIX_SIZE);
+}
+
+static int write_header(FILE* bundle, const char header[BUNDLE_HEADER_SIZE]){
+    if (seek_file(bundle, 0) != 0 || fwrite(header, 1, BUNDLE_HEADER_SIZE, bundle) != BUNDLE_HEADER_SIZE) {
+        fprintf(stderr, FILE_WRITE_FAILURE);
+        return -1;
+    }
+    return 0;
+}
+
+// Streams one file into the bundle, reporting how many plaintext bytes it
+// held and the tag over its ciphertext
+static int pack_member(FILE* in, FILE* bundle, const char key[BLOCK_SIZE], StreamBuffers* buffers,
+                       unsigned long long* plain_size, char tag[MAC_TAG_HEX_SIZE + 1]){
+    AxonCipherContext ctx;
+    MacKey mac_key;
+    MacState mac;
+    char trailer[MAC_TRAILER_SIZE];
+    int status = 0;
+
+    *plain_size = 0;
+    axon_cipher_init_key(&ctx, AXON_ENCRYPT, key);
+    mac_key_init(&mac_key, key);
+    mac_start(&mac, &mac_key);
+    for (;;) {
+        size_t bytes_read = fread(buffers->in, 1, STREAM_BUFFER_SIZE, in);
+        if (bytes_read == 0) {
+            if (ferror(in)) {
+                fprintf(stderr, FILE_PROCESSING_FAILURE);
+                status = -1;
+            }
+            break;
+        }
+        *plain_size += bytes_read;
+
+        size_t out_len = 0;
+        if (axon_cipher_update(&ctx, buffers->in, bytes_read, buffers->out, buffers->out_capacity, &out_len) != 0
+            || fwrite(buffers->out, 1, out_len, bundle) != out_len) {
+            fprintf(stderr, FILE_WRITE_FAILURE);
+            status = -1;
+            break;
+        }
+        mac_update(&mac, buffers->out, out_len);
+    }
+    size_t tail_len = 0;
+    if (status == 0 && (axon_cipher_final(&ctx, buffers->out, buffers->out_capacity, &tail_len) != 0
+                        || fwrite(buffers->out, 1, tail_len, bundle) != tail_len)) {
+        fprintf(stderr, FILE_WRITE_FAILURE);
+        status = -1;
+    }
+    if (status == 0) {
+        mac_update(&mac, buffers->out, tail_len);
+        mac_finish(&mac, &mac_key, *plain_size, trailer);
+        memcpy(tag, trailer + MAC_AUTHENTICATED_PREFIX, MAC_TAG_HEX_SIZE);
+        tag[MAC_TAG_HEX_SIZE] = '\0';
+    }
+    axon_cipher_wipe(&ctx);
+    mac_key_wipe(&mac_key);
+    return status;
+}
+
+static int pack_members(BatchPlan* plan, FILE* bundle, const char data_key[BLOCK_SIZE],
+                        IndexBuffer* index, BatchResult* result){
+    StreamBuffers buffers;
+    if (stream_buffers_init(&buffers) != 0) return -1;
+
+    unsigned long long offset = BUNDLE_HEADER_SIZE;
+    unsigned long long ordinal = 0;
+    int status = 0;
+    for (size_t i = 0; status == 0 && i < plan->count; i++) {
+        BatchEntry* entry = &plan->entries[i];
+        // batch_plan_load mirrored every source under "."
+        const char* name = entry->destination;
+        if (strncmp(name, "./", 2) == 0) name += 2;
+        if (strchr(name, '\n')) {
+            fprintf(stderr, "Skipping %s: name contains a newline\n", entry->source);
+            result->failed++;
+            continue;
+        }
+
+        FILE* in = open_file(entry->source, "rb");
+        if (!in) {
+            fprintf(stderr, "Failed: %s\n", entry->source);
+            result->failed++;
+            continue;
+        }
+        // Every member starts a fresh chain, which is what makes it
+        // independently extractable; its key is its line in the index
+        char key[BLOCK_SIZE];
+        char tag[MAC_TAG_HEX_SIZE + 1];
+        unsigned long long plain_size = 0;
+        derive_key(data_key, MEMBER_LABEL, ordinal, key);
+        status = pack_member(in, bundle, key, &buffers, &plain_size, tag);
+        memset(key, 0, sizeof(key));
+        fclose(in);
+
+        if (status == 0) status = index_append(index, offset, plain_size, tag, name);
+        if (status != 0) {
+            fprintf(stderr, "Failed: %s\n", entry->source);
+            break;
+        }
+        offset += axon_encrypted_size(plain_size);
+        ordinal++;
+        result->succeeded++;
+        result->bytes += plain_size;
+    }
+    stream_buffers_free(&buffers);
+    return status;
+}
+
+// The index is one chain under the index key, followed by a MAC trailer
+// over the final bundle header and the index ciphertext. The member tags
+// are in the index, so this one tag vouches for the whole bundle.
+static int seal_index(const IndexBuffer* index, const char data_key[BLOCK_SIZE],
+                      const char header[BUNDLE_HEADER_SIZE], unsigned char* sealed, size_t* sealed_len){
+    AxonCipherContext ctx;
+    MacKey mac_key;
+    MacState mac;
+    char key[BLOCK_SIZE];
+    size_t body_len = 0;
+    size_t tail_len = 0;
+    size_t cipher_len = axon_encrypted_size(index->length);
+    int status = -1;
+
+    derive_key(data_key, INDEX_LABEL, 0, key);
+    axon_cipher_init_key(&ctx, AXON_ENCRYPT, key);
+    if (axon_cipher_update(&ctx, (const unsigned char*)index->text, index->length, sealed, cipher_len, &body_len) == 0
+        && axon_cipher_final(&ctx, sealed + body_len, cipher_len - body_len, &tail_len) == 0) {
+        mac_key_init(&mac_key, key);
+        mac_start(&mac, &mac_key);
+        mac_update(&mac, header, BUNDLE_HEADER_SIZE);
+        mac_update(&mac, sealed, cipher_len);
+        mac_finish(&mac, &mac_key, index->length, (char*)sealed + cipher_len);
+        mac_key_wipe(&mac_key);
+        *sealed_len = cipher_len + MAC_TRAILER_SIZE;
+        status = 0;
+    }
+    axon_cipher_wipe(&ctx);
+    memset(key, 0, sizeof(key));
+    return status;
+}
+
+int bundle_pack(const char* source, const char* bundle_path, const char* password, BatchResult* result){
+    memset(result, 0, sizeof(BatchResult));
+
+    // One random data key per bundle, wrapped in the header as in container files
+    StreamKeys keys;
+    ContainerHeader key_slot;
+    char data_key[BLOCK_SIZE];
+    if (stream_keys_init(&keys, password) != 0) return -1;
+    key_slot = keys.header;
+    int keyed = random_bytes(data_key, sizeof(data_key)) == 0
+                && container_wrap_key(&key_slot, keys.password_key, data_key) == 0;
+    stream_keys_wipe(&keys);
+    if (!keyed) return -1;
+
+    BatchPlan plan;
+    if (batch_plan_load(&plan, source, ".") != 0) {
+        memset(data_key, 0, sizeof(data_key));
+        return -1;
+    }
+
+    // Reserved for the members up front so the archive lands in few extents;
+    // it is only renamed over bundle_path once the header is final
+    unsigned long long expected = BUNDLE_HEADER_SIZE + MAC_TRAILER_SIZE;
+    for (size_t i = 0; i < plan.count; i++) expected += axon_encrypted_size((size_t)plan.entries[i].size);
+    AtomicFile output;
+    FILE* bundle = atomic_open(&output, bundle_path, expected) == 0 ? output.file : NULL;
+    IndexBuffer index = {NULL, 0, 0};
+    char header[BUNDLE_HEADER_SIZE];
+    unsigned char* sealed = NULL;
+    size_t sealed_len = 0;
+    int status = -1;
+
+    // The header is written twice: a placeholder now, the index location
+    // once every member is in
+    format_header(&key_slot, 0, 0, header);
+    if (bundle && write_header(bundle, header) == 0
+        && pack_members(&plan, bundle, data_key, &index, result) == 0) {
+        long long index_offset = tell_file(bundle);
+        size_t cipher_len = axon_encrypted_size(index.length);
+        sealed = malloc(cipher_len + MAC_TRAILER_SIZE);
+        if (!sealed) {
+            fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        } else if (index_offset >= 0) {
+            format_header(&key_slot, (unsigned long long)index_offset, cipher_len, header);
+            if (seal_index(&index, data_key, header, sealed, &sealed_len) == 0
+                && fwrite(sealed, 1, sealed_len, bundle) == sealed_len
+                && write_header(bundle, header) == 0
+                && seek_file(bundle, (unsigned long long)index_offset + sealed_len) == 0) {
+                status = 0;
+            }
+        }
+    }
+    if (bundle && status == 0 && atomic_commit(&output) != 0) status = -1;
+    if (bundle) atomic_abort(&output);
+    if (status != 0) fprintf(stderr, FILE_WRITE_FAILURE);
+
+    free(sealed);
+    if (index.text) memset(index.text, 0, index.capacity);
+    free(index.text);
+    batch_plan_free(&plan);
+    memset(data_key, 0, sizeof(data_key));
+    return status;
+}
+
+// Checks the key slot and unwraps the data key before anything else is read
+static int read_header(FILE* bundle, const char* password, char header[BUNDLE_HEADER_SIZE],
+                       unsigned long long* index_offset, unsigned long long* index_length,
+                       char data_key[BLOCK_SIZE]){
+    char prefix[BUNDLE_PREFIX_SIZE + 1];
+    unsigned int version = 0;
+    ContainerHeader key_slot;
+    StreamKeys keys;
+
+    if (fread(header, 1, BUNDLE_HEADER_SIZE, bundle) != BUNDLE_HEADER_SIZE
+        || memcmp(header, BUNDLE_MAGIC, strlen(BUNDLE_MAGIC)) != 0) {
+        fprintf(stderr, "Not an axon bundle\n");
+        return -1;
+    }
+    memcpy(prefix, header, BUNDLE_PREFIX_SIZE);
+    prefix[BUNDLE_PREFIX_SIZE] = '\0';
+    if (sscanf(prefix + strlen(BUNDLE_MAGIC), "%2x%16llx%16llx", &version, index_offset, index_length) != 3
+        || version != BUNDLE_VERSION) {
+        fprintf(stderr, "Unsupported bundle version\n");
+        return -1;
+    }
+    if (container_header_parse((const unsigned char*)header + BUNDLE_PREFIX_SIZE, CONTAINER_HEADER_SIZE,
+                               &key_slot) != 1 || key_slot.version < 2) {
+        fprintf(stderr, BUNDLE_CORRUPT);
+        return -1;
+    }
+    if (stream_keys_init(&keys, password) != 0) return -1;
+    int status = -1;
+    if (!container_key_matches(&key_slot, &keys.header)) {
+        fprintf(stderr, WRONG_KEY_FAILURE);
+    } else if (stream_file_key(&keys, &key_slot, data_key) == 0) {
+        status = 0;
+    }
+    stream_keys_wipe(&keys);
+    return status;
+}
+
+// Decrypts the index once its MAC checks out and splits it in place;
+// members point into *text
+static int load_index(FILE* bundle, const char* password, char data_key[BLOCK_SIZE], char** text,
+                      BundleMember** members, size_t* count){
+    char header[BUNDLE_HEADER_SIZE];
+    unsigned long long index_offset = 0;
+    unsigned long long index_length = 0;
+    *text = NULL;
+    *members = NULL;
+    *count = 0;
+
+    if (read_header(bundle, password, header, &index_offset, &index_length, data_key) != 0) return -1;
+    if (index_length > (unsigned long long)(SIZE_MAX / 2) - MAC_TRAILER_SIZE) {
+        fprintf(stderr, BUNDLE_CORRUPT);
+        return -1;
+    }
+
+    unsigned char* sealed = malloc((size_t)index_length + MAC_TRAILER_SIZE);
+    char* plain = malloc((size_t)index_length / 2 + 1);
+    unsigned long long plain_len = 0;
+    char found_tag[MAC_TAG_HEX_SIZE + 1];
+    char trailer[MAC_TRAILER_SIZE];
+    char key[BLOCK_SIZE];
+    MacKey mac_key;
+    MacState mac;
+    int status = -1;
+    derive_key(data_key, INDEX_LABEL, 0, key);
+    if (!sealed || !plain) {
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+    } else if (seek_file(bundle, index_offset) != 0
+               || fread(sealed, 1, (size_t)index_length + MAC_TRAILER_SIZE, bundle)
+                  != (size_t)index_length + MAC_TRAILER_SIZE
+               || mac_parse_trailer(sealed + index_length, &plain_len, found_tag) != 0
+               || axon_encrypted_size((size_t)plain_len) != index_length) {
+        fprintf(stderr, BUNDLE_CORRUPT);
+    } else {
+        mac_key_init(&mac_key, key);
+        mac_start(&mac, &mac_key);
+        mac_update(&mac, header, BUNDLE_HEADER_SIZE);
+        mac_update(&mac, sealed, (size_t)index_length);
+        mac_finish(&mac, &mac_key, plain_len, trailer);
+        mac_key_wipe(&mac_key);
+        if (!mac_tags_equal(found_tag, trailer + MAC_AUTHENTICATED_PREFIX)) {
+            fprintf(stderr, BUNDLE_CORRUPT);
+        } else {
+            // The chain drops trailing zero bytes with the padding; the
+            // authenticated length says how many there were
+            AxonCipherContext ctx;
+            size_t body_len = 0;
+            size_t tail_len = 0;
+            axon_cipher_init_key(&ctx, AXON_DECRYPT, key);
+            if (axon_cipher_update(&ctx, sealed, (size_t)index_length, (unsigned char*)plain,
+                                   (size_t)index_length / 2, &body_len) == 0
+                && axon_cipher_final(&ctx, (unsigned char*)plain + body_len, (size_t)index_length / 2 - body_len,
+                                     &tail_len) == 0) {
+                memset(plain + body_len + tail_len, 0, (size_t)plain_len - body_len - tail_len);
+                status = 0;
+            }
+            axon_cipher_wipe(&ctx);
+        }
+    }
+    memset(key, 0, sizeof(key));
+    free(sealed);
+    if (status != 0) {
+        free(plain);
+        return -1;
+    }
+    plain[plain_len] = '\0';
+    // The index is authenticated, so this only catches a writer bug
+    if ((plain_len > 0 && plain[plain_len - 1] != '\n') || strlen(plain) != plain_len) {
+        fprintf(stderr, BUNDLE_CORRUPT);
+        free(plain);
+        return -1;
+    }
+
+    size_t lines = 0;
+    for (size_t i = 0; i < plain_len; i++) {
+        if (plain[i] == '\n') lines++;
+    }
+    *members = calloc(lines ? lines : 1, sizeof(BundleMember));
+    if (!*members) {
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        free(plain);
+        return -1;
+    }
+
+    char* line = plain;
+    for (size_t i = 0; i < lines; i++) {
+        char* end = strchr(line, '\n');
+        char* name = NULL;
+        *end = '\0';
+        BundleMember* member = &(*members)[*count];
+        member->offset = strtoull(line, &name, 10);
+        if (*name == '\t') member->size = strtoull(name + 1, &name, 10);
+        // offset, size, tag and name
+        if (*name != '\t' || strlen(name + 1) <= MAC_TAG_HEX_SIZE || name[1 + MAC_TAG_HEX_SIZE] != '\t'
+            || member->offset + axon_encrypted_size(member->size) > index_offset) {
+            fprintf(stderr, BUNDLE_CORRUPT);
+            free(*members);
+            free(plain);
+            *members = NULL;
+            return -1;
+        }
+        member->tag = name + 1;
+        name[1 + MAC_TAG_HEX_SIZE] = '\0';
+        member->name = name + 2 + MAC_TAG_HEX_SIZE;
+        (*count)++;
+        line = end + 1;
+    }
+    *text = plain;
+    return 0;
+}
+
+// Refuses names that would land outside the destination directory
+static int safe_member_name(const char* name){
+    if (name[0] == '/' || name[0] == '\\') return 0;
+    for (const char* p = name; *p; ) {
+        size_t len = strcspn(p, "/\\");
+        if (len == 2 && p[0] == '.' && p[1] == '.') return 0;
+        p += len;
+        if (*p) p++;
+    }
+    return 1;
+}
+
+// The index knows each member's exact size, so zero bytes the padding
+// trim removed are restored and the padding itself is never written. The
+// tag is only known to match once the member is through, so a failure
+// leaves the caller to discard what was written.
+static int extract_member(FILE* bundle, const BundleMember* member, const char key[BLOCK_SIZE], FILE* out,
+                          StreamBuffers* buffers){
+    unsigned long long remaining = axon_encrypted_size(member->size);
+    unsigned long long written = 0;
+    AxonCipherContext ctx;
+    MacKey mac_key;
+    MacState mac;
+    char trailer[MAC_TRAILER_SIZE];
+    int status = seek_file(bundle, member->offset) == 0 ? 0 : -1;
+
+    axon_cipher_init_key(&ctx, AXON_DECRYPT, key);
+    mac_key_init(&mac_key, key);
+    mac_start(&mac, &mac_key);
+    while (status == 0 && remaining > 0) {
+        size_t want = remaining < STREAM_BUFFER_SIZE ? (size_t)remaining : STREAM_BUFFER_SIZE;
+        size_t out_len = 0;
+        if (fread(buffers->in, 1, want, bundle) != want
+            || axon_cipher_update(&ctx, buffers->in, want, buffers->out, buffers->out_capacity, &out_len) != 0) {
+            fprintf(stderr, BUNDLE_CORRUPT);
+            status = -1;
+            break;
+        }
+        mac_update(&mac, buffers->in, want);
+        remaining -= want;
+        if (out_len > member->size - written) out_len = (size_t)(member->size - written);
+        if (fwrite(buffers->out, 1, out_len, out) != out_len) status = -1;
+        written += out_len;
+    }
+
+    size_t tail_len = 0;
+    if (status == 0 && axon_cipher_final(&ctx, buffers->out, buffers->out_capacity, &tail_len) != 0) status = -1;
+    if (status == 0) {
+        mac_finish(&mac, &mac_key, member->size, trailer);
+        if (!mac_tags_equal(member->tag, trailer + MAC_AUTHENTICATED_PREFIX)) {
+            fprintf(stderr, BUNDLE_CORRUPT);
+            status = -1;
+        }
+    }
+    if (status == 0) {
+        if (tail_len > member->size - written) tail_len = (size_t)(member->size - written);
+        if (fwrite(buffers->out, 1, tail_len, out) != tail_len) status = -1;
+        written += tail_len;
+    }
+    while (status == 0 && written < member->size) {
+        if (fputc(0, out) == EOF) status = -1;
+        written++;
+    }
+    axon_cipher_wipe(&ctx);
+    mac_key_wipe(&mac_key);
+    return status;
+}
+
+static int extract_to_path(FILE* bundle, const BundleMember* member, const char key[BLOCK_SIZE],
+                           const char* dest_dir, StreamBuffers* buffers){
+    char* path = NULL;
+    if (strcmp(dest_dir, STDIO_PATH) != 0) {
+        size_t len = strlen(dest_dir) + 1 + strlen(member->name) + 1;
+        path = malloc(len);
+        if (!path) {
+            fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+            return -1;
+        }
+        snprintf(path, len, "%s/%s", dest_dir, member->name);
+    }
+
+    // Written beside the member's path and renamed in once complete
+    AtomicFile out;
+    int status = -1;
+    if ((!path || make_parent_dirs(path) == 0) && atomic_open(&out, path ? path : STDIO_PATH, member->size) == 0) {
+        status = extract_member(bundle, member, key, out.file, buffers);
+        if (status == 0 && atomic_commit(&out) != 0) status = -1;
+        atomic_abort(&out);
+    }
+    free(path);
+    return status;
+}
+
+int bundle_extract(const char* bundle_path, const char* dest_dir, const char* member,
+                   const char* password, BatchResult* result){
+    memset(result, 0, sizeof(BatchResult));
+    if (strcmp(dest_dir, STDIO_PATH) == 0 && !member) {
+        fprintf(stderr, "Extracting to stdout needs a single member\n");
+        return -1;
+    }
+
+    FILE* bundle = open_file(bundle_path, "rb");
+    if (!bundle) return -1;
+
+    char* text = NULL;
+    BundleMember* members = NULL;
+    size_t count = 0;
+    char data_key[BLOCK_SIZE];
+    StreamBuffers buffers;
+    if (load_index(bundle, password, data_key, &text, &members, &count) != 0) {
+        memset(data_key, 0, sizeof(data_key));
+        fclose(bundle);
+        return -1;
+    }
+    if (stream_buffers_init(&buffers) != 0) {
+        memset(data_key, 0, sizeof(data_key));
+        free(members);
+        free(text);
+        fclose(bundle);
+        return -1;
+    }
+
+    int found = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (member && strcmp(member, members[i].name) != 0) continue;
+        found = 1;
+        char key[BLOCK_SIZE];
+        derive_key(data_key, MEMBER_LABEL, i, key);
+        if (safe_member_name(members[i].name)
+            && extract_to_path(bundle, &members[i], key, dest_dir, &buffers) == 0) {
+            result->succeeded++;
+            result->bytes += members[i].size;
+        } else {
+            fprintf(stderr, "Failed: %s\n", members[i].name);
+            result->failed++;
+        }
+        memset(key, 0, sizeof(key));
+    }
+    if (member && !found) {
+        fprintf(stderr, "No member named %s in bundle\n", member);
+        result->failed++;
+    }
+
+    stream_buffers_free(&buffers);
+    memset(data_key, 0, sizeof(data_key));
+    free(members);
+    free(text);
+    fclose(bundle);
+    return 0;
+}
@@ -0,0 +1,252 @@
+#include "../../include/utils/checkpoint.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "../../include/common/config.h"
+#include "../../include/common/failures.h"
+#include "../../include/utils/conversion.h"
+#include "../../include/utils/fileio.h"
+#include "../../include/utils/stream.h"
+#include "../../include/utils/verify.h"
+
+typedef struct {
+    unsigned long long source_size;
+    long long source_mtime;
+    unsigned long long plain_offset;
+    unsigned long long output_offset;
+    unsigned char mac_y[GHASH_BLOCK_SIZE];  // over the whole GHASH blocks of the output prefix
+} Checkpoint;
+
+// Written through an atomic file, so a crash leaves either the previous
+// checkpoint or the new one
+static int save_checkpoint(const char* sidecar, const Checkpoint* checkpoint){
+    char y_hex[BLOCK_HEX_SIZE + 1];
+    bytes_to_hex_into(checkpoint->mac_y, GHASH_BLOCK_SIZE, y_hex);
+    y_hex[BLOCK_HEX_SIZE] = '\0';
+
+    AtomicFile file;
+    if (atomic_open(&file, sidecar, 0) == 0) {
+        fprintf(file.file, "%s\t%u\n%llu\t%lld\t%llu\t%llu\t%s\n", CHECKPOINT_MAGIC, CHECKPOINT_VERSION,
+                checkpoint->source_size, checkpoint->source_mtime, checkpoint->plain_offset,
+                checkpoint->output_offset, y_hex);
+        if (ferror(file.file)) {
+            atomic_abort(&file);
+        } else if (atomic_commit(&file) == 0) {
+            return 0;
+        }
+    }
+    fprintf(stderr, "Failed to write checkpoint: %s\n", sidecar);
+    return -1;
+}
+
+// 1 when a checkpoint was read, 0 when there is none, -1 when it is damaged
+static int load_checkpoint(const char* sidecar, Checkpoint* checkpoint){
+    FILE* file = fopen(sidecar, "r");
+    if (!file) return 0;
+
+    unsigned int version = 0;
+    char y_hex[BLOCK_HEX_SIZE + 1];
+    memset(checkpoint, 0, sizeof(Checkpoint));
+    int fields = fscanf(file, CHECKPOINT_MAGIC "\t%u\n%llu\t%lld\t%llu\t%llu\t%32s", &version,
+                        &checkpoint->source_size, &checkpoint->source_mtime, &checkpoint->plain_offset,
+                        &checkpoint->output_offset, y_hex);
+    fclose(file);
+    if (fields != 6 || version != CHECKPOINT_VERSION || strlen(y_hex) != BLOCK_HEX_SIZE
+        || hex_to_bytes_into(y_hex, BLOCK_HEX_SIZE, checkpoint->mac_y) != 0) {
+        fprintf(stderr, "Damaged checkpoint file: %s\n", sidecar);
+        return -1;
+    }
+    return 1;
+}
+
+// Rebuilds the encryption state from the output written so far. The chain
+// key is the hex of the last ciphertext block; the MAC state is re-hashed
+// from the output and must match the checkpoint, which proves the prefix
+// is the one the checkpoint described.
+static int resume_output(FILE* out, const char* destination, const StreamKeys* keys, const Checkpoint* checkpoint,
+                         StreamFile* file, size_t num_threads){
+    unsigned char header_text[CONTAINER_HEADER_SIZE];
+    char blanked[CONTAINER_HEADER_SIZE];
+    unsigned char last_block[BLOCK_HEX_SIZE];
+    unsigned char y[GHASH_BLOCK_SIZE];
+    char file_key[BLOCK_SIZE];
+
+    memset(file, 0, sizeof(StreamFile));
+    size_t got = fread(header_text, 1, CONTAINER_HEADER_SIZE, out);
+    if (container_header_parse(header_text, got, &file->header) != 1 || file->header.version < 2) {
+        fprintf(stderr, "%s does not start with a container header\n", destination);
+        return -1;
+    }
+    if (!container_key_matches(&file->header, &keys->header)) {
+        fprintf(stderr, WRONG_KEY_FAILURE);
+        return -1;
+    }
+    size_t header_size = container_header_size(&file->header);
+    if (checkpoint->plain_offset % BLOCK_SIZE != 0 || checkpoint->plain_offset == 0
+        || checkpoint->output_offset != header_size + checkpoint->plain_offset / BLOCK_SIZE * BLOCK_HEX_SIZE) {
+        fprintf(stderr, "Inconsistent checkpoint for %s\n", destination);
+        return -1;
+    }
+    if (stream_file_key(keys, &file->header, file_key) != 0) return -1;
+    axon_cipher_init_key(&file->ctx, AXON_ENCRYPT, file_key);
+    mac_key_init(&file->mac_key, file_key);
+    memset(file_key, 0, sizeof(file_key));
+
+    unsigned long long aligned = checkpoint->output_offset & ~(unsigned long long)(GHASH_BLOCK_SIZE - 1);
+    container_header_format_authenticated(&file->header, blanked);
+    if (verify_hash_range(destination, &file->mac_key.hash_key, blanked, header_size, aligned, num_threads, y) != 0
+        || memcmp(y, checkpoint->mac_y, GHASH_BLOCK_SIZE) != 0) {
+        fprintf(stderr, "%s does not match its checkpoint\n", destination);
+        return -1;
+    }
+    if (seek_file(out, checkpoint->output_offset - BLOCK_HEX_SIZE) != 0
+        || fread(last_block, 1, BLOCK_HEX_SIZE, out) != BLOCK_HEX_SIZE) {
+        fprintf(stderr, FILE_PROCESSING_FAILURE);
+        return -1;
+    }
+    size_t unhashed = (size_t)(checkpoint->output_offset - aligned);
+    memcpy(file->ctx.chain_key, last_block, BLOCK_HEX_SIZE);
+    ghash_resume(&file->mac.ghash, &file->mac_key.hash_key, y, aligned);
+    mac_update(&file->mac, last_block + BLOCK_HEX_SIZE - unhashed, unhashed);
+    file->authenticated = 1;
+
+    // Anything past the checkpoint was never committed
+    if (truncate_file(out, checkpoint->output_offset) != 0 || seek_file(out, checkpoint->output_offset) != 0) {
+        fprintf(stderr, FILE_WRITE_FAILURE);
+        return -1;
+    }
+    return 0;
+}
+
+static int take_checkpoint(FILE* out, const char* sidecar, StreamFile* file, Checkpoint* checkpoint){
+    if (sync_file(out) != 0) {
+        fprintf(stderr, FILE_WRITE_FAILURE);
+        return -1;
+    }
+    ghash_peek(&file->mac.ghash, checkpoint->mac_y);
+    return save_checkpoint(sidecar, checkpoint);
+}
+
+static int encrypt_from(FILE* in, FILE* out, const char* sidecar, StreamFile* file, Checkpoint* checkpoint,
+                        unsigned long long interval, StreamBuffers* buffers, CheckpointResult* result){
+    unsigned long long next = checkpoint->plain_offset + interval;
+
+    for (;;) {
+        size_t bytes_read = fread(buffers->in, 1, STREAM_BUFFER_SIZE, in);
+        if (bytes_read == 0) {
+            if (ferror(in)) {
+                fprintf(stderr, FILE_PROCESSING_FAILURE);
+                return -1;
+            }
+            break;
+        }
+        size_t out_len = 0;
+        if (axon_cipher_update(&file->ctx, buffers->in, bytes_read, buffers->out, buffers->out_capacity, &out_len) != 0) {
+            fprintf(stderr, ENCRYPTION_FAILURE);
+            return -1;
+        }
+        mac_update(&file->mac, buffers->out, out_len);
+        if (out_len > 0 && fwrite(buffers->out, 1, out_len, out) != out_len) {
+            fprintf(stderr, FILE_WRITE_FAILURE);
+            return -1;
+        }
+        checkpoint->plain_offset += bytes_read;
+        checkpoint->output_offset += out_len;
+        result->bytes += bytes_read;
+
+        // Only on a block boundary, where the whole chain state is in the output
+        if (checkpoint->plain_offset >= next && file->ctx.partial_len == 0) {
+            if (take_checkpoint(out, sidecar, file, checkpoint) != 0) return -1;
+            result->checkpoints++;
+            next = checkpoint->plain_offset + interval;
+        }
+    }
+
+    size_t tail_len = 0;
+    if (axon_cipher_final(&file->ctx, buffers->out, buffers->out_capacity, &tail_len) != 0
+        || (tail_len > 0 && fwrite(buffers->out, 1, tail_len, out) != tail_len)) {
+        fprintf(stderr, FILE_WRITE_FAILURE);
+        return -1;
+    }
+    mac_update(&file->mac, buffers->out, tail_len);
+    return stream_end_encrypt(out, file, checkpoint->plain_offset) == EXIT_SUCCESS ? 0 : -1;
+}
+
+int checkpoint_encrypt(const char* source, const char* destination, const char* password,
+                       const CheckpointOptions* options, CheckpointResult* result){
+    struct stat info;
+    Checkpoint checkpoint;
+    Checkpoint saved;
+    StreamKeys keys;
+    StreamBuffers buffers;
+    StreamFile file;
+    FILE* in = NULL;
+    FILE* out = NULL;
+    int status = -1;
+
+    memset(result, 0, sizeof(CheckpointResult));
+    memset(&checkpoint, 0, sizeof(checkpoint));
+    memset(&file, 0, sizeof(file));
+    if (stat(source, &info) != 0) {
+        fprintf(stderr, FILE_PROCESSING_FAILURE);
+        return -1;
+    }
+    checkpoint.source_size = (unsigned long long)info.st_size;
+    checkpoint.source_mtime = (long long)info.st_mtime;
+    unsigned long long interval = options->interval ? options->interval : CHECKPOINT_DEFAULT_INTERVAL;
+
+    char* sidecar = suffixed_path(destination, CHECKPOINT_SUFFIX);
+    if (!sidecar) return -1;
+    if (stream_keys_init(&keys, password) != 0) {
+        free(sidecar);
+        return -1;
+    }
+    if (stream_buffers_init(&buffers) != 0) {
+        stream_keys_wipe(&keys);
+        free(sidecar);
+        return -1;
+    }
+
+    int loaded = options->resume ? load_checkpoint(sidecar, &saved) : 0;
+    in = loaded >= 0 ? open_file(source, "rb") : NULL;
+    if (in && loaded == 1) {
+        if (saved.source_size != checkpoint.source_size || saved.source_mtime != checkpoint.source_mtime) {
+            fprintf(stderr, "%s changed since the checkpoint was taken; run again without --resume\n", source);
+        } else if ((out = open_file(destination, "r+b")) != NULL
+                   && resume_output(out, destination, &keys, &saved, &file, options->threads) == 0
+                   && seek_file(in, saved.plain_offset) == 0) {
+            checkpoint = saved;
+            result->resumed_at = saved.plain_offset;
+            status = 0;
+        }
+    } else if (in) {
+        if (options->resume) fprintf(stderr, "No checkpoint for %s, starting from the beginning\n", destination);
+        if ((out = open_file(destination, "wb")) != NULL
+            && stream_begin_encrypt(out, &keys, &file) == EXIT_SUCCESS) {
+            checkpoint.output_offset = container_header_size(&file.header);
+            status = 0;
+        }
+    }
+
+    if (status == 0) {
+        status = encrypt_from(in, out, sidecar, &file, &checkpoint, interval, &buffers, result);
+    }
+    if (in) fclose(in);
+    if (out && fclose(out) != 0) {
+        fprintf(stderr, FILE_WRITE_FAILURE);
+        status = -1;
+    }
+    // The checkpoint outlives a failed run; that is what --resume picks up.
+    // A fresh run that never reached one leaves nothing worth keeping.
+    if (status == 0) {
+        remove(sidecar);
+    } else if (out && loaded != 1 && result->checkpoints == 0) {
+        remove(destination);
+    }
+    stream_file_wipe(&file);
+    stream_keys_wipe(&keys);
+    stream_buffers_free(&buffers);
+    free(sidecar);
+    return status;
+}
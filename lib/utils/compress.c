@@ -0,0 +1,257 @@
+#include "../../include/utils/compress.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../include/common/failures.h"
+#include "../../include/utils/buffer_pool.h"
+
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
+#define LZ_MAX_OFFSET 65535
+// As in LZ4: the last match starts at least 12 bytes before the end and
+// the last 5 bytes are always literals
+#define LZ_MATCH_LIMIT 12
+#define LZ_LAST_LITERALS 5
+#define COMPRESS_FRAME_FAILURE "Damaged compressed segment\n"
+
+static uint32_t read32(const unsigned char* p){
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t hash32(uint32_t sequence){
+    return (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static void store_le32(unsigned char* p, uint32_t value){
+    for (int i = 0; i < 4; i++) {
+        p[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static uint32_t load_le32(const unsigned char* p){
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+size_t lz_compress_bound(size_t len){
+    return len + len / 255 + 16;
+}
+
+// Lengths of 15 and more continue in 255-valued bytes
+static int put_length(unsigned char* out, size_t capacity, size_t* op, size_t length){
+    while (length >= 255) {
+        if (*op >= capacity) return -1;
+        out[(*op)++] = 255;
+        length -= 255;
+    }
+    if (*op >= capacity) return -1;
+    out[(*op)++] = (unsigned char)length;
+    return 0;
+}
+
+static int put_sequence(unsigned char* out, size_t capacity, size_t* op, const unsigned char* literals,
+                        size_t literal_len, size_t offset, size_t match_len){
+    size_t match_code = match_len ? match_len - LZ_MIN_MATCH : 0;
+    if (*op >= capacity) return -1;
+    out[(*op)++] = (unsigned char)(((literal_len < 15 ? literal_len : 15) << 4)
+                                   | (match_code < 15 ? match_code : 15));
+    if (literal_len >= 15 && put_length(out, capacity, op, literal_len - 15) != 0) return -1;
+    if (literal_len > capacity - *op) return -1;
+    memcpy(out + *op, literals, literal_len);
+    *op += literal_len;
+    if (match_len == 0) return 0;  // the closing literal run
+
+    if (capacity - *op < 2) return -1;
+    out[(*op)++] = (unsigned char)(offset & 0xff);
+    out[(*op)++] = (unsigned char)(offset >> 8);
+    if (match_code >= 15 && put_length(out, capacity, op, match_code - 15) != 0) return -1;
+    return 0;
+}
+
+size_t lz_compress(const unsigned char* in, size_t len, unsigned char* out, size_t capacity){
+    uint32_t table[1 << LZ_HASH_BITS];
+    size_t anchor = 0;
+    size_t ip = 0;
+    size_t op = 0;
+
+    memset(table, 0, sizeof(table));
+    if (len > LZ_MATCH_LIMIT) {
+        size_t limit = len - LZ_MATCH_LIMIT;
+        size_t match_end = len - LZ_LAST_LITERALS;
+        while (ip <= limit) {
+            uint32_t sequence = read32(in + ip);
+            uint32_t slot = hash32(sequence);
+            size_t candidate = table[slot];
+            table[slot] = (uint32_t)ip;
+
+            if (candidate >= ip || ip - candidate > LZ_MAX_OFFSET || read32(in + candidate) != sequence) {
+                // Step faster through data that keeps failing to match
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+            while (ip > anchor && candidate > 0 && in[ip - 1] == in[candidate - 1]) {
+                ip--;
+                candidate--;
+            }
+            size_t match_len = LZ_MIN_MATCH;
+            while (ip + match_len < match_end && in[ip + match_len] == in[candidate + match_len]) {
+                match_len++;
+            }
+            if (put_sequence(out, capacity, &op, in + anchor, ip - anchor, ip - candidate, match_len) != 0) return 0;
+            ip += match_len;
+            anchor = ip;
+        }
+    }
+    if (put_sequence(out, capacity, &op, in + anchor, len - anchor, 0, 0) != 0) return 0;
+    return op;
+}
+
+// Every length and offset is checked, so a damaged segment fails cleanly
+int lz_decompress(const unsigned char* in, size_t len, unsigned char* out, size_t out_len){
+    size_t ip = 0;
+    size_t op = 0;
+
+    while (ip < len) {
+        unsigned char token = in[ip++];
+        size_t literal_len = token >> 4;
+        if (literal_len == 15) {
+            unsigned char byte;
+            do {
+                if (ip >= len) return -1;
+                byte = in[ip++];
+                literal_len += byte;
+            } while (byte == 255);
+        }
+        if (literal_len > len - ip || literal_len > out_len - op) return -1;
+        memcpy(out + op, in + ip, literal_len);
+        ip += literal_len;
+        op += literal_len;
+        if (ip == len) break;
+
+        if (len - ip < 2) return -1;
+        size_t offset = (size_t)in[ip] | ((size_t)in[ip + 1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) return -1;
+        size_t match_len = token & 15;
+        if (match_len == 15) {
+            unsigned char byte;
+            do {
+                if (ip >= len) return -1;
+                byte = in[ip++];
+                match_len += byte;
+            } while (byte == 255);
+        }
+        match_len += LZ_MIN_MATCH;
+        if (match_len > out_len - op) return -1;
+        // Byte by byte: the source may overlap what is being written
+        const unsigned char* match = out + op - offset;
+        for (size_t i = 0; i < match_len; i++) {
+            out[op + i] = match[i];
+        }
+        op += match_len;
+    }
+    return op == out_len ? 0 : -1;
+}
+
+size_t compress_frame_bound(void){
+    return COMPRESS_FRAME_HEADER + lz_compress_bound(COMPRESS_SEGMENT_SIZE);
+}
+
+size_t compress_frame(const unsigned char* segment, size_t len, unsigned char* frame){
+    size_t stored = lz_compress(segment, len, frame + COMPRESS_FRAME_HEADER, len > 0 ? len - 1 : 0);
+    if (stored == 0) {
+        // Incompressible (or too small to gain): keep the segment as it is
+        frame[0] = COMPRESS_FRAME_RAW;
+        memcpy(frame + COMPRESS_FRAME_HEADER, segment, len);
+        stored = len;
+    } else {
+        frame[0] = COMPRESS_FRAME_LZ;
+    }
+    store_le32(frame + 1, (uint32_t)len);
+    store_le32(frame + 5, (uint32_t)stored);
+    return COMPRESS_FRAME_HEADER + stored;
+}
+
+int inflater_init(Inflater* inflater, compress_write_fn write, void* arg){
+    memset(inflater, 0, sizeof(Inflater));
+    inflater->write = write;
+    inflater->arg = arg;
+    inflater->stored = buffer_pool_get(lz_compress_bound(COMPRESS_SEGMENT_SIZE));
+    inflater->raw = buffer_pool_get(COMPRESS_SEGMENT_SIZE);
+    if (!inflater->stored || !inflater->raw) {
+        buffer_pool_put(inflater->stored, lz_compress_bound(COMPRESS_SEGMENT_SIZE));
+        buffer_pool_put(inflater->raw, COMPRESS_SEGMENT_SIZE);
+        inflater->stored = NULL;
+        inflater->raw = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void inflater_free(Inflater* inflater){
+    buffer_pool_put(inflater->stored, lz_compress_bound(COMPRESS_SEGMENT_SIZE));
+    buffer_pool_put(inflater->raw, COMPRESS_SEGMENT_SIZE);
+    inflater->stored = NULL;
+    inflater->raw = NULL;
+}
+
+static int start_frame(Inflater* inflater){
+    inflater->type = inflater->header[0];
+    inflater->raw_len = load_le32(inflater->header + 1);
+    inflater->stored_len = load_le32(inflater->header + 5);
+    inflater->stored_have = 0;
+    int valid = inflater->raw_len <= COMPRESS_SEGMENT_SIZE
+        && ((inflater->type == COMPRESS_FRAME_RAW && inflater->stored_len == inflater->raw_len)
+            || (inflater->type == COMPRESS_FRAME_LZ && inflater->stored_len < inflater->raw_len));
+    if (!valid) {
+        fprintf(stderr, COMPRESS_FRAME_FAILURE);
+        return -1;
+    }
+    return 0;
+}
+
+static int end_frame(Inflater* inflater){
+    const unsigned char* plain = inflater->stored;
+    if (inflater->type == COMPRESS_FRAME_LZ) {
+        if (lz_decompress(inflater->stored, inflater->stored_len, inflater->raw, inflater->raw_len) != 0) {
+            fprintf(stderr, COMPRESS_FRAME_FAILURE);
+            return -1;
+        }
+        plain = inflater->raw;
+    }
+    inflater->header_len = 0;
+    return inflater->raw_len > 0 ? inflater->write(inflater->arg, plain, inflater->raw_len) : 0;
+}
+
+int inflater_feed(Inflater* inflater, const unsigned char* data, size_t len){
+    while (len > 0) {
+        if (inflater->header_len < COMPRESS_FRAME_HEADER) {
+            size_t take = COMPRESS_FRAME_HEADER - inflater->header_len;
+            if (take > len) take = len;
+            memcpy(inflater->header + inflater->header_len, data, take);
+            inflater->header_len += take;
+            data += take;
+            len -= take;
+            if (inflater->header_len < COMPRESS_FRAME_HEADER) break;
+            if (start_frame(inflater) != 0) return -1;
+        } else {
+            size_t take = inflater->stored_len - inflater->stored_have;
+            if (take > len) take = len;
+            memcpy(inflater->stored + inflater->stored_have, data, take);
+            inflater->stored_have += take;
+            data += take;
+            len -= take;
+        }
+        if (inflater->stored_have == inflater->stored_len && end_frame(inflater) != 0) return -1;
+    }
+    return 0;
+}
+
+int inflater_finish(Inflater* inflater){
+    if (inflater->header_len != 0) {
+        fprintf(stderr, "Compressed data ends inside a segment\n");
+        return -1;
+    }
+    return 0;
+}
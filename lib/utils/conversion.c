@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include "../../include/common/failures.h"
 #include "../../include/utils/conversion.h"
+#include "../../include/utils/trace.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -50,4 +51,36 @@ char* hex_to_bytes(const char* hex_string, size_t* out_len){
          bytes[i] = (unsigned char)value;
     }
     return bytes;
-}
\ No newline at end of file
+}
+
+static const char hex_digits[] = "0123456789abcdef";
+
+// Writes exactly len*2 characters, no terminator; the caller owns the buffer
+void bytes_to_hex_into(const unsigned char* data, size_t len, char* hex_out){
+    TRACE_START(started);
+    for (size_t i = 0; i < len; i++) {
+        hex_out[i*2] = hex_digits[data[i] >> 4];
+        hex_out[i*2 + 1] = hex_digits[data[i] & 0x0f];
+    }
+    TRACE_COUNT(TRACE_HEX, started);
+}
+
+static int hex_value(char c){
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+int hex_to_bytes_into(const char* hex, size_t hex_len, unsigned char* bytes_out){
+    if (hex_len % 2 != 0) return -1;
+    TRACE_START(started);
+    for (size_t i = 0; i < hex_len / 2; i++) {
+        int high = hex_value(hex[i*2]);
+        int low = hex_value(hex[i*2 + 1]);
+        if (high < 0 || low < 0) return -1;
+        bytes_out[i] = (unsigned char)((high << 4) | low);
+    }
+    TRACE_COUNT(TRACE_HEX, started);
+    return 0;
+}
@@ -1,3 +1,6 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // posix_fallocate alongside the stdio extensions
+#endif
 #include "../../include/utils/fileio.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -7,6 +10,19 @@
 #include "../include/crypto/chunked_file.h"
 #include <limits.h>
 #include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <direct.h>
+#include <process.h>
+#define make_dir(path) _mkdir(path)
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#define make_dir(path) mkdir(path, 0755)
+#endif
 
 
 FILE* open_file(const char* filename, const char* mode){
@@ -151,7 +167,7 @@ ChunkedFile file_chunker(const char* filename){
     size_t remaining_length = strlen(file_contents);
     
     while(remaining_length > 0){
-        if (i > buffer) {
+        if (i >= buffer) {
             if (buffer > INT_MAX / 2) {
                 fprintf(stderr, "Buffer size too large to double\n");
                 return result;
@@ -180,7 +196,14 @@ ChunkedFile file_chunker(const char* filename){
             return result;
         }
 
-        init_state_from_contents(current_position, state);
+        if (remaining_length < block_size) {
+            // Zero-pad the trailing partial block instead of reading past the terminator
+            char last_block[STATE_SIZE * STATE_SIZE] = {0};
+            memcpy(last_block, current_position, remaining_length);
+            init_state_from_contents(last_block, state);
+        } else {
+            init_state_from_contents(current_position, state);
+        }
         states[i++] = state;
         current_position += block_size;
         if(remaining_length > block_size){
@@ -188,30 +211,261 @@ ChunkedFile file_chunker(const char* filename){
         }else{
             remaining_length = 0;
         }
-        if (*current_position == '\0') break;
+        if (remaining_length == 0 || *current_position == '\0') break;
     }
+    free(file_contents);
     result.state = states;
     result.num_state = i;
     return result;
 }
 
 
+// One preallocated temporary file renamed into place, instead of
+// reopening the destination to append every 32-byte chunk
 int chunk_writer(const char* filename, char** chunks, size_t chunks_len){
     if (!filename || !chunks) {
         fprintf(stderr, INVALID_CHUNK_WRITER_ARGS);
         return EXIT_FAILURE;
     }
-    if (chunks[0]) {
-        size_t chunk_length = strlen(chunks[0]);
-        write_file(filename, chunks[0], chunk_length);
+    unsigned long long total = 0;
+    for (size_t i = 0; i < chunks_len; i++){
+        if (!chunks[i]) {
+            if (i == 0) continue;
+            fprintf(stderr, "Null chunk encountered at index %zu\n", i);
+            return EXIT_FAILURE;
+        }
+        total += strlen(chunks[i]);
     }
-   for (size_t i = 1; i < chunks_len; i++){
-    if (!chunks[i]) {
-        fprintf(stderr, "Null chunk encountered at index %zu\n", i);
-        return EXIT_FAILURE;
-     }
-     size_t chunk_length = strlen(chunks[i]);
-    append_file(filename, chunks[i], chunk_length);
-   }
-   return EXIT_SUCCESS;
-}
\ No newline at end of file
+    AtomicFile out;
+    if (atomic_open(&out, filename, total) != 0) return EXIT_FAILURE;
+    for (size_t i = 0; i < chunks_len; i++){
+        if (!chunks[i]) continue;
+        size_t chunk_length = strlen(chunks[i]);
+        if (fwrite(chunks[i], 1, chunk_length, out.file) != chunk_length) {
+            fprintf(stderr, FILE_WRITE_FAILURE);
+            atomic_abort(&out);
+            return EXIT_FAILURE;
+        }
+    }
+    return atomic_commit(&out) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// "-" selects stdin/stdout so axon can sit in the middle of a pipeline
+FILE* open_stream(const char* filename, const char* mode){
+    if (strcmp(filename, STDIO_PATH) == 0) {
+        FILE* std_stream = (mode[0] == 'r') ? stdin : stdout;
+#ifdef _WIN32
+        _setmode(_fileno(std_stream), _O_BINARY);
+#endif
+        return std_stream;
+    }
+    return open_file(filename, mode);
+}
+
+int close_stream(FILE* file){
+    if (file == stdin) return 0;
+    if (file == stdout) return fflush(file);
+    return fclose(file);
+}
+
+// mkdir -p for everything before the last path component. Safe to call from
+// several threads at once since an existing directory is not an error.
+int make_parent_dirs(const char* path){
+    char* copy = strdup(path);
+    if (!copy) {
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        return -1;
+    }
+    for (char* p = copy + 1; *p; p++) {
+        if (*p != '/' && *p != '\\') continue;
+        char separator = *p;
+        *p = '\0';
+        if (make_dir(copy) != 0 && errno != EEXIST) {
+            fprintf(stderr, "Error creating directory: %s\n", copy);
+            free(copy);
+            return -1;
+        }
+        *p = separator;
+    }
+    free(copy);
+    return 0;
+}
+
+int is_directory(const char* path){
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+// 64-bit offsets on every platform; long is 32 bits on Windows
+int seek_file(FILE* file, unsigned long long offset){
+#ifdef _WIN32
+    return _fseeki64(file, (__int64)offset, SEEK_SET);
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+
+long long tell_file(FILE* file){
+#ifdef _WIN32
+    return _ftelli64(file);
+#else
+    return (long long)ftello(file);
+#endif
+}
+
+// rename() over an existing file, which Windows refuses to do
+int replace_file(const char* from, const char* to){
+#ifdef _WIN32
+    remove(to);
+#endif
+    if (rename(from, to) != 0) {
+        fprintf(stderr, "Error replacing file: %s\n", to);
+        return -1;
+    }
+    return 0;
+}
+
+// Flushes stdio and then the OS cache, so the data survives a crash
+int sync_file(FILE* file){
+    if (fflush(file) != 0) return -1;
+#ifdef _WIN32
+    return _commit(_fileno(file));
+#else
+    return fsync(fileno(file));
+#endif
+}
+
+int sync_parent_dir(const char* path){
+#ifdef _WIN32
+    (void)path;
+    return 0;
+#else
+    const char* slash = strrchr(path, '/');
+    char* dir = slash ? strndup(path, slash == path ? 1 : (size_t)(slash - path)) : strdup(".");
+    if (!dir) {
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        return -1;
+    }
+    int fd = open(dir, O_RDONLY);
+    int status = fd >= 0 && fsync(fd) == 0 ? 0 : -1;
+    if (fd >= 0) close(fd);
+    if (status != 0) fprintf(stderr, "Failed to sync directory %s\n", dir);
+    free(dir);
+    return status;
+#endif
+}
+
+int truncate_file(FILE* file, unsigned long long size){
+    if (fflush(file) != 0) return -1;
+#ifdef _WIN32
+    return _chsize_s(_fileno(file), (__int64)size) == 0 ? 0 : -1;
+#else
+    return ftruncate(fileno(file), (off_t)size);
+#endif
+}
+
+// Reserves size bytes and sets the length to it. The blocks are claimed in
+// one call, so the file gets contiguous extents and a full disk fails here
+// rather than midway; filesystems without support just get the length.
+int allocate_file(FILE* file, unsigned long long size){
+#if defined(__linux__)
+    if (fflush(file) != 0) return -1;
+    int error = size > 0 ? posix_fallocate(fileno(file), 0, (off_t)size) : 0;
+    if (error != 0 && error != EOPNOTSUPP && error != EINVAL) {
+        errno = error;
+        return -1;
+    }
+#endif
+    return truncate_file(file, size);
+}
+
+// "<path>.<pid>.tmp": next to path so the rename never crosses a
+// filesystem, and per process so two runs cannot share one
+char* suffixed_path(const char* path, const char* suffix){
+    size_t len = strlen(path) + strlen(suffix) + 1;
+    char* joined = malloc(len);
+    if (!joined) {
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        return NULL;
+    }
+    snprintf(joined, len, "%s%s", path, suffix);
+    return joined;
+}
+
+char* temp_path_for(const char* path){
+    size_t len = strlen(path) + 32;
+    char* temp = malloc(len);
+    if (!temp) {
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        return NULL;
+    }
+#ifdef _WIN32
+    snprintf(temp, len, "%s.%d.tmp", path, _getpid());
+#else
+    snprintf(temp, len, "%s.%ld.tmp", path, (long)getpid());
+#endif
+    return temp;
+}
+
+int atomic_open(AtomicFile* out, const char* path, unsigned long long expected_size){
+    memset(out, 0, sizeof(AtomicFile));
+    if (strcmp(path, STDIO_PATH) == 0) {
+        out->file = open_stream(path, "wb");
+        return 0;
+    }
+    out->path = strdup(path);
+    out->temp = out->path ? temp_path_for(path) : NULL;
+    // "x" refuses to reuse a leftover temporary from a crashed run
+    out->file = out->temp ? open_file(out->temp, "wbx") : NULL;
+    if (out->file && expected_size > 0 && allocate_file(out->file, expected_size) != 0) {
+        fprintf(stderr, "Cannot reserve %llu bytes for %s: %s\n", expected_size, path, strerror(errno));
+        atomic_abort(out);
+        return -1;
+    }
+    out->reserved = expected_size;
+    if (!out->file) {
+        if (!out->path) fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        atomic_abort(out);
+        return -1;
+    }
+    return 0;
+}
+
+// Trims what is left of the reservation past the last write, then renames
+// over the destination. An unreserved file keeps its length, which a
+// writer may have set past its position (a trailing hole).
+int atomic_commit(AtomicFile* out){
+    if (!out->temp) {
+        int status = out->file ? close_stream(out->file) : -1;
+        memset(out, 0, sizeof(AtomicFile));
+        return status;
+    }
+    int status = 0;
+    if (fflush(out->file) != 0) status = -1;
+    if (status == 0 && out->reserved > 0) {
+        long long length = tell_file(out->file);
+        if (length < 0 || truncate_file(out->file, (unsigned long long)length) != 0) status = -1;
+    }
+    // The data is on disk before the name points at it, and the rename is
+    // on disk before success is reported
+    if (status == 0 && sync_file(out->file) != 0) status = -1;
+    if (fclose(out->file) != 0) status = -1;
+    out->file = NULL;
+    if (status == 0) status = replace_file(out->temp, out->path);
+    if (status == 0) status = sync_parent_dir(out->path);
+    if (status != 0) fprintf(stderr, FILE_WRITE_FAILURE);
+    atomic_abort(out);
+    return status;
+}
+
+// The destination is left exactly as it was
+void atomic_abort(AtomicFile* out){
+    if (out->file) {
+        if (out->temp) fclose(out->file);
+        else close_stream(out->file);
+    }
+    if (out->temp) remove(out->temp);
+    free(out->temp);
+    free(out->path);
+    memset(out, 0, sizeof(AtomicFile));
+}
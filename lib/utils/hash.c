@@ -0,0 +1,115 @@
+#include "../../include/utils/hash.h"
+#include <string.h>
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+static uint64_t rotl64(uint64_t value, int bits){
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Little-endian loads, independent of host byte order
+static uint64_t read64(const unsigned char* p){
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) value = (value << 8) | p[i];
+    return value;
+}
+
+static uint32_t read32(const unsigned char* p){
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t hash_round(uint64_t acc, uint64_t input){
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static uint64_t merge_round(uint64_t acc, uint64_t value){
+    acc ^= hash_round(0, value);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+static void consume_stripe(uint64_t* acc, const unsigned char* stripe){
+    for (int i = 0; i < 4; i++) {
+        acc[i] = hash_round(acc[i], read64(stripe + i * 8));
+    }
+}
+
+void hash64_init(Hash64State* state, uint64_t seed){
+    memset(state, 0, sizeof(Hash64State));
+    state->seed = seed;
+    state->acc[0] = seed + PRIME64_1 + PRIME64_2;
+    state->acc[1] = seed + PRIME64_2;
+    state->acc[2] = seed;
+    state->acc[3] = seed - PRIME64_1;
+}
+
+void hash64_update(Hash64State* state, const void* data, size_t len){
+    const unsigned char* p = data;
+    state->total_len += len;
+
+    if (state->buffered > 0) {
+        size_t take = sizeof(state->buffer) - state->buffered;
+        if (take > len) take = len;
+        memcpy(state->buffer + state->buffered, p, take);
+        state->buffered += take;
+        p += take;
+        len -= take;
+        if (state->buffered < sizeof(state->buffer)) return;
+        consume_stripe(state->acc, state->buffer);
+        state->buffered = 0;
+    }
+    while (len >= sizeof(state->buffer)) {
+        consume_stripe(state->acc, p);
+        p += sizeof(state->buffer);
+        len -= sizeof(state->buffer);
+    }
+    memcpy(state->buffer, p, len);
+    state->buffered = len;
+}
+
+uint64_t hash64_final(const Hash64State* state){
+    uint64_t h;
+    if (state->total_len >= sizeof(state->buffer)) {
+        h = rotl64(state->acc[0], 1) + rotl64(state->acc[1], 7) + rotl64(state->acc[2], 12) + rotl64(state->acc[3], 18);
+        for (int i = 0; i < 4; i++) h = merge_round(h, state->acc[i]);
+    } else {
+        h = state->seed + PRIME64_5;
+    }
+    h += state->total_len;
+
+    const unsigned char* p = state->buffer;
+    size_t len = state->buffered;
+    for (; len >= 8; p += 8, len -= 8) {
+        h ^= hash_round(0, read64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (len >= 4) {
+        h ^= (uint64_t)read32(p) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+        len -= 4;
+    }
+    for (; len > 0; p++, len--) {
+        h ^= (uint64_t)(*p) * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t hash64(const void* data, size_t len, uint64_t seed){
+    Hash64State state;
+    hash64_init(&state, seed);
+    hash64_update(&state, data, len);
+    return hash64_final(&state);
+}
@@ -0,0 +1,511 @@
+#include "../../include/utils/in_place.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "../../include/common/config.h"
+#include "../../include/common/failures.h"
+#include "../../include/crypto/cipher_context.h"
+#include "../../include/crypto/container.h"
+#include "../../include/crypto/mac.h"
+#include "../../include/utils/buffer_pool.h"
+#include "../../include/utils/fileio.h"
+#include "../../include/utils/stream.h"
+#include "../../include/utils/verify.h"
+
+#define JOURNAL_LINE_MAX (CONTAINER_HEADER_SIZE + 64)
+#define WINDOW_BLOCKS (IN_PLACE_WINDOW / BLOCK_SIZE)
+
+// Encryption: windows at or after next are written back; keys[w] starts
+// window w (keys[0] is the data key, rederived from the header, so never
+// stored) and saved holds window 0's plaintext once it is about to go.
+// Decryption: next plaintext bytes are written back; keys[0] starts the
+// chain at block next / BLOCK_SIZE, unless that is block 0.
+typedef struct {
+    char mode;
+    unsigned long long file_size;  // before the run
+    unsigned long long plain_length;
+    unsigned long long next;
+    char header[CONTAINER_HEADER_SIZE];
+    char trailer[MAC_TRAILER_SIZE];
+    char (*keys)[BLOCK_SIZE];
+    size_t count;
+    unsigned char* saved;
+    size_t saved_len;
+} Journal;
+
+static void journal_free(Journal* journal){
+    free(journal->keys);
+    if (journal->saved) {
+        // Plaintext of the file being encrypted
+        volatile unsigned char* bytes = journal->saved;
+        for (size_t i = 0; i < journal->saved_len; i++) bytes[i] = 0;
+        buffer_pool_put(journal->saved, IN_PLACE_WINDOW);
+    }
+    memset(journal, 0, sizeof(Journal));
+}
+
+// Written through an atomic file, so a crash leaves either the previous
+// journal or the new one, and the rename is on disk before any window the
+// journal covers is overwritten
+static int save_journal(const char* path, const Journal* journal){
+    ContainerHeader header;
+    container_header_parse((const unsigned char*)journal->header, CONTAINER_HEADER_SIZE, &header);
+    size_t header_size = container_header_size(&header);
+
+    AtomicFile file;
+    if (atomic_open(&file, path, 0) != 0) {
+        fprintf(stderr, "Failed to write journal: %s\n", path);
+        return -1;
+    }
+    fprintf(file.file, "%s\t%u\t%c\n%llu\t%llu\t%llu\t%zu\t%zu\n", IN_PLACE_MAGIC, IN_PLACE_VERSION, journal->mode,
+            journal->file_size, journal->plain_length, journal->next, journal->count, journal->saved_len);
+    fwrite(journal->header, 1, header_size, file.file);
+    if (journal->mode == 'e') fwrite(journal->trailer, 1, MAC_TRAILER_SIZE, file.file);
+    for (size_t i = 0; i < journal->count; i++) {
+        fprintf(file.file, "%.*s\n", BLOCK_SIZE, journal->keys[i]);
+    }
+    if (journal->saved_len > 0) fwrite(journal->saved, 1, journal->saved_len, file.file);
+    if (ferror(file.file)) {
+        atomic_abort(&file);
+    } else if (atomic_commit(&file) == 0) {
+        return 0;
+    }
+    fprintf(stderr, "Failed to write journal: %s\n", path);
+    return -1;
+}
+
+static int read_journal(FILE* file, Journal* journal){
+    char line[JOURNAL_LINE_MAX];
+    unsigned int version = 0;
+    ContainerHeader header;
+
+    if (!fgets(line, sizeof(line), file)
+        || sscanf(line, IN_PLACE_MAGIC "\t%u\t%c", &version, &journal->mode) != 2 || version != IN_PLACE_VERSION
+        || (journal->mode != 'e' && journal->mode != 'd')
+        || !fgets(line, sizeof(line), file)
+        || sscanf(line, "%llu\t%llu\t%llu\t%zu\t%zu", &journal->file_size, &journal->plain_length,
+                  &journal->next, &journal->count, &journal->saved_len) != 5
+        || journal->saved_len > IN_PLACE_WINDOW || journal->count > journal->plain_length / IN_PLACE_WINDOW + 1
+        || !fgets(line, sizeof(line), file)
+        || container_header_parse((const unsigned char*)line, strlen(line), &header) != 1
+        || strlen(line) != container_header_size(&header)) {
+        return -1;
+    }
+    memcpy(journal->header, line, strlen(line));
+    if (journal->mode == 'e' && fread(journal->trailer, 1, MAC_TRAILER_SIZE, file) != MAC_TRAILER_SIZE) return -1;
+
+    journal->keys = calloc(journal->count ? journal->count : 1, BLOCK_SIZE);
+    if (!journal->keys) return -1;
+    for (size_t i = 0; i < journal->count; i++) {
+        if (!fgets(line, sizeof(line), file) || strlen(line) != BLOCK_SIZE + 1) return -1;
+        memcpy(journal->keys[i], line, BLOCK_SIZE);
+    }
+    if (journal->saved_len > 0) {
+        journal->saved = buffer_pool_get(IN_PLACE_WINDOW);
+        if (!journal->saved) return -1;
+        if (fread(journal->saved, 1, journal->saved_len, file) != journal->saved_len) return -1;
+    }
+    return 0;
+}
+
+// 1 when a journal was read, 0 when there is none, -1 when it is damaged
+static int load_journal(const char* path, Journal* journal){
+    memset(journal, 0, sizeof(Journal));
+    FILE* file = fopen(path, "rb");
+    if (!file) return 0;
+    int status = read_journal(file, journal);
+    fclose(file);
+    if (status != 0) {
+        fprintf(stderr, "Damaged journal: %s\n", path);
+        journal_free(journal);
+        return -1;
+    }
+    return 1;
+}
+
+// A journal left by the other direction is not ours to continue
+static int open_journal(const char* path, char mode, Journal* journal, int* resumed){
+    int loaded = load_journal(path, journal);
+    *resumed = loaded == 1;
+    if (loaded == 1 && journal->mode != mode) {
+        fprintf(stderr, "%s belongs to an interrupted in-place %s; run that again to finish it\n", path,
+                journal->mode == 'e' ? "encryption" : "decryption");
+        journal_free(journal);
+        return -1;
+    }
+    return loaded < 0 ? -1 : 0;
+}
+
+static int read_at(FILE* file, unsigned long long offset, void* data, size_t len){
+    if (seek_file(file, offset) != 0 || fread(data, 1, len, file) != len) {
+        fprintf(stderr, FILE_PROCESSING_FAILURE);
+        return -1;
+    }
+    return 0;
+}
+
+static int write_at(FILE* file, unsigned long long offset, const void* data, size_t len){
+    if (len > 0 && (seek_file(file, offset) != 0 || fwrite(data, 1, len, file) != len)) {
+        fprintf(stderr, FILE_WRITE_FAILURE);
+        return -1;
+    }
+    return 0;
+}
+
+static unsigned long long file_size_of(FILE* file){
+    struct stat info;
+    return fstat(fileno(file), &info) == 0 ? (unsigned long long)info.st_size : 0;
+}
+
+// Both directions need the file's key, which the header's key slot holds
+static int journal_file_key(const Journal* journal, const StreamKeys* keys, size_t* header_size,
+                            char file_key[BLOCK_SIZE]){
+    ContainerHeader header;
+    if (container_header_parse((const unsigned char*)journal->header, CONTAINER_HEADER_SIZE, &header) != 1) return -1;
+    if (!container_key_matches(&header, &keys->header)) {
+        fprintf(stderr, WRONG_KEY_FAILURE);
+        return -1;
+    }
+    *header_size = container_header_size(&header);
+    return stream_file_key(keys, &header, file_key);
+}
+
+// The read-only pass: the chain key at the start of every window, the
+// header and the trailer, exactly as a streamed encryption would make them
+static int plan_encrypt(FILE* file, const StreamKeys* keys, Journal* journal, StreamBuffers* buffers){
+    StreamFile stream;
+    size_t windows = (size_t)((journal->plain_length + IN_PLACE_WINDOW - 1) / IN_PLACE_WINDOW);
+    journal->keys = calloc(windows ? windows : 1, BLOCK_SIZE);
+    if (!journal->keys) {
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        return -1;
+    }
+    journal->count = windows;
+    journal->next = windows;
+    if (stream_start_encrypt(keys, &stream) != EXIT_SUCCESS) return -1;
+    container_header_format(&stream.header, journal->header);
+
+    int status = seek_file(file, 0) == 0 ? 0 : -1;
+    unsigned long long remaining = journal->plain_length;
+    for (size_t w = 0; w < windows && status == 0; w++) {
+        // Window 0 starts from the data key, which must not reach the journal
+        if (w == 0) memset(journal->keys[w], '0', BLOCK_SIZE);
+        else memcpy(journal->keys[w], stream.ctx.chain_key, BLOCK_SIZE);
+        for (size_t done = 0; done < IN_PLACE_WINDOW && remaining > 0 && status == 0;) {
+            size_t want = remaining < STREAM_BUFFER_SIZE ? (size_t)remaining : STREAM_BUFFER_SIZE;
+            size_t out_len = 0;
+            if (fread(buffers->in, 1, want, file) != want) {
+                fprintf(stderr, FILE_PROCESSING_FAILURE);
+                status = -1;
+            } else if (axon_cipher_update(&stream.ctx, buffers->in, want, buffers->out, buffers->out_capacity,
+                                          &out_len) != 0) {
+                fprintf(stderr, ENCRYPTION_FAILURE);
+                status = -1;
+            } else {
+                mac_update(&stream.mac, buffers->out, out_len);
+                done += want;
+                remaining -= want;
+            }
+        }
+    }
+    size_t tail_len = 0;
+    if (status == 0 && axon_cipher_final(&stream.ctx, buffers->out, buffers->out_capacity, &tail_len) != 0) status = -1;
+    if (status == 0) {
+        mac_update(&stream.mac, buffers->out, tail_len);
+        mac_finish(&stream.mac, &stream.mac_key, journal->plain_length, journal->trailer);
+    }
+    stream_file_wipe(&stream);
+    return status;
+}
+
+// Window w's ciphertext lands at header + 2 * its offset. For w > 0 that
+// range only covers plaintext of later windows, which are already done,
+// so the window streams straight from the file; window 0 overwrites
+// itself and comes from the copy in the journal.
+static int encrypt_window(FILE* file, Journal* journal, size_t w, size_t header_size, const char file_key[BLOCK_SIZE],
+                          StreamBuffers* buffers){
+    unsigned long long first = (unsigned long long)w * IN_PLACE_WINDOW;
+    unsigned long long len = journal->plain_length - first < IN_PLACE_WINDOW ? journal->plain_length - first
+                                                                              : IN_PLACE_WINDOW;
+    unsigned long long out_offset = header_size + first / BLOCK_SIZE * BLOCK_HEX_SIZE;
+    AxonCipherContext ctx;
+    int status = 0;
+
+    axon_cipher_init_key(&ctx, AXON_ENCRYPT, w == 0 ? file_key : journal->keys[w]);
+    for (unsigned long long done = 0; done < len && status == 0;) {
+        size_t want = len - done < STREAM_BUFFER_SIZE ? (size_t)(len - done) : STREAM_BUFFER_SIZE;
+        const unsigned char* data = buffers->in;
+        size_t out_len = 0;
+        if (w == 0) {
+            data = journal->saved + done;
+        } else if (read_at(file, first + done, buffers->in, want) != 0) {
+            status = -1;
+            break;
+        }
+        if (axon_cipher_update(&ctx, data, want, buffers->out, buffers->out_capacity, &out_len) != 0
+            || write_at(file, out_offset, buffers->out, out_len) != 0) {
+            status = -1;
+        }
+        out_offset += out_len;
+        done += want;
+    }
+    size_t tail_len = 0;
+    if (status == 0 && first + len == journal->plain_length
+        && (axon_cipher_final(&ctx, buffers->out, buffers->out_capacity, &tail_len) != 0
+            || write_at(file, out_offset, buffers->out, tail_len) != 0)) {
+        status = -1;
+    }
+    axon_cipher_wipe(&ctx);
+    return status;
+}
+
+int in_place_encrypt(const char* path, const char* password, InPlaceResult* result){
+    StreamKeys keys;
+    StreamBuffers buffers;
+    Journal journal;
+    char file_key[BLOCK_SIZE];
+    size_t header_size = 0;
+    int status = -1;
+
+    memset(result, 0, sizeof(InPlaceResult));
+    char* journal_path = suffixed_path(path, IN_PLACE_SUFFIX);
+    if (!journal_path) return -1;
+    if (open_journal(journal_path, 'e', &journal, &result->resumed) != 0) {
+        free(journal_path);
+        return -1;
+    }
+    FILE* file = open_file(path, "r+b");
+    if (!file || stream_keys_init(&keys, password) != 0) {
+        if (file) fclose(file);
+        journal_free(&journal);
+        free(journal_path);
+        return -1;
+    }
+
+    if (stream_buffers_init(&buffers) == 0) {
+        status = 0;
+        unsigned char prefix[CONTAINER_HEADER_SIZE];
+        ContainerHeader existing;
+        size_t got = result->resumed ? 0 : fread(prefix, 1, sizeof(prefix), file);
+        // Running the command again after it finished must not encrypt twice
+        if (!result->resumed && container_header_parse(prefix, got, &existing) == 1) {
+            fprintf(stderr, "%s is already encrypted\n", path);
+            status = -1;
+        } else if (!result->resumed) {
+            journal.mode = 'e';
+            journal.file_size = file_size_of(file);
+            journal.plain_length = journal.file_size;
+            if (plan_encrypt(file, &keys, &journal, &buffers) != 0 || save_journal(journal_path, &journal) != 0) {
+                status = -1;
+            }
+        }
+        unsigned long long final_size = 0;
+        if (status == 0 && journal_file_key(&journal, &keys, &header_size, file_key) == 0) {
+            final_size = header_size + axon_encrypted_size((size_t)journal.plain_length) + MAC_TRAILER_SIZE;
+            unsigned long long current = file_size_of(file);
+            if (current != journal.file_size && current != final_size) {
+                fprintf(stderr, "%s is not in the state its journal describes\n", path);
+                status = -1;
+            }
+        } else {
+            status = -1;
+        }
+        // The growth is the only extra space the run needs; reserving it
+        // first means a full disk fails before any plaintext is touched
+        if (status == 0 && (allocate_file(file, final_size) != 0
+                            || write_at(file, final_size - MAC_TRAILER_SIZE, journal.trailer, MAC_TRAILER_SIZE) != 0)) {
+            fprintf(stderr, "Cannot grow %s to %llu bytes\n", path, final_size);
+            status = -1;
+        }
+        while (status == 0 && journal.next > 0) {
+            size_t w = (size_t)journal.next - 1;
+            if (w == 0 && !journal.saved) {
+                size_t len = (size_t)(journal.plain_length < IN_PLACE_WINDOW ? journal.plain_length : IN_PLACE_WINDOW);
+                journal.saved = buffer_pool_get(IN_PLACE_WINDOW);
+                journal.saved_len = len;
+                if (!journal.saved || read_at(file, 0, journal.saved, len) != 0
+                    || save_journal(journal_path, &journal) != 0) {
+                    status = -1;
+                    break;
+                }
+            }
+            if (encrypt_window(file, &journal, w, header_size, file_key, &buffers) != 0 || sync_file(file) != 0) {
+                status = -1;
+                break;
+            }
+            journal.next = w;
+            journal.count = w;
+            result->windows++;
+            // After window 0 only the header is left, and the saved copy
+            // still covers the bytes it replaces
+            if (w > 0 && save_journal(journal_path, &journal) != 0) status = -1;
+        }
+        if (status == 0 && (write_at(file, 0, journal.header, header_size) != 0 || sync_file(file) != 0)) status = -1;
+        stream_buffers_free(&buffers);
+        result->plain_length = journal.plain_length;
+        result->file_size = final_size;
+    }
+    if (fclose(file) != 0) status = -1;
+    if (status == 0) remove(journal_path);
+    memset(file_key, 0, sizeof(file_key));
+    stream_keys_wipe(&keys);
+    journal_free(&journal);
+    free(journal_path);
+    return status;
+}
+
+// Bounded by the distance between the write position (next) and the read
+// position (header + 2 * next), so the plaintext written by a window never
+// reaches ciphertext a resumed run would read again
+static unsigned long long window_blocks(const Journal* journal, size_t header_size, unsigned long long blocks){
+    unsigned long long done = journal->next / BLOCK_SIZE;
+    unsigned long long allowed = (header_size + journal->next) / BLOCK_SIZE;
+    if (allowed > WINDOW_BLOCKS) allowed = WINDOW_BLOCKS;
+    return blocks - done < allowed ? blocks - done : allowed;
+}
+
+// Feeds one block past the window when there is one, which releases the
+// block the cipher holds back; the last window ends with axon_cipher_final
+static int decrypt_window(FILE* file, Journal* journal, size_t header_size, unsigned long long blocks,
+                          const char file_key[BLOCK_SIZE], StreamBuffers* buffers){
+    unsigned long long first = journal->next / BLOCK_SIZE;
+    unsigned long long count = window_blocks(journal, header_size, blocks);
+    int is_final = first + count == blocks;
+    unsigned long long read_offset = header_size + first * BLOCK_HEX_SIZE;
+    unsigned long long remaining = (count + (is_final ? 0 : 1)) * BLOCK_HEX_SIZE;
+    unsigned long long write_offset = journal->next;
+    unsigned long long end = is_final ? journal->plain_length : (first + count) * BLOCK_SIZE;
+    AxonCipherContext ctx;
+    int status = 0;
+
+    axon_cipher_init_key(&ctx, AXON_DECRYPT, first == 0 ? file_key : journal->keys[0]);
+    while (remaining > 0 && status == 0) {
+        size_t want = remaining < STREAM_BUFFER_SIZE ? (size_t)remaining : STREAM_BUFFER_SIZE;
+        size_t out_len = 0;
+        if (read_at(file, read_offset, buffers->in, want) != 0
+            || axon_cipher_update(&ctx, buffers->in, want, buffers->out, buffers->out_capacity, &out_len) != 0) {
+            status = -1;
+            break;
+        }
+        if (out_len > end - write_offset) out_len = (size_t)(end - write_offset);
+        if (write_at(file, write_offset, buffers->out, out_len) != 0) status = -1;
+        read_offset += want;
+        write_offset += out_len;
+        remaining -= want;
+    }
+    size_t tail_len = 0;
+    if (status == 0 && is_final) {
+        if (axon_cipher_final(&ctx, buffers->out, buffers->out_capacity, &tail_len) != 0) {
+            status = -1;
+        } else {
+            if (tail_len > end - write_offset) tail_len = (size_t)(end - write_offset);
+            if (write_at(file, write_offset, buffers->out, tail_len) != 0) status = -1;
+            write_offset += tail_len;
+        }
+        // Zero bytes the padding trim dropped; what is there now is ciphertext
+        memset(buffers->out, 0, BLOCK_SIZE);
+        while (status == 0 && write_offset < end) {
+            size_t zeros = end - write_offset < BLOCK_SIZE ? (size_t)(end - write_offset) : BLOCK_SIZE;
+            if (write_at(file, write_offset, buffers->out, zeros) != 0) status = -1;
+            write_offset += zeros;
+        }
+    }
+    axon_cipher_wipe(&ctx);
+    if (status == 0) journal->next = end;
+    return status;
+}
+
+int in_place_decrypt(const char* path, const char* password, size_t num_threads, InPlaceResult* result){
+    StreamKeys keys;
+    StreamBuffers buffers;
+    Journal journal;
+    char file_key[BLOCK_SIZE];
+    size_t header_size = 0;
+    int status = -1;
+
+    memset(result, 0, sizeof(InPlaceResult));
+    char* journal_path = suffixed_path(path, IN_PLACE_SUFFIX);
+    if (!journal_path) return -1;
+    if (open_journal(journal_path, 'd', &journal, &result->resumed) != 0 || stream_keys_init(&keys, password) != 0) {
+        journal_free(&journal);
+        free(journal_path);
+        return -1;
+    }
+
+    if (!result->resumed) {
+        ContainerHeader found;
+        VerifyResult verified;
+        unsigned char prefix[CONTAINER_HEADER_SIZE];
+        FILE* probe = open_file(path, "rb");
+        size_t got = probe ? fread(prefix, 1, sizeof(prefix), probe) : 0;
+        int readable = probe != NULL;
+        if (probe) fclose(probe);
+        // Compressed plaintext can outgrow its ciphertext and overtake the
+        // read position; sparse output needs its holes
+        if (readable && container_header_parse(prefix, got, &found) == 1
+            && (found.flags & (CONTAINER_FLAG_SPARSE | CONTAINER_FLAG_COMPRESSED))) {
+            fprintf(stderr, "Sparse and compressed files cannot be decrypted in place\n");
+        } else if (readable && verify_container(path, &keys, num_threads, &found, &verified) == 0) {
+            journal.mode = 'd';
+            journal.file_size = verified.file_size;
+            journal.plain_length = verified.plain_length;
+            journal.keys = malloc(BLOCK_SIZE);
+            journal.count = 1;
+            container_header_format(&found, journal.header);
+            if (journal.keys) {
+                memset(journal.keys[0], '0', BLOCK_SIZE);
+                if (save_journal(journal_path, &journal) == 0) status = 0;
+            }
+        }
+    } else {
+        status = 0;
+    }
+
+    FILE* file = status == 0 ? open_file(path, "r+b") : NULL;
+    if (file && stream_buffers_init(&buffers) == 0) {
+        if (journal_file_key(&journal, &keys, &header_size, file_key) != 0) status = -1;
+        unsigned long long blocks = (journal.file_size - header_size - MAC_TRAILER_SIZE) / BLOCK_HEX_SIZE;
+        if (status == 0 && file_size_of(file) != journal.file_size) {
+            // Only the final truncation changes the size
+            if (journal.next != journal.plain_length) {
+                fprintf(stderr, "%s is not in the state its journal describes\n", path);
+                status = -1;
+            }
+        }
+        while (status == 0 && journal.next < journal.plain_length) {
+            if (decrypt_window(file, &journal, header_size, blocks, file_key, &buffers) != 0
+                || sync_file(file) != 0) {
+                status = -1;
+                break;
+            }
+            // Still ciphertext: the write position has not caught up with it
+            if (journal.next < journal.plain_length
+                && read_at(file, header_size + (journal.next / BLOCK_SIZE - 1) * BLOCK_HEX_SIZE,
+                           journal.keys[0], BLOCK_SIZE) != 0) {
+                status = -1;
+                break;
+            }
+            if (save_journal(journal_path, &journal) != 0) status = -1;
+            result->windows++;
+        }
+        // Done only once the journal says every byte is plaintext, so a
+        // crash here still finds the ciphertext tail it would need
+        if (status == 0 && truncate_file(file, journal.plain_length) != 0) {
+            fprintf(stderr, FILE_WRITE_FAILURE);
+            status = -1;
+        }
+        stream_buffers_free(&buffers);
+        result->plain_length = journal.plain_length;
+        result->file_size = journal.plain_length;
+    } else {
+        status = -1;
+    }
+    if (file && fclose(file) != 0) status = -1;
+    if (status == 0) remove(journal_path);
+    memset(file_key, 0, sizeof(file_key));
+    stream_keys_wipe(&keys);
+    journal_free(&journal);
+    free(journal_path);
+    return status;
+}
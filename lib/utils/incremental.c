@@ -0,0 +1,577 @@
+#include "../../include/utils/incremental.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "../../include/common/config.h"
+#include "../../include/common/failures.h"
+#include "../../include/crypto/cipher_context.h"
+#include "../../include/crypto/container.h"
+#include "../../include/crypto/mac.h"
+#include "../../include/crypto/random.h"
+#include "../../include/utils/buffer_pool.h"
+#include "../../include/utils/conversion.h"
+#include "../../include/utils/fileio.h"
+#include "../../include/utils/stream.h"
+#include "../../include/utils/trace.h"
+
+#define CHUNK_NAME_SIZE MAC_TAG_HEX_SIZE
+#define CHUNK_PREFIX_SIZE 2  // chunks live in one subdirectory per name prefix
+#define CHUNK_SUFFIX ".enc"
+#define STORE_CORRUPT "Incremental store is corrupt or was modified\n"
+
+typedef struct {
+    char name[CHUNK_NAME_SIZE + 1];
+    unsigned long long size;
+} ChunkRef;
+
+typedef struct {
+    ChunkRef* chunks;
+    size_t count;
+    size_t capacity;
+    unsigned long long total;
+} Manifest;
+
+// Everything derived from the store's data key, prepared once per run
+typedef struct {
+    ContainerHeader header;  // key slot the manifest is saved under
+    char chunk_key[BLOCK_SIZE];
+    char manifest_key[BLOCK_SIZE];
+    MacKey name_key;
+    unsigned char* plain;
+    unsigned char* cipher;
+} ChunkCodec;
+
+static uint64_t gear_table[256];
+static pthread_once_t gear_once = PTHREAD_ONCE_INIT;
+
+// splitmix64 of the byte value: fixed, so boundaries are stable across runs
+static void init_gear_table(void){
+    uint64_t x = 0;
+    for (size_t i = 0; i < 256; i++) {
+        uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        gear_table[i] = z ^ (z >> 31);
+    }
+}
+
+// Length of the next chunk at the start of data. The gear hash only sees
+// the last 64 bytes, so an insertion moves the boundaries near it and no
+// others.
+static size_t find_cut(const unsigned char* data, size_t len){
+    const uint64_t mask = ((uint64_t)1 << CDC_AVERAGE_BITS) - 1;
+    uint64_t h = 0;
+
+    if (len <= CDC_MIN_CHUNK) return len;
+    size_t end = len < CDC_MAX_CHUNK ? len : CDC_MAX_CHUNK;
+    for (size_t i = CDC_MIN_CHUNK - 64; i < end; i++) {
+        h = (h << 1) + gear_table[data[i]];
+        if (i >= CDC_MIN_CHUNK && (h & mask) == 0) return i + 1;
+    }
+    return end;
+}
+
+static char* store_path(const char* store_dir, const char* name, const char* suffix){
+    size_t len = strlen(store_dir) + 1 + strlen(name) + strlen(suffix) + 1;
+    char* path = malloc(len);
+    if (!path) {
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        return NULL;
+    }
+    snprintf(path, len, "%s/%s%s", store_dir, name, suffix);
+    return path;
+}
+
+// <store>/<first name characters>/<name>.enc, so no directory grows past
+// a few thousand entries however large the store
+static char* chunk_path(const char* store_dir, const char* name){
+    size_t len = strlen(store_dir) + CHUNK_PREFIX_SIZE + CHUNK_NAME_SIZE + strlen(CHUNK_SUFFIX) + 3;
+    char* path = malloc(len);
+    if (!path) {
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        return NULL;
+    }
+    snprintf(path, len, "%s/%.*s/%s%s", store_dir, CHUNK_PREFIX_SIZE, name, name, CHUNK_SUFFIX);
+    return path;
+}
+
+static int manifest_add(Manifest* manifest, const char* name, unsigned long long size){
+    if (manifest->count == manifest->capacity) {
+        size_t capacity = manifest->capacity ? manifest->capacity * 2 : DEFAULT_BUFFER;
+        ChunkRef* chunks = realloc(manifest->chunks, capacity * sizeof(ChunkRef));
+        if (!chunks) {
+            fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+            return -1;
+        }
+        manifest->chunks = chunks;
+        manifest->capacity = capacity;
+    }
+    ChunkRef* chunk = &manifest->chunks[manifest->count++];
+    memcpy(chunk->name, name, CHUNK_NAME_SIZE);
+    chunk->name[CHUNK_NAME_SIZE] = '\0';
+    chunk->size = size;
+    manifest->total += size;
+    return 0;
+}
+
+static void manifest_free(Manifest* manifest){
+    free(manifest->chunks);
+    memset(manifest, 0, sizeof(Manifest));
+}
+
+static int codec_init(ChunkCodec* codec){
+    memset(codec, 0, sizeof(ChunkCodec));
+    codec->plain = buffer_pool_get(CDC_MAX_CHUNK);
+    codec->cipher = buffer_pool_get(axon_encrypted_size(CDC_MAX_CHUNK));
+    if (!codec->plain || !codec->cipher) {
+        buffer_pool_put(codec->plain, CDC_MAX_CHUNK);
+        buffer_pool_put(codec->cipher, axon_encrypted_size(CDC_MAX_CHUNK));
+        codec->plain = NULL;
+        codec->cipher = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static void codec_free(ChunkCodec* codec){
+    buffer_pool_put(codec->plain, CDC_MAX_CHUNK);
+    buffer_pool_put(codec->cipher, axon_encrypted_size(CDC_MAX_CHUNK));
+    volatile unsigned char* bytes = (volatile unsigned char*)codec;
+    for (size_t i = 0; i < sizeof(ChunkCodec); i++) {
+        bytes[i] = 0;
+    }
+}
+
+// Each subkey is the data key's encryption of its own label, so none
+// reveals another
+static void codec_set_key(ChunkCodec* codec, const char data_key[BLOCK_SIZE]){
+    static const unsigned char chunk_label[BLOCK_SIZE] = "axon:cdc:chunk:1";
+    static const unsigned char manifest_label[BLOCK_SIZE] = "axon:cdc:manifst";
+    static const unsigned char name_label[BLOCK_SIZE] = "axon:cdc:name:k1";
+    char name_key[BLOCK_SIZE];
+
+    axon_encrypt_block(data_key, chunk_label, (unsigned char*)codec->chunk_key);
+    axon_encrypt_block(data_key, manifest_label, (unsigned char*)codec->manifest_key);
+    axon_encrypt_block(data_key, name_label, (unsigned char*)name_key);
+    mac_key_init(&codec->name_key, name_key);
+    memset(name_key, 0, sizeof(name_key));
+}
+
+// A new store: a random data key, wrapped under the password as in container files
+static int codec_create_key(ChunkCodec* codec, const char* password){
+    StreamKeys keys;
+    char data_key[BLOCK_SIZE];
+    if (stream_keys_init(&keys, password) != 0) return -1;
+    codec->header = keys.header;
+    int status = random_bytes(data_key, sizeof(data_key)) == 0
+                 && container_wrap_key(&codec->header, keys.password_key, data_key) == 0 ? 0 : -1;
+    if (status == 0) codec_set_key(codec, data_key);
+    stream_keys_wipe(&keys);
+    memset(data_key, 0, sizeof(data_key));
+    return status;
+}
+
+// Chunks are named by a MAC of their plaintext under a key only the
+// password opens, so equal names say nothing to anyone without it
+static void chunk_name(const ChunkCodec* codec, const unsigned char* data, size_t len, char* name){
+    MacState state;
+    char trailer[MAC_TRAILER_SIZE];
+    mac_start(&state, &codec->name_key);
+    mac_update(&state, data, len);
+    mac_finish(&state, &codec->name_key, len, trailer);
+    memcpy(name, trailer + MAC_AUTHENTICATED_PREFIX, CHUNK_NAME_SIZE);
+    name[CHUNK_NAME_SIZE] = '\0';
+}
+
+// One-shot encryption or decryption with a fresh chain from key
+static int codec_run(AxonCipherMode mode, const char key[BLOCK_SIZE], const unsigned char* in, size_t in_len,
+                     unsigned char* out, size_t out_capacity, size_t* out_len){
+    AxonCipherContext ctx;
+    size_t body_len = 0;
+    size_t tail_len = 0;
+    axon_cipher_init_key(&ctx, mode, key);
+    int status = axon_cipher_update(&ctx, in, in_len, out, out_capacity, &body_len);
+    if (status == 0) status = axon_cipher_final(&ctx, out + body_len, out_capacity - body_len, &tail_len);
+    axon_cipher_wipe(&ctx);
+    *out_len = body_len + tail_len;
+    return status;
+}
+
+// Every chunk chain starts from E_chunk_key(name), so chunks share no
+// starting key and one chunk's ciphertext says nothing about another's
+static int chunk_run(const ChunkCodec* codec, AxonCipherMode mode, const char* name, const unsigned char* in,
+                     size_t in_len, unsigned char* out, size_t out_capacity, size_t* out_len){
+    unsigned char name_bytes[BLOCK_SIZE];
+    char key[BLOCK_SIZE];
+    if (hex_to_bytes_into(name, CHUNK_NAME_SIZE, name_bytes) != 0) return -1;
+    axon_encrypt_block(codec->chunk_key, name_bytes, (unsigned char*)key);
+    int status = codec_run(mode, key, in, in_len, out, out_capacity, out_len);
+    memset(key, 0, sizeof(key));
+    return status;
+}
+
+// Through an atomic file, so an interrupted run never leaves a truncated
+// chunk or manifest under its final name, and what was written is on disk
+// before the call returns
+static int write_atomically(const char* path, const unsigned char* data, size_t len){
+    AtomicFile file;
+    if (atomic_open(&file, path, len) != 0) return -1;
+    if (fwrite(data, 1, len, file.file) != len) {
+        fprintf(stderr, FILE_WRITE_FAILURE);
+        atomic_abort(&file);
+        return -1;
+    }
+    return atomic_commit(&file);
+}
+
+static unsigned char* read_whole_file(const char* path, size_t* len){
+    FILE* file = open_file(path, "rb");
+    if (!file) return NULL;
+
+    size_t capacity = STREAM_BUFFER_SIZE;
+    unsigned char* data = malloc(capacity);
+    *len = 0;
+    while (data) {
+        *len += fread(data + *len, 1, capacity - *len, file);
+        if (*len < capacity) break;
+        capacity *= 2;
+        unsigned char* grown = realloc(data, capacity);
+        if (!grown) free(data);
+        data = grown;
+    }
+    if (!data) fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+    if (data && ferror(file)) {
+        fprintf(stderr, FILE_PROCESSING_FAILURE);
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    return data;
+}
+
+static void manifest_mac(const ChunkCodec* codec, const ContainerHeader* header, const unsigned char* payload,
+                         size_t payload_len, unsigned long long plain_len, char trailer[MAC_TRAILER_SIZE]){
+    char text[CONTAINER_HEADER_SIZE];
+    MacKey mac_key;
+    MacState mac;
+    container_header_format_authenticated(header, text);
+    mac_key_init(&mac_key, codec->manifest_key);
+    mac_start(&mac, &mac_key);
+    mac_update(&mac, text, CONTAINER_HEADER_SIZE);
+    mac_update(&mac, payload, payload_len);
+    mac_finish(&mac, &mac_key, plain_len, trailer);
+    mac_key_wipe(&mac_key);
+}
+
+// The manifest is laid out like a container file: header with the store's
+// wrapped data key, the chain under the manifest key, and a MAC trailer.
+// Opening it sets up the codec for the rest of the run.
+static int load_manifest(const char* store_dir, const char* password, ChunkCodec* codec, Manifest* manifest){
+    memset(manifest, 0, sizeof(Manifest));
+    char* path = store_path(store_dir, INCREMENTAL_MANIFEST, "");
+    size_t sealed_len = 0;
+    unsigned char* sealed = path ? read_whole_file(path, &sealed_len) : NULL;
+    free(path);
+    if (!sealed) return -1;
+
+    StreamKeys keys;
+    char data_key[BLOCK_SIZE];
+    char tag[MAC_TAG_HEX_SIZE + 1];
+    char trailer[MAC_TRAILER_SIZE];
+    unsigned long long text_len = 0;
+    size_t payload_len = sealed_len > CONTAINER_HEADER_SIZE + MAC_TRAILER_SIZE
+                         ? sealed_len - CONTAINER_HEADER_SIZE - MAC_TRAILER_SIZE : 0;
+    const unsigned char* payload = sealed + CONTAINER_HEADER_SIZE;
+    char* text = NULL;
+    int status = -1;
+    if (stream_keys_init(&keys, password) != 0) {
+        free(sealed);
+        return -1;
+    }
+    if (sealed_len < CONTAINER_HEADER_SIZE + MAC_TRAILER_SIZE
+        || container_header_parse(sealed, sealed_len, &codec->header) != 1 || codec->header.version < 2) {
+        fprintf(stderr, STORE_CORRUPT);
+    } else if (!container_key_matches(&codec->header, &keys.header)) {
+        fprintf(stderr, WRONG_KEY_FAILURE);
+    } else if (stream_file_key(&keys, &codec->header, data_key) == 0) {
+        codec_set_key(codec, data_key);
+        memset(data_key, 0, sizeof(data_key));
+        if (mac_parse_trailer(payload + payload_len, &text_len, tag) != 0
+            || axon_encrypted_size((size_t)text_len) != payload_len) {
+            fprintf(stderr, STORE_CORRUPT);
+        } else {
+            manifest_mac(codec, &codec->header, payload, payload_len, text_len, trailer);
+            // calloc'd, so trailing zero bytes the padding trim drops come back
+            size_t produced = 0;
+            if (!mac_tags_equal(tag, trailer + MAC_AUTHENTICATED_PREFIX)) {
+                fprintf(stderr, STORE_CORRUPT);
+            } else if (!(text = calloc(payload_len / 2 + 1, 1))) {
+                fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+            } else if (codec_run(AXON_DECRYPT, codec->manifest_key, payload, payload_len, (unsigned char*)text,
+                                 payload_len / 2, &produced) == 0) {
+                text[text_len] = '\0';
+                status = 0;
+            }
+        }
+    }
+    stream_keys_wipe(&keys);
+    free(sealed);
+    if (status != 0) {
+        free(text);
+        return -1;
+    }
+
+    unsigned long long total = 0;
+    unsigned int version = 0;
+    char* line = strchr(text, '\n');
+    if (strncmp(text, INCREMENTAL_MAGIC "\t", strlen(INCREMENTAL_MAGIC) + 1) != 0 || !line
+        || sscanf(text + strlen(INCREMENTAL_MAGIC) + 1, "%u\t%llu", &version, &total) != 2
+        || version != INCREMENTAL_VERSION) {
+        status = -1;
+    }
+    while (status == 0 && *++line) {
+        char* size_end = NULL;
+        char* tab = line + CHUNK_NAME_SIZE;
+        if (memchr(line, '\0', CHUNK_NAME_SIZE + 1) || *tab != '\t'
+            || manifest_add(manifest, line, strtoull(tab + 1, &size_end, 10)) != 0 || *size_end != '\n') {
+            status = -1;
+            break;
+        }
+        line = size_end;
+    }
+    if (status == 0 && manifest->total != total) status = -1;
+    if (status != 0) {
+        fprintf(stderr, STORE_CORRUPT);
+        manifest_free(manifest);
+    }
+    memset(text, 0, (size_t)text_len);
+    free(text);
+    return status;
+}
+
+static int save_manifest(const char* store_dir, const ChunkCodec* codec, const Manifest* manifest){
+    // Header plus one "name<TAB>size" line per chunk
+    size_t capacity = 64 + manifest->count * (CHUNK_NAME_SIZE + 23);
+    char* text = malloc(capacity);
+    unsigned char* sealed = malloc(CONTAINER_HEADER_SIZE + axon_encrypted_size(capacity) + MAC_TRAILER_SIZE);
+    char* path = store_path(store_dir, INCREMENTAL_MANIFEST, "");
+    int status = -1;
+
+    if (text && sealed && path) {
+        size_t len = (size_t)snprintf(text, capacity, "%s\t%u\t%llu\n", INCREMENTAL_MAGIC,
+                                      INCREMENTAL_VERSION, manifest->total);
+        for (size_t i = 0; i < manifest->count; i++) {
+            len += (size_t)snprintf(text + len, capacity - len, "%s\t%llu\n",
+                                    manifest->chunks[i].name, manifest->chunks[i].size);
+        }
+        size_t payload_len = 0;
+        unsigned char* payload = sealed + CONTAINER_HEADER_SIZE;
+        container_header_format(&codec->header, (char*)sealed);
+        if (codec_run(AXON_ENCRYPT, codec->manifest_key, (unsigned char*)text, len, payload,
+                      axon_encrypted_size(capacity), &payload_len) == 0) {
+            manifest_mac(codec, &codec->header, payload, payload_len, len, (char*)payload + payload_len);
+            status = write_atomically(path, sealed, CONTAINER_HEADER_SIZE + payload_len + MAC_TRAILER_SIZE);
+        }
+        memset(text, 0, len);
+    } else {
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+    }
+    free(text);
+    free(sealed);
+    free(path);
+    return status;
+}
+
+static int store_chunk(const char* store_dir, ChunkCodec* codec, const unsigned char* data, size_t len,
+                       Manifest* manifest, IncrementalResult* result){
+    char name[CHUNK_NAME_SIZE + 1];
+    chunk_name(codec, data, len, name);
+    if (manifest_add(manifest, name, len) != 0) return -1;
+    result->chunks++;
+
+    char* path = chunk_path(store_dir, name);
+    if (!path) return -1;
+
+    // Same keyed hash means same plaintext, and so the same ciphertext
+    int status = 0;
+    struct stat info;
+    if (stat(path, &info) == 0 && (unsigned long long)info.st_size == axon_encrypted_size(len)) {
+        result->reused++;
+    } else {
+        size_t cipher_len = 0;
+        status = chunk_run(codec, AXON_ENCRYPT, name, data, len, codec->cipher, axon_encrypted_size(CDC_MAX_CHUNK),
+                           &cipher_len);
+        if (status == 0) status = make_parent_dirs(path);
+        if (status == 0) status = write_atomically(path, codec->cipher, cipher_len);
+        if (status == 0) {
+            result->written++;
+            result->bytes_written += cipher_len;
+        }
+    }
+    free(path);
+    return status;
+}
+
+static int compare_chunk_names(const void* a, const void* b){
+    return strcmp(((const ChunkRef*)a)->name, ((const ChunkRef*)b)->name);
+}
+
+// Deletes chunks the previous manifest used and the new one does not
+static void remove_stale_chunks(const char* store_dir, const Manifest* old_manifest, Manifest* new_manifest,
+                                IncrementalResult* result){
+    ChunkRef* sorted = malloc((new_manifest->count ? new_manifest->count : 1) * sizeof(ChunkRef));
+    if (!sorted) return;
+    memcpy(sorted, new_manifest->chunks, new_manifest->count * sizeof(ChunkRef));
+    qsort(sorted, new_manifest->count, sizeof(ChunkRef), compare_chunk_names);
+
+    for (size_t i = 0; i < old_manifest->count; i++) {
+        const ChunkRef* old_chunk = &old_manifest->chunks[i];
+        if (bsearch(old_chunk, sorted, new_manifest->count, sizeof(ChunkRef), compare_chunk_names)) continue;
+        char* path = chunk_path(store_dir, old_chunk->name);
+        if (path && remove(path) == 0) {
+            result->removed++;
+            // Drops the prefix directory once its last chunk is gone
+            *strrchr(path, '/') = '\0';
+            remove(path);
+        }
+        free(path);
+    }
+    free(sorted);
+}
+
+int incremental_encrypt(const char* source, const char* store_dir, const char* password, IncrementalResult* result){
+    memset(result, 0, sizeof(IncrementalResult));
+    pthread_once(&gear_once, init_gear_table);
+
+    ChunkCodec codec;
+    Manifest old_manifest;
+    Manifest new_manifest;
+    memset(&old_manifest, 0, sizeof(Manifest));
+    memset(&new_manifest, 0, sizeof(Manifest));
+    if (codec_init(&codec) != 0) {
+        codec_free(&codec);
+        return -1;
+    }
+
+    char* manifest_path = store_path(store_dir, INCREMENTAL_MANIFEST, "");
+    if (!manifest_path || make_parent_dirs(manifest_path) != 0) {
+        free(manifest_path);
+        codec_free(&codec);
+        return -1;
+    }
+    // An existing store must open with this key; never overwrite one that does not
+    struct stat info;
+    int has_old = stat(manifest_path, &info) == 0;
+    // which also keeps its data key, so unchanged chunks keep their names
+    if (has_old ? load_manifest(store_dir, password, &codec, &old_manifest) != 0
+                : codec_create_key(&codec, password) != 0) {
+        free(manifest_path);
+        codec_free(&codec);
+        return -1;
+    }
+
+    FILE* in = open_stream(source, "rb");
+    int status = in ? 0 : -1;
+    size_t filled = 0;
+    while (status == 0) {
+        size_t bytes_read = fread(codec.plain + filled, 1, CDC_MAX_CHUNK - filled, in);
+        filled += bytes_read;
+        result->bytes_in += bytes_read;
+        if (filled == 0) break;
+        if (filled < CDC_MAX_CHUNK && ferror(in)) {
+            fprintf(stderr, FILE_PROCESSING_FAILURE);
+            status = -1;
+            break;
+        }
+        // Short of a full window only at end of input, where the rest may
+        // become several chunks
+        int at_end = filled < CDC_MAX_CHUNK;
+        do {
+            TRACE_START(chunk_started);
+            size_t cut = find_cut(codec.plain, filled);
+            TRACE_SPAN(TRACE_CHUNK, chunk_started);
+            status = store_chunk(store_dir, &codec, codec.plain, cut, &new_manifest, result);
+            memmove(codec.plain, codec.plain + cut, filled - cut);
+            filled -= cut;
+        } while (status == 0 && at_end && filled > 0);
+    }
+    if (in) close_stream(in);
+
+    // Chunk prefix directories made this run must be on disk before the
+    // manifest that points into them; the manifest commit syncs the store
+    // again, and only then is anything the old manifest used deleted
+    if (status == 0) status = sync_parent_dir(manifest_path);
+    if (status == 0) status = save_manifest(store_dir, &codec, &new_manifest);
+    if (status == 0) remove_stale_chunks(store_dir, &old_manifest, &new_manifest, result);
+
+    free(manifest_path);
+    manifest_free(&old_manifest);
+    manifest_free(&new_manifest);
+    codec_free(&codec);
+    return status;
+}
+
+int incremental_decrypt(const char* store_dir, const char* destination, const char* password, IncrementalResult* result){
+    memset(result, 0, sizeof(IncrementalResult));
+
+    ChunkCodec codec;
+    Manifest manifest;
+    if (codec_init(&codec) != 0 || load_manifest(store_dir, password, &codec, &manifest) != 0) {
+        codec_free(&codec);
+        return -1;
+    }
+
+    // The manifest knows the final size, so the output is reserved in one
+    // piece and only takes its name once every chunk checked out
+    unsigned long long total = 0;
+    for (size_t i = 0; i < manifest.count; i++) total += manifest.chunks[i].size;
+    AtomicFile output;
+    memset(&output, 0, sizeof(output));
+    FILE* out = NULL;
+    if ((strcmp(destination, STDIO_PATH) == 0 || make_parent_dirs(destination) == 0)
+        && atomic_open(&output, destination, total) == 0) {
+        out = output.file;
+    }
+    int status = out ? 0 : -1;
+    for (size_t i = 0; status == 0 && i < manifest.count; i++) {
+        const ChunkRef* chunk = &manifest.chunks[i];
+        char* path = chunk_path(store_dir, chunk->name);
+        size_t cipher_len = 0;
+        unsigned char* cipher = path ? read_whole_file(path, &cipher_len) : NULL;
+        free(path);
+
+        // Zeroing first restores trailing zero bytes the padding trim drops
+        size_t plain_len = 0;
+        char name[CHUNK_NAME_SIZE + 1];
+        memset(codec.plain, 0, CDC_MAX_CHUNK);
+        status = -1;
+        if (cipher && chunk->size <= CDC_MAX_CHUNK && cipher_len == axon_encrypted_size(chunk->size)
+            && chunk_run(&codec, AXON_DECRYPT, chunk->name, cipher, cipher_len, codec.plain, CDC_MAX_CHUNK,
+                         &plain_len) == 0) {
+            // The name is a MAC of the plaintext, so it doubles as the chunk's check
+            chunk_name(&codec, codec.plain, chunk->size, name);
+            status = strcmp(name, chunk->name) == 0 ? 0 : -1;
+        }
+        free(cipher);
+        if (status != 0) {
+            fprintf(stderr, "Chunk %s is missing or damaged\n", chunk->name);
+            break;
+        }
+        if (fwrite(codec.plain, 1, chunk->size, out) != chunk->size) {
+            fprintf(stderr, FILE_WRITE_FAILURE);
+            status = -1;
+        }
+        result->chunks++;
+        result->bytes_in += cipher_len;
+        result->bytes_written += chunk->size;
+    }
+    if (out && status == 0 && atomic_commit(&output) != 0) status = -1;
+    atomic_abort(&output);
+
+    manifest_free(&manifest);
+    codec_free(&codec);
+    return status;
+}
@@ -0,0 +1,184 @@
+#include "../../include/utils/memory_budget.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+static unsigned long long limit_bytes;
+static unsigned long long available;
+static unsigned long long in_use;
+static unsigned long long peak;
+static unsigned long long waiting;
+static pthread_mutex_t budget_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t budget_freed = PTHREAD_COND_INITIALIZER;
+
+// What each thread holds, so a thread that would wait only on memory it
+// holds itself fails instead of waiting forever. Threads beyond the table
+// are not tracked and simply wait.
+#define MEMORY_BUDGET_HOLDERS 256
+typedef struct {
+    pthread_t thread;
+    unsigned long long held;
+} Holder;
+static Holder holders[MEMORY_BUDGET_HOLDERS];
+static size_t num_holders;
+
+int memory_budget_parse(const char* text, unsigned long long* bytes){
+    char* end = NULL;
+    unsigned long long value = strtoull(text, &end, 10);
+    unsigned int shift = 0;
+    if (end == text) return -1;
+    switch (*end) {
+    case 'k': case 'K': shift = 10; end++; break;
+    case 'm': case 'M': shift = 20; end++; break;
+    case 'g': case 'G': shift = 30; end++; break;
+    default: break;
+    }
+    if (*end == 'i' && shift) end++;
+    if ((*end == 'b' || *end == 'B') && shift) end++;
+    if (*end != '\0' || value == 0 || value > (~0ULL >> shift)) return -1;
+    *bytes = value << shift;
+    return 0;
+}
+
+// What is resident now. ru_maxrss is only the fallback: it is a peak, and
+// Linux carries it over from the parent across exec.
+static unsigned long long resident_bytes(void){
+#ifdef __linux__
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm) {
+        unsigned long long size = 0;
+        unsigned long long resident = 0;
+        int parsed = fscanf(statm, "%llu %llu", &size, &resident);
+        fclose(statm);
+        if (parsed == 2) return resident * (unsigned long long)sysconf(_SC_PAGESIZE);
+    }
+#endif
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        return (unsigned long long)usage.ru_maxrss;  // bytes on macOS
+#else
+        return (unsigned long long)usage.ru_maxrss * 1024;
+#endif
+    }
+#endif
+    return 0;
+}
+
+int memory_budget_init(unsigned long long limit){
+    unsigned long long baseline = resident_bytes() + MEMORY_BUDGET_RESERVE;
+    if (limit != 0 && limit <= baseline) {
+        fprintf(stderr, "A memory limit of %llu bytes leaves nothing for buffers: %llu are in use before any work\n",
+                limit, baseline);
+        return -1;
+    }
+    pthread_mutex_lock(&budget_lock);
+    limit_bytes = limit;
+    available = limit ? limit - baseline : 0;
+    pthread_mutex_unlock(&budget_lock);
+    return 0;
+}
+
+unsigned long long memory_budget_limit(void){
+    return limit_bytes;
+}
+
+unsigned long long memory_budget_available(void){
+    return available;
+}
+
+unsigned long long memory_budget_peak(void){
+    pthread_mutex_lock(&budget_lock);
+    unsigned long long result = peak;
+    pthread_mutex_unlock(&budget_lock);
+    return result;
+}
+
+// Called with budget_lock held
+static Holder* find_holder(pthread_t thread, int create){
+    for (size_t i = 0; i < num_holders; i++) {
+        if (pthread_equal(holders[i].thread, thread)) return &holders[i];
+    }
+    if (!create || num_holders == MEMORY_BUDGET_HOLDERS) return NULL;
+    holders[num_holders].thread = thread;
+    holders[num_holders].held = 0;
+    return &holders[num_holders++];
+}
+
+size_t memory_budget_fit(size_t wanted, size_t unit_bytes){
+    if (available == 0 || unit_bytes == 0) return wanted;
+    unsigned long long fits = available / unit_bytes;
+    if (fits < 1) fits = 1;
+    return fits < wanted ? (size_t)fits : wanted;
+}
+
+int memory_budget_acquire(size_t bytes){
+    return memory_budget_acquire_reclaiming(bytes, NULL);
+}
+
+int memory_budget_acquire_reclaiming(size_t bytes, void (*reclaim)(void)){
+    pthread_mutex_lock(&budget_lock);
+    if (available != 0 && bytes > available) {
+        pthread_mutex_unlock(&budget_lock);
+        fprintf(stderr, "--max-memory is too small: a %zu byte buffer does not fit in the %llu bytes left for buffers\n",
+                bytes, available);
+        return -1;
+    }
+    // Every holder gives its memory back when its unit of work is done:
+    // a file, a segment, a batch task
+    waiting++;
+    while (available != 0 && in_use + bytes > available) {
+        if (reclaim) {
+            pthread_mutex_unlock(&budget_lock);
+            reclaim();
+            pthread_mutex_lock(&budget_lock);
+            if (in_use + bytes <= available) break;
+        }
+        // Nobody else holds anything that could be given back
+        Holder* self = find_holder(pthread_self(), 0);
+        if (self && self->held >= in_use) {
+            unsigned long long held = self->held;
+            waiting--;
+            pthread_mutex_unlock(&budget_lock);
+            fprintf(stderr, "--max-memory is too small: a %zu byte buffer does not fit next to the %llu bytes "
+                    "this worker already holds\n", bytes, held);
+            return -1;
+        }
+        pthread_cond_wait(&budget_freed, &budget_lock);
+    }
+    waiting--;
+    in_use += bytes;
+    Holder* self = find_holder(pthread_self(), 1);
+    if (self) self->held += bytes;
+    if (in_use > peak) peak = in_use;
+    pthread_mutex_unlock(&budget_lock);
+    return 0;
+}
+
+int memory_budget_waiting(void){
+    pthread_mutex_lock(&budget_lock);
+    int result = waiting != 0;
+    pthread_mutex_unlock(&budget_lock);
+    return result;
+}
+
+void memory_budget_release(size_t bytes){
+    memory_budget_release_for(pthread_self(), bytes);
+}
+
+void memory_budget_release_for(pthread_t holder, size_t bytes){
+    pthread_mutex_lock(&budget_lock);
+    in_use = bytes < in_use ? in_use - bytes : 0;
+    Holder* entry = find_holder(holder, 0);
+    if (entry) {
+        entry->held = bytes < entry->held ? entry->held - bytes : 0;
+        if (entry->held == 0) *entry = holders[--num_holders];
+    }
+    pthread_cond_broadcast(&budget_freed);
+    pthread_mutex_unlock(&budget_lock);
+}
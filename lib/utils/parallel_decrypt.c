@@ -0,0 +1,168 @@
+#include "../../include/utils/parallel_decrypt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../include/common/config.h"
+#include "../../include/common/failures.h"
+#include "../../include/crypto/cipher_context.h"
+#include "../../include/crypto/container.h"
+#include "../../include/crypto/mac.h"
+#include "../../include/utils/fileio.h"
+#include "../../include/utils/memory_budget.h"
+#include "../../include/utils/region_writer.h"
+#include "../../include/utils/stream.h"
+#include "../../include/utils/thread_pool.h"
+#include "../../include/utils/verify.h"
+
+#define REGION_BLOCKS (PARALLEL_REGION_SIZE / BLOCK_HEX_SIZE)
+
+typedef struct {
+    const char* source;
+    RegionWriter* writer;
+    char file_key[BLOCK_SIZE];
+    unsigned long long header_size;
+    unsigned long long blocks;
+    unsigned long long plain_length;
+} ParallelJob;
+
+typedef struct {
+    ParallelJob* job;
+    size_t region;
+} RegionTask;
+
+static int splittable(const char* source){
+#ifdef _WIN32
+    // No positional writes (see region_writer.c)
+    (void)source;
+    return 0;
+#endif
+    unsigned char text[CONTAINER_HEADER_SIZE];
+    ContainerHeader header;
+    FILE* file = fopen(source, "rb");
+    if (!file) return 0;
+    size_t got = fread(text, 1, sizeof(text), file);
+    fclose(file);
+    // The key is checked by verify_container, which reports a mismatch
+    return container_header_parse(text, got, &header) > 0 && (header.flags & CONTAINER_FLAG_MAC)
+        && !(header.flags & (CONTAINER_FLAG_SPARSE | CONTAINER_FLAG_COMPRESSED));
+}
+
+static int write_clipped(ParallelJob* job, unsigned long long* offset, unsigned long long end,
+                         const unsigned char* data, size_t len){
+    size_t keep = *offset >= end ? 0 : (end - *offset < len ? (size_t)(end - *offset) : len);
+    if (keep > 0 && region_writer_write(job->writer, *offset, data, keep) != 0) return -1;
+    *offset += len;
+    return 0;
+}
+
+// A region starts from the hex of the block before it. Its last block is
+// only released by the block that follows, so one extra block is read;
+// the final region ends with axon_cipher_final instead.
+static void decrypt_region(void* arg){
+    RegionTask* task = arg;
+    ParallelJob* job = task->job;
+    unsigned long long first = (unsigned long long)task->region * REGION_BLOCKS;
+    unsigned long long last = first + REGION_BLOCKS < job->blocks ? first + REGION_BLOCKS : job->blocks;
+    int is_final = last == job->blocks;
+    unsigned long long end = is_final ? job->plain_length : last * BLOCK_SIZE;
+    unsigned long long offset = first * BLOCK_SIZE;
+    unsigned long long remaining = (last - first + (is_final ? 0 : 1)) * BLOCK_HEX_SIZE;
+    char key[BLOCK_HEX_SIZE];
+    AxonCipherContext ctx;
+    StreamBuffers buffers;
+    int status = -1;
+
+    memset(&ctx, 0, sizeof(ctx));
+    FILE* in = open_file(job->source, "rb");
+    if (in && stream_buffers_init(&buffers) == 0) {
+        int ready = 0;
+        if (first == 0) {
+            memcpy(key, job->file_key, BLOCK_SIZE);
+            ready = seek_file(in, job->header_size) == 0;
+        } else {
+            ready = seek_file(in, job->header_size + (first - 1) * BLOCK_HEX_SIZE) == 0
+                 && fread(key, 1, BLOCK_HEX_SIZE, in) == BLOCK_HEX_SIZE;
+        }
+        if (ready) {
+            axon_cipher_init_key(&ctx, AXON_DECRYPT, key);
+            status = 0;
+        }
+        while (status == 0 && remaining > 0) {
+            size_t want = remaining < STREAM_BUFFER_SIZE ? (size_t)remaining : STREAM_BUFFER_SIZE;
+            size_t produced = 0;
+            if (fread(buffers.in, 1, want, in) != want
+                || axon_cipher_update(&ctx, buffers.in, want, buffers.out, buffers.out_capacity, &produced) != 0
+                || write_clipped(job, &offset, end, buffers.out, produced) != 0) {
+                status = -1;
+            }
+            remaining -= want;
+        }
+        if (status == 0 && is_final) {
+            size_t tail = 0;
+            if (axon_cipher_final(&ctx, buffers.out, buffers.out_capacity, &tail) != 0
+                || write_clipped(job, &offset, end, buffers.out, tail) != 0) {
+                status = -1;
+            }
+        }
+        stream_buffers_free(&buffers);
+    }
+    if (in) fclose(in);
+    axon_cipher_wipe(&ctx);
+    memset(key, 0, sizeof(key));
+    region_writer_complete(job->writer, task->region, status);
+}
+
+int parallel_decrypt_file(const char* source, const char* destination, const char* password,
+                          size_t num_threads, ParallelResult* result){
+    StreamKeys keys;
+    ContainerHeader found;
+    VerifyResult verified;
+    ParallelJob job;
+
+    memset(result, 0, sizeof(ParallelResult));
+    memset(&job, 0, sizeof(job));
+    if (!splittable(source)) return 1;
+    if (stream_keys_init(&keys, password) != 0) return -1;
+    if (num_threads == 0) num_threads = default_thread_count();
+    if (verify_container(source, &keys, num_threads, &found, &verified) != 0
+        || stream_file_key(&keys, &found, job.file_key) != 0) {
+        stream_keys_wipe(&keys);
+        return -1;
+    }
+    stream_keys_wipe(&keys);
+
+    job.source = source;
+    job.header_size = container_header_size(&found);
+    job.blocks = (verified.file_size - job.header_size - MAC_TRAILER_SIZE) / BLOCK_HEX_SIZE;
+    job.plain_length = verified.plain_length;
+    size_t num_regions = (size_t)((job.blocks + REGION_BLOCKS - 1) / REGION_BLOCKS);
+    if (num_threads > num_regions) num_threads = num_regions ? num_regions : 1;
+    num_threads = memory_budget_fit(num_threads, stream_buffers_charge());
+
+    RegionTask* tasks = calloc(num_regions ? num_regions : 1, sizeof(RegionTask));
+    job.writer = tasks ? region_writer_open(destination, job.plain_length, num_regions) : NULL;
+    ThreadPool* pool = job.writer ? thread_pool_create(num_threads) : NULL;
+    int status = -1;
+    if (pool) {
+        for (size_t r = 0; r < num_regions; r++) {
+            tasks[r].job = &job;
+            tasks[r].region = r;
+            if (thread_pool_submit(pool, decrypt_region, &tasks[r]) != 0) break;
+        }
+        thread_pool_wait(pool);
+        thread_pool_destroy(pool);
+        status = 0;
+    } else if (!tasks) {
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+    }
+    if (job.writer) {
+        // Regions never submitted stay pending, which close reports
+        if (region_writer_close(job.writer) != 0) status = -1;
+        if (status != 0) fprintf(stderr, FILE_PARSE_FAILURE);
+    }
+    memset(job.file_key, 0, sizeof(job.file_key));
+    free(tasks);
+    result->plain_length = job.plain_length;
+    result->regions = num_regions;
+    return status;
+}
@@ -0,0 +1,102 @@
+#include "../../include/utils/perf_counters.h"
+#include <string.h>
+
+static const char* const counter_names[PERF_COUNTER_COUNT] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"
+};
+
+const char* perf_counter_name(PerfCounter counter){
+    return counter < PERF_COUNTER_COUNT ? counter_names[counter] : "unknown";
+}
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static void describe(PerfCounter counter, struct perf_event_attr* attr){
+    memset(attr, 0, sizeof(*attr));
+    attr->size = sizeof(*attr);
+    attr->type = PERF_TYPE_HARDWARE;
+    switch (counter) {
+        case PERF_CYCLES: attr->config = PERF_COUNT_HW_CPU_CYCLES; break;
+        case PERF_INSTRUCTIONS: attr->config = PERF_COUNT_HW_INSTRUCTIONS; break;
+        case PERF_BRANCH_MISSES: attr->config = PERF_COUNT_HW_BRANCH_MISSES; break;
+        case PERF_L1D_MISSES:
+            attr->type = PERF_TYPE_HW_CACHE;
+            attr->config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        default:
+            attr->config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+    }
+    attr->disabled = 1;
+    // User space only: allowed at the default perf_event_paranoid of 2
+    attr->exclude_kernel = 1;
+    attr->exclude_hv = 1;
+    attr->read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+}
+
+int perf_counters_open(PerfCounters* counters){
+    counters->opened = 0;
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        struct perf_event_attr attr;
+        describe((PerfCounter)c, &attr);
+        counters->fds[c] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (counters->fds[c] >= 0) counters->opened++;
+    }
+    return counters->opened;
+}
+
+void perf_counters_start(PerfCounters* counters){
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        if (counters->fds[c] < 0) continue;
+        ioctl(counters->fds[c], PERF_EVENT_IOC_RESET, 0);
+        ioctl(counters->fds[c], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void perf_counters_stop(PerfCounters* counters, PerfSample* sample){
+    memset(sample, 0, sizeof(PerfSample));
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        if (counters->fds[c] < 0) continue;
+        ioctl(counters->fds[c], PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t values[3];  // value, time enabled, time running
+        if (read(counters->fds[c], values, sizeof(values)) != (ssize_t)sizeof(values) || values[2] == 0) continue;
+        sample->value[c] = values[2] < values[1]
+            ? (uint64_t)((double)values[0] * (double)values[1] / (double)values[2]) : values[0];
+        sample->valid[c] = 1;
+    }
+}
+
+void perf_counters_close(PerfCounters* counters){
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        if (counters->fds[c] >= 0) close(counters->fds[c]);
+        counters->fds[c] = -1;
+    }
+    counters->opened = 0;
+}
+#else
+int perf_counters_open(PerfCounters* counters){
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        counters->fds[c] = -1;
+    }
+    counters->opened = 0;
+    return 0;
+}
+
+void perf_counters_start(PerfCounters* counters){
+    (void)counters;
+}
+
+void perf_counters_stop(PerfCounters* counters, PerfSample* sample){
+    (void)counters;
+    memset(sample, 0, sizeof(PerfSample));
+}
+
+void perf_counters_close(PerfCounters* counters){
+    (void)counters;
+}
+#endif
@@ -0,0 +1,154 @@
+#include "../../include/utils/progress.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PROGRESS_SLOTS 64
+#define PROGRESS_CACHE_LINE 64
+
+// Threads beyond PROGRESS_SLOTS share slots, which stays correct with atomics
+typedef struct {
+    unsigned long long bytes;
+    char pad[PROGRESS_CACHE_LINE - sizeof(unsigned long long)];
+} ProgressSlot;
+
+int progress_enabled = 0;
+
+static ProgressSlot slots[PROGRESS_SLOTS];
+static unsigned int next_slot;
+static pthread_key_t slot_key;
+static pthread_once_t slot_key_once = PTHREAD_ONCE_INIT;
+
+static unsigned long long total;
+static double interval;
+static FILE* progress_out;
+static int on_terminal;
+static double started;
+static int stopping;
+static pthread_t sampler;
+static pthread_mutex_t sampler_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sampler_wake = PTHREAD_COND_INITIALIZER;
+
+static void create_slot_key(void){
+    pthread_key_create(&slot_key, NULL);
+}
+
+static double now_seconds(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+void progress_count(unsigned long long bytes){
+    // The slot is stored as index + 1 so that NULL means not yet assigned
+    uintptr_t slot = (uintptr_t)pthread_getspecific(slot_key);
+    if (slot == 0) {
+        slot = __atomic_fetch_add(&next_slot, 1, __ATOMIC_RELAXED) % PROGRESS_SLOTS + 1;
+        pthread_setspecific(slot_key, (void*)slot);
+    }
+    __atomic_fetch_add(&slots[slot - 1].bytes, bytes, __ATOMIC_RELAXED);
+}
+
+static unsigned long long sum_slots(void){
+    unsigned long long sum = 0;
+    for (size_t i = 0; i < PROGRESS_SLOTS; i++) {
+        sum += __atomic_load_n(&slots[i].bytes, __ATOMIC_RELAXED);
+    }
+    return sum;
+}
+
+static void format_duration(double seconds, char* text, size_t size){
+    unsigned long long s = seconds > 0 ? (unsigned long long)(seconds + 0.5) : 0;
+    snprintf(text, size, "%02llu:%02llu:%02llu", s / 3600, s / 60 % 60, s % 60);
+}
+
+static void report(unsigned long long done, double rate, double elapsed, int final){
+    unsigned long long known_total = __atomic_load_n(&total, __ATOMIC_RELAXED);
+    double average = elapsed > 0 ? (double)done / 1e6 / elapsed : 0.0;
+    double percent = known_total ? 100.0 * (double)done / (double)known_total : 0.0;
+    double eta = average > 0 && known_total > done ? (double)(known_total - done) / 1e6 / average : 0.0;
+    if (percent > 100.0) percent = 100.0;
+
+    if (!on_terminal) {
+        fprintf(progress_out, "{\"elapsed_seconds\":%.3f,\"bytes\":%llu,", elapsed, done);
+        if (known_total) {
+            fprintf(progress_out, "\"total_bytes\":%llu,\"percent\":%.2f,\"eta_seconds\":%.1f,", known_total, percent, eta);
+        }
+        fprintf(progress_out, "\"mb_per_second\":%.3f,\"avg_mb_per_second\":%.3f,\"done\":%s}\n",
+                rate, average, final ? "true" : "false");
+    } else {
+        char when[32];
+        format_duration(final ? elapsed : eta, when, sizeof(when));
+        // \r and a trailing clear keep it on one line
+        fprintf(progress_out, "\r");
+        if (known_total) fprintf(progress_out, "%5.1f%%  ", percent);
+        fprintf(progress_out, "%.1f MB  %.1f MB/s now  %.1f MB/s avg  %s %s\033[K",
+                (double)done / 1e6, rate, average, final ? "took" : "ETA", known_total || final ? when : "--:--:--");
+        if (final) fprintf(progress_out, "\n");
+    }
+    fflush(progress_out);
+}
+
+static void* sample(void* arg){
+    (void)arg;
+    unsigned long long last = 0;
+    double last_time = started;
+
+    pthread_mutex_lock(&sampler_lock);
+    while (!stopping) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        long long nanoseconds = deadline.tv_nsec + (long long)(interval * 1e9);
+        deadline.tv_sec += (time_t)(nanoseconds / 1000000000);
+        deadline.tv_nsec = (long)(nanoseconds % 1000000000);
+        pthread_cond_timedwait(&sampler_wake, &sampler_lock, &deadline);
+        if (stopping) break;
+
+        double now = now_seconds();
+        unsigned long long done = sum_slots();
+        double rate = now > last_time ? (double)(done - last) / 1e6 / (now - last_time) : 0.0;
+        report(done, rate, now - started, 0);
+        last = done;
+        last_time = now;
+    }
+    pthread_mutex_unlock(&sampler_lock);
+    return NULL;
+}
+
+int progress_start(unsigned long long total_bytes, double interval_seconds, FILE* out){
+    pthread_once(&slot_key_once, create_slot_key);
+    memset(slots, 0, sizeof(slots));
+    total = total_bytes;
+    interval = interval_seconds > 0 ? interval_seconds : 1.0;
+    progress_out = out;
+    on_terminal = isatty(fileno(out));
+    started = now_seconds();
+    stopping = 0;
+    progress_enabled = 1;
+    if (pthread_create(&sampler, NULL, sample, NULL) != 0) {
+        progress_enabled = 0;
+        fprintf(stderr, "Failed to start the progress reporter\n");
+        return -1;
+    }
+    return 0;
+}
+
+void progress_set_total(unsigned long long total_bytes){
+    __atomic_store_n(&total, total_bytes, __ATOMIC_RELAXED);
+}
+
+void progress_stop(void){
+    if (!progress_enabled) return;
+    pthread_mutex_lock(&sampler_lock);
+    stopping = 1;
+    pthread_cond_signal(&sampler_wake);
+    pthread_mutex_unlock(&sampler_lock);
+    pthread_join(sampler, NULL);
+    progress_enabled = 0;
+
+    double elapsed = now_seconds() - started;
+    unsigned long long done = sum_slots();
+    report(done, elapsed > 0 ? (double)done / 1e6 / elapsed : 0.0, elapsed, 1);
+}
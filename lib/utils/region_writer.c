@@ -0,0 +1,138 @@
+#include "../../include/utils/region_writer.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+#include "../../include/common/failures.h"
+#include "../../include/utils/fileio.h"
+#include "../../include/utils/trace.h"
+
+#define REGION_PENDING 0
+#define REGION_DONE 1
+#define REGION_FAILED 2
+
+struct RegionWriter {
+    FILE* file;
+    int fd;
+    char* path;
+    char* temp;
+    unsigned long long size;
+    size_t num_regions;
+    unsigned char* regions;
+    size_t completed;
+};
+
+#ifdef _WIN32
+// No pwrite; callers stream instead
+RegionWriter* region_writer_open(const char* path, unsigned long long size, size_t num_regions){
+    (void)path;
+    (void)size;
+    (void)num_regions;
+    fprintf(stderr, "Positional output is not supported on this platform\n");
+    return NULL;
+}
+
+int region_writer_write(RegionWriter* writer, unsigned long long offset, const void* data, size_t len){
+    (void)writer;
+    (void)offset;
+    (void)data;
+    (void)len;
+    return -1;
+}
+#else
+static void free_writer(RegionWriter* writer){
+    free(writer->regions);
+    free(writer->temp);
+    free(writer->path);
+    free(writer);
+}
+
+// The regions are written into a temporary file beside path, which only
+// takes the name once every region is in (see atomic_open)
+RegionWriter* region_writer_open(const char* path, unsigned long long size, size_t num_regions){
+    RegionWriter* writer = calloc(1, sizeof(RegionWriter));
+    if (writer) {
+        writer->regions = calloc(num_regions ? num_regions : 1, 1);
+        writer->path = strdup(path);
+        writer->temp = temp_path_for(path);
+    }
+    if (!writer || !writer->regions || !writer->path || !writer->temp) {
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        if (writer) free_writer(writer);
+        return NULL;
+    }
+    writer->file = open_file(writer->temp, "wbx");
+    if (!writer->file || allocate_file(writer->file, size) != 0) {
+        fprintf(stderr, "Failed to create %s: %s\n", path, strerror(errno));
+        if (writer->file) {
+            fclose(writer->file);
+            remove(writer->temp);
+        }
+        free_writer(writer);
+        return NULL;
+    }
+    writer->fd = fileno(writer->file);
+    writer->size = size;
+    writer->num_regions = num_regions;
+    return writer;
+}
+
+int region_writer_write(RegionWriter* writer, unsigned long long offset, const void* data, size_t len){
+    const unsigned char* cursor = data;
+    if (offset > writer->size || len > writer->size - offset) {
+        fprintf(stderr, "Write past the end of the preallocated output\n");
+        return -1;
+    }
+    TRACE_START(started);
+    while (len > 0) {
+        ssize_t written = pwrite(writer->fd, cursor, len, (off_t)offset);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) {
+            fprintf(stderr, FILE_WRITE_FAILURE);
+            return -1;
+        }
+        cursor += written;
+        offset += (unsigned long long)written;
+        len -= (size_t)written;
+    }
+    TRACE_SPAN(TRACE_WRITE, started);
+    return 0;
+}
+
+#endif
+
+void region_writer_complete(RegionWriter* writer, size_t region, int status){
+    if (region >= writer->num_regions) return;
+    // Each region is reported by the one worker that wrote it
+    __atomic_store_n(&writer->regions[region], status == 0 ? REGION_DONE : REGION_FAILED, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&writer->completed, 1, __ATOMIC_RELAXED);
+}
+
+size_t region_writer_completed(RegionWriter* writer){
+    return __atomic_load_n(&writer->completed, __ATOMIC_RELAXED);
+}
+
+int region_writer_close(RegionWriter* writer){
+    int status = 0;
+    for (size_t i = 0; i < writer->num_regions; i++) {
+        if (__atomic_load_n(&writer->regions[i], __ATOMIC_ACQUIRE) != REGION_DONE) status = -1;
+    }
+#ifndef _WIN32
+    if (status == 0 && sync_file(writer->file) != 0) {
+        fprintf(stderr, FILE_WRITE_FAILURE);
+        status = -1;
+    }
+    if (fclose(writer->file) != 0) {
+        fprintf(stderr, FILE_WRITE_FAILURE);
+        status = -1;
+    }
+    if (status == 0) status = replace_file(writer->temp, writer->path);
+    if (status == 0) status = sync_parent_dir(writer->path);
+    if (status != 0) remove(writer->temp);
+    free_writer(writer);
+#endif
+    return status;
+}
@@ -0,0 +1,295 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // SEEK_DATA and SEEK_HOLE
+#endif
+#include "../../include/utils/sparse.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+#include "../../include/common/config.h"
+#include "../../include/common/failures.h"
+#include "../../include/utils/fileio.h"
+#include "../../include/utils/stream.h"
+
+#define SPARSE_TABLE_FAILURE "Damaged sparse extent table\n"
+
+static int add_extent(SparseMap* map, unsigned long long offset, unsigned long long length){
+    if (map->count == map->capacity) {
+        size_t capacity = map->capacity ? map->capacity * 2 : DEFAULT_BUFFER;
+        SparseExtent* extents = realloc(map->extents, capacity * sizeof(SparseExtent));
+        if (!extents) {
+            fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+            return -1;
+        }
+        map->extents = extents;
+        map->capacity = capacity;
+    }
+    map->extents[map->count].offset = offset;
+    map->extents[map->count].length = length;
+    map->count++;
+    map->data_bytes += length;
+    return 0;
+}
+
+int sparse_map_file(FILE* file, SparseMap* map){
+    struct stat info;
+    memset(map, 0, sizeof(SparseMap));
+    if (fstat(fileno(file), &info) != 0) {
+        fprintf(stderr, FILE_PROCESSING_FAILURE);
+        return -1;
+    }
+    map->apparent_size = (unsigned long long)info.st_size;
+    if (map->apparent_size == 0) return 0;
+
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+    int fd = fileno(file);
+    off_t size = (off_t)info.st_size;
+    off_t position = 0;
+    int supported = 1;
+    while (position < size) {
+        off_t data = lseek(fd, position, SEEK_DATA);
+        if (data < 0) {
+            // ENXIO means only a hole remains; anything else means the
+            // file system cannot tell, so everything counts as data
+            if (errno != ENXIO) supported = 0;
+            break;
+        }
+        off_t hole = lseek(fd, data, SEEK_HOLE);
+        if (hole < 0 || hole > size) hole = size;
+        if (add_extent(map, (unsigned long long)data, (unsigned long long)(hole - data)) != 0) return -1;
+        position = hole;
+    }
+    lseek(fd, 0, SEEK_SET);
+    if (supported) return 0;
+    map->count = 0;
+    map->data_bytes = 0;
+#endif
+    return add_extent(map, 0, map->apparent_size);
+}
+
+void sparse_map_free(SparseMap* map){
+    free(map->extents);
+    memset(map, 0, sizeof(SparseMap));
+}
+
+int sparse_encrypt(const char* source, const char* destination, const char* password, SparseResult* result){
+    StreamKeys keys;
+    StreamBuffers buffers;
+    StreamFile file;
+    SparseMap map;
+    char text[SPARSE_HEADER_SIZE + 1];
+    int status = -1;
+
+    memset(result, 0, sizeof(SparseResult));
+    memset(&file, 0, sizeof(file));
+    FILE* in = open_file(source, "rb");
+    if (!in) return -1;
+    if (sparse_map_file(in, &map) != 0) {
+        fclose(in);
+        return -1;
+    }
+    if (stream_keys_init(&keys, password) != 0) {
+        sparse_map_free(&map);
+        fclose(in);
+        return -1;
+    }
+    keys.header.flags |= CONTAINER_FLAG_SPARSE;
+    unsigned long long plain_length = SPARSE_HEADER_SIZE + (unsigned long long)map.count * SPARSE_RECORD_SIZE;
+    unsigned long long expected = CONTAINER_HEADER_SIZE + MAC_TRAILER_SIZE
+                                + axon_encrypted_size((size_t)(plain_length + map.data_bytes));
+    AtomicFile output;
+    memset(&output, 0, sizeof(output));
+    FILE* out = stream_buffers_init(&buffers) == 0 && atomic_open(&output, destination, expected) == 0 ? output.file : NULL;
+
+    if (out && stream_begin_encrypt(out, &keys, &file) == EXIT_SUCCESS) {
+        snprintf(text, sizeof(text), "%s%016llx%016llx\n", SPARSE_MAGIC, map.apparent_size, (unsigned long long)map.count);
+        status = stream_feed(out, &file, text, SPARSE_HEADER_SIZE, &buffers) == EXIT_SUCCESS ? 0 : -1;
+        for (size_t i = 0; i < map.count && status == 0; i++) {
+            snprintf(text, sizeof(text), "%016llx%016llx\n", map.extents[i].offset, map.extents[i].length);
+            if (stream_feed(out, &file, text, SPARSE_RECORD_SIZE, &buffers) != EXIT_SUCCESS) status = -1;
+        }
+
+        // Holes are never read, which is where the time goes on a mostly
+        // empty image
+        for (size_t i = 0; i < map.count && status == 0; i++) {
+            unsigned long long remaining = map.extents[i].length;
+            if (seek_file(in, map.extents[i].offset) != 0) status = -1;
+            while (remaining > 0 && status == 0) {
+                size_t want = remaining < STREAM_BUFFER_SIZE ? (size_t)remaining : STREAM_BUFFER_SIZE;
+                size_t got = fread(buffers.in, 1, want, in);
+                if (got == 0) {
+                    fprintf(stderr, "%s changed while it was being read\n", source);
+                    status = -1;
+                } else if (stream_feed(out, &file, buffers.in, got, &buffers) != EXIT_SUCCESS) {
+                    status = -1;
+                } else {
+                    remaining -= got;
+                }
+            }
+            plain_length += map.extents[i].length;
+        }
+        if (status == 0 && stream_finish_encrypt(out, &file, &buffers, plain_length) != EXIT_SUCCESS) status = -1;
+    }
+    if (status == 0) {
+        result->apparent_size = map.apparent_size;
+        result->data_bytes = map.data_bytes;
+        result->extents = map.count;
+    }
+
+    fclose(in);
+    if (out && status == 0 && atomic_commit(&output) != 0) status = -1;
+    atomic_abort(&output);
+    stream_file_wipe(&file);
+    stream_keys_wipe(&keys);
+    stream_buffers_free(&buffers);
+    sparse_map_free(&map);
+    return status;
+}
+
+void sparse_writer_init(SparseWriter* writer, FILE* out){
+    struct stat info;
+    memset(writer, 0, sizeof(SparseWriter));
+    writer->out = out;
+    writer->seekable = fstat(fileno(out), &info) == 0 && S_ISREG(info.st_mode);
+}
+
+void sparse_writer_free(SparseWriter* writer){
+    sparse_map_free(&writer->map);
+}
+
+static int parse_hex16(const unsigned char* text, unsigned long long* value){
+    char digits[17];
+    char* end = NULL;
+    memcpy(digits, text, 16);
+    digits[16] = '\0';
+    *value = strtoull(digits, &end, 16);
+    return end == digits + 16 ? 0 : -1;
+}
+
+static int parse_table_header(SparseWriter* writer){
+    unsigned long long count = 0;
+    size_t magic_len = strlen(SPARSE_MAGIC);
+    if (memcmp(writer->header, SPARSE_MAGIC, magic_len) != 0
+        || parse_hex16(writer->header + magic_len, &writer->map.apparent_size) != 0
+        || parse_hex16(writer->header + magic_len + 16, &count) != 0
+        || writer->header[SPARSE_HEADER_SIZE - 1] != '\n' || count > writer->map.apparent_size) {
+        fprintf(stderr, SPARSE_TABLE_FAILURE);
+        return -1;
+    }
+    writer->expected_extents = (size_t)count;
+    return 0;
+}
+
+// Extents must be in order, non-empty, apart and inside the file
+static int parse_record(SparseWriter* writer){
+    unsigned long long offset = 0;
+    unsigned long long length = 0;
+    unsigned long long previous_end = 0;
+    if (writer->map.count > 0) {
+        const SparseExtent* last = &writer->map.extents[writer->map.count - 1];
+        previous_end = last->offset + last->length;
+    }
+    if (parse_hex16(writer->record, &offset) != 0 || parse_hex16(writer->record + 16, &length) != 0
+        || writer->record[SPARSE_RECORD_SIZE - 1] != '\n' || length == 0 || offset < previous_end
+        || offset > writer->map.apparent_size || length > writer->map.apparent_size - offset) {
+        fprintf(stderr, SPARSE_TABLE_FAILURE);
+        return -1;
+    }
+    return add_extent(&writer->map, offset, length);
+}
+
+static int write_zeros(FILE* out, unsigned long long count){
+    static const unsigned char zeros[4096];
+    while (count > 0) {
+        size_t chunk = count < sizeof(zeros) ? (size_t)count : sizeof(zeros);
+        if (fwrite(zeros, 1, chunk, out) != chunk) return -1;
+        count -= chunk;
+    }
+    return 0;
+}
+
+static int move_to(SparseWriter* writer, unsigned long long target){
+    if (target == writer->position) return 0;
+    int status = writer->seekable ? seek_file(writer->out, target)
+                                  : write_zeros(writer->out, target - writer->position);
+    if (status != 0) {
+        fprintf(stderr, FILE_WRITE_FAILURE);
+        return -1;
+    }
+    writer->position = target;
+    return 0;
+}
+
+int sparse_writer_feed(SparseWriter* writer, const unsigned char* data, size_t len){
+    while (len > 0) {
+        if (writer->header_len < SPARSE_HEADER_SIZE) {
+            size_t take = SPARSE_HEADER_SIZE - writer->header_len;
+            if (take > len) take = len;
+            memcpy(writer->header + writer->header_len, data, take);
+            writer->header_len += take;
+            data += take;
+            len -= take;
+            if (writer->header_len == SPARSE_HEADER_SIZE && parse_table_header(writer) != 0) return -1;
+            continue;
+        }
+        if (writer->map.count < writer->expected_extents) {
+            size_t take = SPARSE_RECORD_SIZE - writer->record_len;
+            if (take > len) take = len;
+            memcpy(writer->record + writer->record_len, data, take);
+            writer->record_len += take;
+            data += take;
+            len -= take;
+            if (writer->record_len == SPARSE_RECORD_SIZE) {
+                writer->record_len = 0;
+                if (parse_record(writer) != 0) return -1;
+            }
+            continue;
+        }
+
+        while (writer->extent < writer->map.count && writer->filled == writer->map.extents[writer->extent].length) {
+            writer->extent++;
+            writer->filled = 0;
+        }
+        if (writer->extent >= writer->map.count) {
+            fprintf(stderr, "Sparse data runs past its extents\n");
+            return -1;
+        }
+        const SparseExtent* extent = &writer->map.extents[writer->extent];
+        if (writer->filled == 0 && move_to(writer, extent->offset) != 0) return -1;
+        size_t take = extent->length - writer->filled < len ? (size_t)(extent->length - writer->filled) : len;
+        if (fwrite(data, 1, take, writer->out) != take) {
+            fprintf(stderr, FILE_WRITE_FAILURE);
+            return -1;
+        }
+        writer->filled += take;
+        writer->position += take;
+        data += take;
+        len -= take;
+    }
+    return 0;
+}
+
+int sparse_writer_finish(SparseWriter* writer){
+    unsigned long long written = 0;
+    for (size_t i = 0; i < writer->extent && i < writer->map.count; i++) {
+        written += writer->map.extents[i].length;
+    }
+    written += writer->filled;
+    if (writer->header_len < SPARSE_HEADER_SIZE || writer->map.count < writer->expected_extents
+        || written != writer->map.data_bytes) {
+        fprintf(stderr, "Sparse data ends early\n");
+        return -1;
+    }
+    // The trailing hole: a regular file is simply extended
+    if (writer->seekable) {
+        if (truncate_file(writer->out, writer->map.apparent_size) != 0) {
+            fprintf(stderr, FILE_WRITE_FAILURE);
+            return -1;
+        }
+        return 0;
+    }
+    return move_to(writer, writer->map.apparent_size);
+}
@@ -0,0 +1,138 @@
+#include "../../include/utils/stats.h"
+#include <string.h>
+#include <time.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+#include "../../include/common/optimization.h"
+#include "../../include/crypto/diffusion_simd.h"
+#include "../../include/crypto/ghash.h"
+#include "../../include/crypto/password_simd.h"
+#include "../../include/utils/memory_budget.h"
+#include "../../include/utils/topology.h"
+
+static unsigned long long cipher_bytes_in;
+static unsigned long long cipher_bytes_out;
+static unsigned long long cipher_blocks;
+static double started;
+
+static double now_seconds(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+void stats_add_cipher(unsigned long long bytes_in, unsigned long long bytes_out, unsigned long long blocks){
+    __atomic_fetch_add(&cipher_bytes_in, bytes_in, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&cipher_bytes_out, bytes_out, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&cipher_blocks, blocks, __ATOMIC_RELAXED);
+}
+
+void stats_start(void){
+    started = now_seconds();
+}
+
+void stats_collect(RunStats* stats){
+    memset(stats, 0, sizeof(RunStats));
+    stats->bytes_in = __atomic_load_n(&cipher_bytes_in, __ATOMIC_RELAXED);
+    stats->bytes_out = __atomic_load_n(&cipher_bytes_out, __ATOMIC_RELAXED);
+    stats->blocks = __atomic_load_n(&cipher_blocks, __ATOMIC_RELAXED);
+    stats->wall_seconds = now_seconds() - started;
+    stats->mallocs = -1;
+    stats->malloc_bytes = -1;
+    stats->max_memory = memory_budget_limit();
+    stats->budget_peak = memory_budget_peak();
+    buffer_pool_stats(&stats->pool);
+    stats->numa_nodes = topology_get()->num_nodes;
+    stats->cpus = topology_get()->num_cpus;
+    placement_describe(stats->placement, sizeof(stats->placement));
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        stats->user_seconds = (double)usage.ru_utime.tv_sec + (double)usage.ru_utime.tv_usec / 1e6;
+        stats->system_seconds = (double)usage.ru_stime.tv_sec + (double)usage.ru_stime.tv_usec / 1e6;
+#ifdef __APPLE__
+        stats->peak_rss_kb = usage.ru_maxrss / 1024;  // bytes on macOS
+#else
+        stats->peak_rss_kb = usage.ru_maxrss;
+#endif
+        stats->minor_faults = usage.ru_minflt;
+        stats->major_faults = usage.ru_majflt;
+    }
+#endif
+}
+
+static const char* huge_page_name(int huge_pages){
+    if (huge_pages == 1) return "hugetlb";
+    return huge_pages == 2 ? "transparent" : "none";
+}
+
+static double megabytes_per_second(const RunStats* stats){
+    return stats->wall_seconds > 0 ? (double)stats->bytes_in / 1e6 / stats->wall_seconds : 0.0;
+}
+
+void stats_print_text(const RunStats* stats, int status, FILE* out){
+    fprintf(out, "Status: %s\n", status == 0 ? "ok" : "failed");
+    fprintf(out, "Cipher: %llu bytes in, %llu bytes out, %llu blocks\n",
+            stats->bytes_in, stats->bytes_out, stats->blocks);
+    fprintf(out, "Time: %.5f s wall, %.5f s user, %.5f s system (%.2f MB/s)\n",
+            stats->wall_seconds, stats->user_seconds, stats->system_seconds, megabytes_per_second(stats));
+    fprintf(out, "Memory: %ld KiB peak RSS, %ld minor and %ld major page faults\n",
+            stats->peak_rss_kb, stats->minor_faults, stats->major_faults);
+    if (stats->mallocs >= 0) {
+        fprintf(out, "Allocations: %lld (%lld bytes)\n", stats->mallocs, stats->malloc_bytes);
+    }
+    if (stats->max_memory) {
+        fprintf(out, "Memory budget: %llu of %llu buffer bytes used at peak (--max-memory=%llu)\n",
+                stats->budget_peak, memory_budget_available(), stats->max_memory);
+    }
+    fprintf(out, "Buffer pool: %llu hits, %llu misses, %llu bytes mapped, huge pages %s\n",
+            stats->pool.hits, stats->pool.misses, stats->pool.mapped_bytes, huge_page_name(stats->pool.huge_pages));
+    fprintf(out, "Topology: %zu NUMA node%s, %zu CPU%s; workers %s\n", stats->numa_nodes,
+            stats->numa_nodes == 1 ? "" : "s", stats->cpus, stats->cpus == 1 ? "" : "s", stats->placement);
+    fprintf(out, "Kernels: %s; mix_columns %s, password chunker %s, ghash %s\n",
+            get_optimization_level_name(get_optimization_settings()->current_level),
+            mix_columns_kernel(), chunker_kernel(), ghash_kernel());
+}
+
+void stats_print_json(const RunStats* stats, int status, FILE* out){
+    fprintf(out, "{\"status\":%d,\"bytes_in\":%llu,\"bytes_out\":%llu,\"blocks\":%llu,"
+            "\"wall_seconds\":%.6f,\"user_seconds\":%.6f,\"system_seconds\":%.6f,\"mb_per_second\":%.3f,"
+            "\"peak_rss_kb\":%ld,\"minor_faults\":%ld,\"major_faults\":%ld,",
+            status, stats->bytes_in, stats->bytes_out, stats->blocks,
+            stats->wall_seconds, stats->user_seconds, stats->system_seconds, megabytes_per_second(stats),
+            stats->peak_rss_kb, stats->minor_faults, stats->major_faults);
+    if (stats->mallocs >= 0) {
+        fprintf(out, "\"mallocs\":%lld,\"malloc_bytes\":%lld,", stats->mallocs, stats->malloc_bytes);
+    } else {
+        fprintf(out, "\"mallocs\":null,\"malloc_bytes\":null,");
+    }
+    if (stats->max_memory) {
+        fprintf(out, "\"max_memory\":%llu,\"budget_peak_bytes\":%llu,", stats->max_memory, stats->budget_peak);
+    } else {
+        fprintf(out, "\"max_memory\":null,\"budget_peak_bytes\":null,");
+    }
+    fprintf(out, "\"buffer_pool\":{\"hits\":%llu,\"misses\":%llu,\"mapped_bytes\":%llu,\"huge_pages\":\"%s\"},",
+            stats->pool.hits, stats->pool.misses, stats->pool.mapped_bytes, huge_page_name(stats->pool.huge_pages));
+    fprintf(out, "\"topology\":{\"numa_nodes\":%zu,\"cpus\":%zu,\"placement\":\"%s\"},",
+            stats->numa_nodes, stats->cpus, stats->placement);
+    // Level, kernel and placement descriptions are fixed strings, so they need no escaping
+    fprintf(out, "\"optimization_level\":\"%s\",\"kernels\":{\"mix_columns\":\"%s\",\"password_chunker\":\"%s\","
+            "\"ghash\":\"%s\",\"sub_bytes\":\"scalar\",\"shift_rows\":\"scalar\",\"add_round_key\":\"scalar\"}}\n",
+            get_optimization_level_name(get_optimization_settings()->current_level), mix_columns_kernel(), chunker_kernel(), ghash_kernel());
+}
+
+int stats_write_json(const RunStats* stats, int status, const char* path){
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to open metrics file: %s\n", path);
+        return -1;
+    }
+    stats_print_json(stats, status, file);
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed) {
+        fprintf(stderr, "Failed to write metrics file: %s\n", path);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,468 @@
+#include "../../include/utils/stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "../../include/common/config.h"
+#include "../../include/common/failures.h"
+#include "../../include/crypto/cipher_context.h"
+#include "../../include/crypto/random.h"
+#include "../../include/utils/buffer_pool.h"
+#include "../../include/utils/compress.h"
+#include "../../include/utils/sparse.h"
+#include "../../include/utils/trace.h"
+
+#define STREAM_OUT_CAPACITY (STREAM_BUFFER_SIZE * 2 + BLOCK_HEX_SIZE)
+
+// Sized for the worst case of either direction: hex doubles on encryption
+int stream_buffers_init(StreamBuffers* buffers){
+    buffers->out_capacity = 0;
+    buffers->in_pending = 0;
+    buffers->in = NULL;
+    buffers->out = NULL;
+    buffers->out_capacity = STREAM_OUT_CAPACITY;
+    buffers->in = buffer_pool_get(STREAM_BUFFER_SIZE);
+    buffers->out = buffer_pool_get(buffers->out_capacity);
+    if (!buffers->in || !buffers->out) {
+        stream_buffers_free(buffers);
+        return -1;
+    }
+    return 0;
+}
+
+size_t stream_buffers_charge(void){
+    return buffer_pool_charge(STREAM_BUFFER_SIZE) + buffer_pool_charge(STREAM_OUT_CAPACITY);
+}
+
+void stream_buffers_free(StreamBuffers* buffers){
+    buffer_pool_put(buffers->in, STREAM_BUFFER_SIZE);
+    buffer_pool_put(buffers->out, buffers->out_capacity);
+    buffers->out_capacity = 0;
+    buffers->in = NULL;
+    buffers->out = NULL;
+}
+
+// Where decrypted output goes: through the decompressor, then the sparse
+// writer, when the container has them
+typedef struct {
+    FILE* out;
+    SparseWriter* sparse;
+    Inflater* inflater;
+} StreamSink;
+
+static int emit_plain(void* arg, const unsigned char* data, size_t len){
+    StreamSink* sink = arg;
+    TRACE_START(started);
+    int status = EXIT_SUCCESS;
+    if (sink->sparse) {
+        status = sparse_writer_feed(sink->sparse, data, len) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    } else if (fwrite(data, 1, len, sink->out) != len) {
+        fprintf(stderr, FILE_WRITE_FAILURE);
+        status = EXIT_FAILURE;
+    }
+    TRACE_SPAN(TRACE_WRITE, started);
+    return status;
+}
+
+static int emit(StreamSink* sink, const unsigned char* data, size_t len){
+    if (len == 0) return EXIT_SUCCESS;
+    if (sink->inflater) return inflater_feed(sink->inflater, data, len) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    return emit_plain(sink, data, len);
+}
+
+// The loop shared by stream_run and the container path. When mac is set
+// it sees the ciphertext: what is written on encryption, what is read on
+// decryption. The last hold_back input bytes are never processed and are
+// left at the start of buffers->in (in_pending) for the caller.
+static int stream_pump(FILE* in, StreamSink* sink, AxonCipherContext* ctx, StreamBuffers* buffers,
+                       MacState* mac, size_t hold_back, unsigned long long* consumed, unsigned long long* produced){
+    unsigned long long total_in = 0;
+    unsigned long long total_out = 0;
+
+    for (;;) {
+        size_t have = buffers->in_pending;
+        TRACE_START(read_started);
+        size_t bytes_read = fread(buffers->in + have, 1, STREAM_BUFFER_SIZE - have, in);
+        TRACE_SPAN(TRACE_READ, read_started);
+        if (bytes_read == 0 && ferror(in)) {
+            fprintf(stderr, FILE_PROCESSING_FAILURE);
+            return EXIT_FAILURE;
+        }
+        have += bytes_read;
+
+        size_t keep = hold_back < have ? hold_back : have;
+        size_t take = have - keep;
+        if (take > 0) {
+            size_t out_len = 0;
+            if (mac && ctx->mode == AXON_DECRYPT) mac_update(mac, buffers->in, take);
+            if (axon_cipher_update(ctx, buffers->in, take, buffers->out, buffers->out_capacity, &out_len) != 0) {
+                fprintf(stderr, ctx->mode == AXON_ENCRYPT ? ENCRYPTION_FAILURE : FILE_PARSE_FAILURE);
+                return EXIT_FAILURE;
+            }
+            if (mac && ctx->mode == AXON_ENCRYPT) mac_update(mac, buffers->out, out_len);
+            if (emit(sink, buffers->out, out_len) != EXIT_SUCCESS) return EXIT_FAILURE;
+            total_in += take;
+            total_out += out_len;
+            if (keep > 0) memmove(buffers->in, buffers->in + take, keep);
+        }
+        buffers->in_pending = keep;
+        if (bytes_read == 0) break;
+    }
+
+    size_t tail_len = 0;
+    if (axon_cipher_final(ctx, buffers->out, buffers->out_capacity, &tail_len) != 0) {
+        fprintf(stderr, FILE_WRITE_FAILURE);
+        return EXIT_FAILURE;
+    }
+    if (emit(sink, buffers->out, tail_len) != EXIT_SUCCESS) return EXIT_FAILURE;
+    if (mac && ctx->mode == AXON_ENCRYPT) mac_update(mac, buffers->out, tail_len);
+    if (consumed) *consumed = total_in;
+    if (produced) *produced = total_out + tail_len;
+    return EXIT_SUCCESS;
+}
+
+int stream_run(FILE* in, FILE* out, AxonCipherContext* ctx, StreamBuffers* buffers){
+    if (!in || !out) {
+        fprintf(stderr, FILE_PROCESSING_FAILURE);
+        return EXIT_FAILURE;
+    }
+    StreamSink sink = {out, NULL, NULL};
+    return stream_pump(in, &sink, ctx, buffers, NULL, 0, NULL, NULL);
+}
+
+int stream_write_header(FILE* out, const ContainerHeader* header){
+    char text[CONTAINER_HEADER_SIZE];
+    size_t size = container_header_size(header);
+    container_header_format(header, text);
+    if (fwrite(text, 1, size, out) != size) {
+        fprintf(stderr, FILE_WRITE_FAILURE);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+static size_t read_up_to(FILE* in, unsigned char* buffer, size_t got, size_t want){
+    while (got < want) {
+        size_t n = fread(buffer + got, 1, want - got, in);
+        if (n == 0) break;
+        got += n;
+    }
+    return got;
+}
+
+// Only the header is read before the key is judged, so a wrong key costs
+// one block encryption whatever the size of the file
+int stream_read_header(FILE* in, const ContainerHeader* expected, ContainerHeader* found,
+                       StreamBuffers* buffers){
+    size_t got = read_up_to(in, buffers->in, 0, CONTAINER_V1_HEADER_SIZE);
+    size_t size = container_header_length(buffers->in, got);
+    if (size > got) got = read_up_to(in, buffers->in, got, size);
+    if (ferror(in)) {
+        fprintf(stderr, FILE_PROCESSING_FAILURE);
+        return EXIT_FAILURE;
+    }
+
+    memset(found, 0, sizeof(ContainerHeader));
+    int parsed = container_header_parse(buffers->in, got, found);
+    if (parsed < 0) return EXIT_FAILURE;
+    if (parsed == 0) {
+        // Legacy file: what was read is already payload
+        buffers->in_pending = got;
+        return EXIT_SUCCESS;
+    }
+    if (!container_key_matches(found, expected)) {
+        fprintf(stderr, WRONG_KEY_FAILURE);
+        return EXIT_FAILURE;
+    }
+    buffers->in_pending = 0;
+    return EXIT_SUCCESS;
+}
+
+int stream_file_key(const StreamKeys* keys, const ContainerHeader* header, char file_key[BLOCK_SIZE]){
+    if (header->version < 2) {
+        memcpy(file_key, keys->password_key, BLOCK_SIZE);
+        return 0;
+    }
+    if (container_unwrap_key(header, keys->password_key, file_key) != 0) {
+        fprintf(stderr, "Damaged key slot in container header\n");
+        return -1;
+    }
+    return 0;
+}
+
+static void start_mac(StreamFile* file, const char file_key[BLOCK_SIZE]){
+    char text[CONTAINER_HEADER_SIZE];
+    container_header_format_authenticated(&file->header, text);
+    mac_key_init(&file->mac_key, file_key);
+    mac_start(&file->mac, &file->mac_key);
+    mac_update(&file->mac, text, container_header_size(&file->header));
+    file->authenticated = 1;
+}
+
+int stream_start_encrypt(const StreamKeys* keys, StreamFile* file){
+    char data_key[BLOCK_SIZE];
+    memset(file, 0, sizeof(StreamFile));
+    file->header = keys->header;
+    if (random_bytes(data_key, sizeof(data_key)) != 0
+        || container_wrap_key(&file->header, keys->password_key, data_key) != 0) {
+        return EXIT_FAILURE;
+    }
+    axon_cipher_init_key(&file->ctx, AXON_ENCRYPT, data_key);
+    start_mac(file, data_key);
+    memset(data_key, 0, sizeof(data_key));
+    return EXIT_SUCCESS;
+}
+
+int stream_begin_encrypt(FILE* out, const StreamKeys* keys, StreamFile* file){
+    if (stream_start_encrypt(keys, file) != EXIT_SUCCESS) return EXIT_FAILURE;
+    return stream_write_header(out, &file->header);
+}
+
+int stream_end_encrypt(FILE* out, StreamFile* file, unsigned long long plain_length){
+    char trailer[MAC_TRAILER_SIZE];
+    mac_finish(&file->mac, &file->mac_key, plain_length, trailer);
+    if (fwrite(trailer, 1, MAC_TRAILER_SIZE, out) != MAC_TRAILER_SIZE) {
+        fprintf(stderr, FILE_WRITE_FAILURE);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int stream_feed(FILE* out, StreamFile* file, const void* data, size_t len, StreamBuffers* buffers){
+    const unsigned char* cursor = data;
+    // buffers->out holds the hex of at most STREAM_BUFFER_SIZE bytes
+    while (len > 0) {
+        size_t take = len < STREAM_BUFFER_SIZE ? len : STREAM_BUFFER_SIZE;
+        size_t out_len = 0;
+        if (axon_cipher_update(&file->ctx, cursor, take, buffers->out, buffers->out_capacity, &out_len) != 0) {
+            fprintf(stderr, ENCRYPTION_FAILURE);
+            return EXIT_FAILURE;
+        }
+        mac_update(&file->mac, buffers->out, out_len);
+        TRACE_START(write_started);
+        if (out_len > 0 && fwrite(buffers->out, 1, out_len, out) != out_len) {
+            fprintf(stderr, FILE_WRITE_FAILURE);
+            return EXIT_FAILURE;
+        }
+        TRACE_SPAN(TRACE_WRITE, write_started);
+        cursor += take;
+        len -= take;
+    }
+    return EXIT_SUCCESS;
+}
+
+int stream_finish_encrypt(FILE* out, StreamFile* file, StreamBuffers* buffers, unsigned long long plain_length){
+    size_t tail_len = 0;
+    if (axon_cipher_final(&file->ctx, buffers->out, buffers->out_capacity, &tail_len) != 0
+        || (tail_len > 0 && fwrite(buffers->out, 1, tail_len, out) != tail_len)) {
+        fprintf(stderr, FILE_WRITE_FAILURE);
+        return EXIT_FAILURE;
+    }
+    mac_update(&file->mac, buffers->out, tail_len);
+    return stream_end_encrypt(out, file, plain_length);
+}
+
+static int allow_unauthenticated = 0;
+
+void stream_allow_unauthenticated(int allow){
+    allow_unauthenticated = allow;
+}
+
+int stream_begin_decrypt(FILE* in, const StreamKeys* keys, StreamFile* file, StreamBuffers* buffers){
+    char file_key[BLOCK_SIZE];
+    memset(file, 0, sizeof(StreamFile));
+    if (stream_read_header(in, &keys->header, &file->header, buffers) != EXIT_SUCCESS) return EXIT_FAILURE;
+    if (!(file->header.flags & CONTAINER_FLAG_MAC) && !allow_unauthenticated) {
+        buffers->in_pending = 0;
+        fprintf(stderr, UNAUTHENTICATED_FAILURE);
+        return EXIT_FAILURE;
+    }
+    if (stream_file_key(keys, &file->header, file_key) != 0) return EXIT_FAILURE;
+    axon_cipher_init_key(&file->ctx, AXON_DECRYPT, file_key);
+    if (file->header.flags & CONTAINER_FLAG_MAC) start_mac(file, file_key);
+    memset(file_key, 0, sizeof(file_key));
+    return EXIT_SUCCESS;
+}
+
+void stream_file_wipe(StreamFile* file){
+    volatile unsigned char* bytes = (volatile unsigned char*)file;
+    for (size_t i = 0; i < sizeof(StreamFile); i++) {
+        bytes[i] = 0;
+    }
+}
+
+// Runs once the payload is through: the trailer is what stream_pump held back
+static int stream_check_trailer(StreamSink* sink, StreamFile* file, StreamBuffers* buffers,
+                                unsigned long long payload_length, unsigned long long produced){
+    unsigned long long plain_length = 0;
+    char tag[MAC_TAG_HEX_SIZE + 1];
+    char expected[MAC_TRAILER_SIZE];
+
+    if (buffers->in_pending != MAC_TRAILER_SIZE || mac_parse_trailer(buffers->in, &plain_length, tag) != 0) {
+        buffers->in_pending = 0;
+        fprintf(stderr, "Missing or damaged MAC trailer\n");
+        return EXIT_FAILURE;
+    }
+    buffers->in_pending = 0;
+    mac_finish(&file->mac, &file->mac_key, plain_length, expected);
+    if (!mac_tags_equal(tag, expected + MAC_AUTHENTICATED_PREFIX)
+        || payload_length != (unsigned long long)axon_encrypted_size((size_t)plain_length)
+        || produced > plain_length) {
+        fprintf(stderr, MAC_FAILURE);
+        return EXIT_FAILURE;
+    }
+
+    // The chain cannot tell padding from trailing zero bytes; the
+    // authenticated length can, so restore any the last block dropped
+    static const unsigned char zeros[BLOCK_SIZE];
+    return emit(sink, zeros, (size_t)(plain_length - produced));
+}
+
+// Compressed containers: every segment read becomes one frame of the
+// plaintext the chain sees, and the trailer records the framed length
+static int stream_compress(FILE* in, FILE* out, StreamFile* file, StreamBuffers* buffers){
+    unsigned char* frame = buffer_pool_get(compress_frame_bound());
+    unsigned long long framed = 0;
+    int status = EXIT_SUCCESS;
+    if (!frame) return EXIT_FAILURE;
+    for (;;) {
+        TRACE_START(read_started);
+        size_t have = read_up_to(in, buffers->in, 0, COMPRESS_SEGMENT_SIZE);
+        TRACE_SPAN(TRACE_READ, read_started);
+        if (ferror(in)) {
+            fprintf(stderr, FILE_PROCESSING_FAILURE);
+            status = EXIT_FAILURE;
+            break;
+        }
+        if (have == 0) break;
+        size_t frame_len = compress_frame(buffers->in, have, frame);
+        status = stream_feed(out, file, frame, frame_len, buffers);
+        if (status != EXIT_SUCCESS) break;
+        framed += frame_len;
+    }
+    buffer_pool_put(frame, compress_frame_bound());
+    return status == EXIT_SUCCESS ? stream_finish_encrypt(out, file, buffers, framed) : status;
+}
+
+int stream_run_container(FILE* in, FILE* out, AxonCipherMode mode, const StreamKeys* keys,
+                         StreamBuffers* buffers){
+    if (!in || !out) {
+        fprintf(stderr, FILE_PROCESSING_FAILURE);
+        return EXIT_FAILURE;
+    }
+
+    StreamFile file;
+    StreamSink sink = {out, NULL, NULL};
+    unsigned long long consumed = 0;
+    unsigned long long produced = 0;
+    int status;
+    if (mode == AXON_ENCRYPT) {
+        status = stream_begin_encrypt(out, keys, &file);
+        if (status == EXIT_SUCCESS && (file.header.flags & CONTAINER_FLAG_COMPRESSED)) {
+            status = stream_compress(in, out, &file, buffers);
+        } else if (status == EXIT_SUCCESS) {
+            status = stream_pump(in, &sink, &file.ctx, buffers, &file.mac, 0, &consumed, NULL);
+            if (status == EXIT_SUCCESS) status = stream_end_encrypt(out, &file, consumed);
+        }
+    } else {
+        SparseWriter writer;
+        Inflater inflater;
+        status = stream_begin_decrypt(in, keys, &file, buffers);
+        if (status == EXIT_SUCCESS && (file.header.flags & CONTAINER_FLAG_SPARSE)) {
+            sparse_writer_init(&writer, out);
+            sink.sparse = &writer;
+        }
+        if (status == EXIT_SUCCESS && (file.header.flags & CONTAINER_FLAG_COMPRESSED)) {
+            if (inflater_init(&inflater, emit_plain, &sink) == 0) {
+                sink.inflater = &inflater;
+            } else {
+                status = EXIT_FAILURE;
+            }
+        }
+        if (status == EXIT_SUCCESS && !file.authenticated) {
+            status = stream_pump(in, &sink, &file.ctx, buffers, NULL, 0, NULL, NULL);
+        } else if (status == EXIT_SUCCESS) {
+            status = stream_pump(in, &sink, &file.ctx, buffers, &file.mac, MAC_TRAILER_SIZE,
+                                 &consumed, &produced);
+            if (status == EXIT_SUCCESS) status = stream_check_trailer(&sink, &file, buffers, consumed, produced);
+        }
+        if (sink.inflater) {
+            if (status == EXIT_SUCCESS && inflater_finish(sink.inflater) != 0) status = EXIT_FAILURE;
+            inflater_free(sink.inflater);
+        }
+        if (sink.sparse) {
+            if (status == EXIT_SUCCESS && sparse_writer_finish(sink.sparse) != 0) status = EXIT_FAILURE;
+            sparse_writer_free(sink.sparse);
+        }
+    }
+    stream_file_wipe(&file);
+    return status;
+}
+
+unsigned long long stream_output_size(AxonCipherMode mode, const char* source){
+    struct stat info;
+    if (strcmp(source, STDIO_PATH) == 0 || stat(source, &info) != 0 || !S_ISREG(info.st_mode)) return 0;
+    unsigned long long size = (unsigned long long)info.st_size;
+    if (mode == AXON_ENCRYPT) {
+        return CONTAINER_HEADER_SIZE + (size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_HEX_SIZE + MAC_TRAILER_SIZE;
+    }
+
+    // Sparse and compressed payloads say nothing about the output size
+    unsigned char text[CONTAINER_HEADER_SIZE];
+    ContainerHeader header;
+    FILE* file = fopen(source, "rb");
+    if (!file) return 0;
+    size_t got = fread(text, 1, sizeof(text), file);
+    fclose(file);
+    int parsed = container_header_parse(text, got, &header);
+    if (parsed < 0 || (parsed > 0 && (header.flags & (CONTAINER_FLAG_SPARSE | CONTAINER_FLAG_COMPRESSED)))) return 0;
+    unsigned long long framing = parsed > 0 ? container_header_size(&header) : 0;
+    if (parsed > 0 && (header.flags & CONTAINER_FLAG_MAC)) framing += MAC_TRAILER_SIZE;
+    return size > framing ? (size - framing) / BLOCK_HEX_SIZE * BLOCK_SIZE : 0;
+}
+
+int stream_keys_init(StreamKeys* keys, const char* password){
+    memset(keys, 0, sizeof(StreamKeys));
+    if (container_header_init(&keys->header, password) != 0
+        || axon_password_key(password, keys->password_key) != 0) {
+        stream_keys_wipe(keys);
+        return -1;
+    }
+    keys->header.flags |= CONTAINER_FLAG_MAC;
+    return 0;
+}
+
+void stream_keys_wipe(StreamKeys* keys){
+    volatile unsigned char* bytes = (volatile unsigned char*)keys;
+    for (size_t i = 0; i < sizeof(StreamKeys); i++) {
+        bytes[i] = 0;
+    }
+}
+
+static int stream_process(FILE* in, FILE* out, const char* password, AxonCipherMode mode, unsigned int flags){
+    StreamKeys keys;
+    StreamBuffers buffers;
+
+    if (stream_keys_init(&keys, password) != 0) return EXIT_FAILURE;
+    keys.header.flags |= flags;
+    if (stream_buffers_init(&buffers) != 0) {
+        stream_keys_wipe(&keys);
+        return EXIT_FAILURE;
+    }
+    int status = stream_run_container(in, out, mode, &keys, &buffers);
+    stream_keys_wipe(&keys);
+    stream_buffers_free(&buffers);
+    return status;
+}
+
+int stream_encrypt(FILE* in, FILE* out, const char* password){
+    return stream_process(in, out, password, AXON_ENCRYPT, 0);
+}
+
+int stream_encrypt_flags(FILE* in, FILE* out, const char* password, unsigned int flags){
+    return stream_process(in, out, password, AXON_ENCRYPT, flags);
+}
+
+int stream_decrypt(FILE* in, FILE* out, const char* password){
+    return stream_process(in, out, password, AXON_DECRYPT, 0);
+}
@@ -0,0 +1,252 @@
+#include "../../include/utils/thread_pool.h"
+#include "../../include/common/failures.h"
+#include "../../include/utils/topology.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct ThreadPoolTask {
+    thread_pool_task_fn fn;
+    void* arg;
+    struct ThreadPoolTask* prev;
+    struct ThreadPoolTask* next;
+} ThreadPoolTask;
+
+// Every worker owns a deque. It takes work from the front of its own deque
+// and, once that runs dry, steals from the back of the others, so a worker
+// that drew a few large jobs does not leave the rest idle.
+typedef struct {
+    ThreadPoolTask* head;
+    ThreadPoolTask* tail;
+    pthread_mutex_t lock;
+} TaskDeque;
+
+typedef struct {
+    ThreadPool* pool;
+    size_t index;
+} WorkerStart;
+
+struct ThreadPool {
+    pthread_t* threads;
+    WorkerStart* starts;
+    TaskDeque* deques;
+    size_t num_threads;
+    size_t num_started;  // workers to join; fewer than num_threads only when create failed
+    size_t next_deque;
+    size_t queued;   // tasks sitting in a deque
+    size_t pending;  // queued plus running
+    int shutting_down;
+    pthread_mutex_t lock;
+    pthread_cond_t has_work;
+    pthread_cond_t idle;
+};
+
+static pthread_key_t worker_index_key;
+static pthread_once_t worker_index_once = PTHREAD_ONCE_INIT;
+
+static void create_worker_index_key(void){
+    pthread_key_create(&worker_index_key, NULL);
+}
+
+static ThreadPoolTask* pop_front(TaskDeque* deque){
+    pthread_mutex_lock(&deque->lock);
+    ThreadPoolTask* task = deque->head;
+    if (task) {
+        deque->head = task->next;
+        if (deque->head) deque->head->prev = NULL;
+        else deque->tail = NULL;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return task;
+}
+
+static ThreadPoolTask* pop_back(TaskDeque* deque){
+    pthread_mutex_lock(&deque->lock);
+    ThreadPoolTask* task = deque->tail;
+    if (task) {
+        deque->tail = task->prev;
+        if (deque->tail) deque->tail->next = NULL;
+        else deque->head = NULL;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return task;
+}
+
+static void push_back(TaskDeque* deque, ThreadPoolTask* task){
+    pthread_mutex_lock(&deque->lock);
+    task->next = NULL;
+    task->prev = deque->tail;
+    if (deque->tail) deque->tail->next = task;
+    else deque->head = task;
+    deque->tail = task;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+static ThreadPoolTask* find_task(ThreadPool* pool, size_t self){
+    ThreadPoolTask* task = pop_front(&pool->deques[self]);
+    for (size_t i = 1; !task && i < pool->num_threads; i++) {
+        task = pop_back(&pool->deques[(self + i) % pool->num_threads]);
+    }
+    return task;
+}
+
+static void* worker_main(void* arg){
+    WorkerStart* start = arg;
+    ThreadPool* pool = start->pool;
+    size_t self = start->index;
+
+    pthread_setspecific(worker_index_key, (void*)(uintptr_t)(self + 1));
+    // Before any task runs, so the buffers it first touches are local
+    placement_bind_worker(self);
+
+    for (;;) {
+        ThreadPoolTask* task = find_task(pool, self);
+        if (!task) {
+            pthread_mutex_lock(&pool->lock);
+            while (pool->queued == 0 && !pool->shutting_down) {
+                pthread_cond_wait(&pool->has_work, &pool->lock);
+            }
+            int done = pool->queued == 0 && pool->shutting_down;
+            pthread_mutex_unlock(&pool->lock);
+            if (done) break;
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        pool->queued--;
+        pthread_mutex_unlock(&pool->lock);
+
+        task->fn(task->arg);
+        free(task);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_broadcast(&pool->idle);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+ThreadPool* thread_pool_create(size_t num_threads){
+    if (num_threads == 0) num_threads = default_thread_count();
+    pthread_once(&worker_index_once, create_worker_index_key);
+
+    ThreadPool* pool = calloc(1, sizeof(ThreadPool));
+    if (!pool) {
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        return NULL;
+    }
+    pool->threads = calloc(num_threads, sizeof(pthread_t));
+    pool->starts = calloc(num_threads, sizeof(WorkerStart));
+    pool->deques = calloc(num_threads, sizeof(TaskDeque));
+    if (!pool->threads || !pool->starts || !pool->deques) {
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        free(pool->threads);
+        free(pool->starts);
+        free(pool->deques);
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->has_work, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+    for (size_t i = 0; i < num_threads; i++) {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+    }
+    pool->num_threads = num_threads;
+
+    for (size_t i = 0; i < num_threads; i++) {
+        pool->starts[i].pool = pool;
+        pool->starts[i].index = i;
+        if (pthread_create(&pool->threads[i], NULL, worker_main, &pool->starts[i]) != 0) {
+            fprintf(stderr, "Failed to start worker thread %zu\n", i);
+            thread_pool_destroy(pool);
+            return NULL;
+        }
+        pool->num_started = i + 1;
+    }
+    return pool;
+}
+
+// Tasks are dealt round-robin, so submitting in priority order gives every
+// worker its own deque in that same order
+int thread_pool_submit(ThreadPool* pool, thread_pool_task_fn fn, void* arg){
+    if (!pool || !fn) return -1;
+
+    ThreadPoolTask* task = malloc(sizeof(ThreadPoolTask));
+    if (!task) {
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        return -1;
+    }
+    task->fn = fn;
+    task->arg = arg;
+
+    // Published and counted under the pool lock: a worker that steals the
+    // task straight away cannot take it off queued before it was added
+    pthread_mutex_lock(&pool->lock);
+    size_t target = pool->next_deque;
+    pool->next_deque = (pool->next_deque + 1) % pool->num_threads;
+    pool->pending++;
+    pool->queued++;
+    push_back(&pool->deques[target], task);
+    pthread_cond_signal(&pool->has_work);
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+void thread_pool_wait(ThreadPool* pool){
+    if (!pool) return;
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Runs every queued task before the workers exit
+void thread_pool_destroy(ThreadPool* pool){
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutting_down = 1;
+    pthread_cond_broadcast(&pool->has_work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 0; i < pool->num_started; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    for (size_t i = 0; i < pool->num_threads; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->has_work);
+    pthread_cond_destroy(&pool->idle);
+    free(pool->threads);
+    free(pool->starts);
+    free(pool->deques);
+    free(pool);
+}
+
+size_t thread_pool_size(const ThreadPool* pool){
+    return pool ? pool->num_threads : 0;
+}
+
+// Index of the calling worker within its pool, or -1 outside any pool.
+// Lets tasks keep per-worker scratch state without locking.
+int thread_pool_worker_index(void){
+    pthread_once(&worker_index_once, create_worker_index_key);
+    uintptr_t value = (uintptr_t)pthread_getspecific(worker_index_key);
+    return value == 0 ? -1 : (int)(value - 1);
+}
+
+size_t default_thread_count(void){
+    if (placement_cpu_count() > 0) return placement_cpu_count();
+#if defined(_SC_NPROCESSORS_ONLN)
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (online > 0) return (size_t)online;
+#endif
+    return 1;
+}
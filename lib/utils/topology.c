@@ -0,0 +1,205 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // sched_getcpu, CPU_SET and pthread_setaffinity_np
+#endif
+#include "../../include/utils/topology.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#define TOPOLOGY_LIST_MAX 4096
+
+static Topology topology;
+static pthread_once_t topology_once = PTHREAD_ONCE_INIT;
+
+// Workers are bound to one CPU each (a list) or to all of a node's CPUs
+static int placement_active;
+static int placement_by_node;
+static size_t plan_count;
+static short plan_cpus[TOPOLOGY_MAX_CPUS];
+static size_t plan_node_count;
+static short plan_nodes[TOPOLOGY_MAX_NODES];
+static char placement_text[128] = "unpinned";
+
+int topology_parse_cpus(const char* list, unsigned char* set){
+    memset(set, 0, TOPOLOGY_MAX_CPUS);
+    const char* cursor = list;
+    int any = 0;
+    while (*cursor && *cursor != '\n') {
+        char* end = NULL;
+        long first = strtol(cursor, &end, 10);
+        long last = first;
+        if (end == cursor) return -1;
+        if (*end == '-') {
+            cursor = end + 1;
+            last = strtol(cursor, &end, 10);
+            if (end == cursor) return -1;
+        }
+        if (first < 0 || last < first || last >= TOPOLOGY_MAX_CPUS) return -1;
+        for (long cpu = first; cpu <= last; cpu++) set[cpu] = 1;
+        any = 1;
+        cursor = end;
+        if (*cursor == ',') cursor++;
+        else if (*cursor && *cursor != '\n') return -1;
+    }
+    return any ? 0 : -1;
+}
+
+static int read_list(const char* path, unsigned char* set){
+    char text[TOPOLOGY_LIST_MAX];
+    FILE* file = fopen(path, "r");
+    if (!file) return -1;
+    int status = fgets(text, sizeof(text), file) ? topology_parse_cpus(text, set) : -1;
+    fclose(file);
+    return status;
+}
+
+static void detect(void){
+    unsigned char allowed[TOPOLOGY_MAX_CPUS];
+    unsigned char nodes[TOPOLOGY_MAX_CPUS];
+    unsigned char node_cpus[TOPOLOGY_MAX_CPUS];
+
+    memset(allowed, 0, sizeof(allowed));
+#ifdef __linux__
+    cpu_set_t affinity;
+    if (sched_getaffinity(0, sizeof(affinity), &affinity) == 0) {
+        for (int cpu = 0; cpu < TOPOLOGY_MAX_CPUS && cpu < CPU_SETSIZE; cpu++) {
+            allowed[cpu] = CPU_ISSET(cpu, &affinity) ? 1 : 0;
+        }
+    } else
+#endif
+    {
+        allowed[0] = 1;
+    }
+
+    for (int cpu = 0; cpu < TOPOLOGY_MAX_CPUS; cpu++) {
+        topology.node_of_cpu[cpu] = allowed[cpu] ? 0 : -1;
+        if (allowed[cpu]) topology.num_cpus++;
+    }
+    topology.num_nodes = 1;
+
+    if (read_list("/sys/devices/system/node/online", nodes) != 0) return;
+    size_t found = 0;
+    for (int node = 0; node < TOPOLOGY_MAX_NODES; node++) {
+        char path[64];
+        if (!nodes[node]) continue;
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        // A memory-only node has an empty list
+        if (read_list(path, node_cpus) != 0) continue;
+        for (int cpu = 0; cpu < TOPOLOGY_MAX_CPUS; cpu++) {
+            if (node_cpus[cpu] && allowed[cpu]) topology.node_of_cpu[cpu] = (short)node;
+        }
+        found = (size_t)node + 1;
+    }
+    if (found > 0) topology.num_nodes = found;
+}
+
+const Topology* topology_get(void){
+    pthread_once(&topology_once, detect);
+    return &topology;
+}
+
+int topology_current_node(void){
+    const Topology* t = topology_get();
+    if (t->num_nodes <= 1) return 0;
+#ifdef __linux__
+    int cpu = sched_getcpu();
+    if (cpu >= 0 && cpu < TOPOLOGY_MAX_CPUS && t->node_of_cpu[cpu] >= 0) return t->node_of_cpu[cpu];
+#endif
+    return 0;
+}
+
+static size_t describe_cpus(char* text, size_t size){
+    size_t used = 0;
+    text[0] = '\0';
+    for (size_t i = 0; i < plan_count; i++) {
+        size_t start = i;
+        while (i + 1 < plan_count && plan_cpus[i + 1] == plan_cpus[i] + 1) i++;
+        int written = snprintf(text + used, size - used, start == i ? "%s%d" : "%s%d-%d",
+                               start == 0 ? "" : ",", plan_cpus[start], plan_cpus[i]);
+        if (written < 0 || (size_t)written >= size - used) break;
+        used += (size_t)written;
+    }
+    return used;
+}
+
+int placement_configure(const char* cpus, int numa_local){
+    const Topology* t = topology_get();
+    unsigned char wanted[TOPOLOGY_MAX_CPUS];
+
+    if (cpus && topology_parse_cpus(cpus, wanted) != 0) {
+        fprintf(stderr, "Invalid CPU list: %s\n", cpus);
+        return -1;
+    }
+    plan_count = 0;
+    for (int cpu = 0; cpu < TOPOLOGY_MAX_CPUS; cpu++) {
+        if (t->node_of_cpu[cpu] < 0 || (cpus && !wanted[cpu])) continue;
+        plan_cpus[plan_count++] = (short)cpu;
+    }
+    if (plan_count == 0) {
+        fprintf(stderr, "None of the CPUs in %s are available\n", cpus ? cpus : "the affinity mask");
+        return -1;
+    }
+#ifndef __linux__
+    fprintf(stderr, "CPU pinning is not supported on this platform; workers stay unpinned\n");
+    return 0;
+#endif
+
+    plan_node_count = 0;
+    for (size_t i = 0; numa_local && i < plan_count; i++) {
+        short node = t->node_of_cpu[plan_cpus[i]];
+        size_t n = 0;
+        while (n < plan_node_count && plan_nodes[n] != node) n++;
+        if (n == plan_node_count && plan_node_count < TOPOLOGY_MAX_NODES) plan_nodes[plan_node_count++] = node;
+    }
+    placement_by_node = numa_local;
+    placement_active = 1;
+
+    char list[96];
+    describe_cpus(list, sizeof(list));
+    if (numa_local) {
+        snprintf(placement_text, sizeof(placement_text), "numa local over %zu node%s, cpus %s",
+                 plan_node_count, plan_node_count == 1 ? "" : "s", list);
+    } else {
+        snprintf(placement_text, sizeof(placement_text), "pinned to cpus %s", list);
+    }
+    // The calling thread does the work of single-file runs
+    placement_bind_worker(0);
+    return 0;
+}
+
+int placement_enabled(void){
+    return placement_active;
+}
+
+size_t placement_cpu_count(void){
+    return placement_active ? plan_count : 0;
+}
+
+void placement_bind_worker(size_t index){
+    if (!placement_active) return;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (placement_by_node) {
+        short node = plan_nodes[index % plan_node_count];
+        for (size_t i = 0; i < plan_count; i++) {
+            if (topology.node_of_cpu[plan_cpus[i]] == node) CPU_SET(plan_cpus[i], &set);
+        }
+    } else {
+        CPU_SET(plan_cpus[index % plan_count], &set);
+    }
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        fprintf(stderr, "Failed to pin worker %zu\n", index);
+    }
+#else
+    (void)index;
+#endif
+}
+
+void placement_describe(char* text, size_t size){
+    snprintf(text, size, "%s", placement_text);
+}
@@ -0,0 +1,188 @@
+#include "../../include/utils/trace.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../include/common/failures.h"
+
+// Spans kept per thread; past this they are dropped but still counted
+#define TRACE_MAX_EVENTS (1u << 20)
+
+static const char* const stage_names[TRACE_STAGE_COUNT] = {
+    "read", "chunking", "cipher", "password_validation", "key_expansion", "add_round_key",
+    "sub_bytes", "shift_rows", "mix_columns", "hex_conversion", "write"
+};
+
+typedef struct {
+    uint64_t start;
+    uint64_t duration;
+    TraceStage stage;
+} TraceEvent;
+
+// Owned by one thread while it runs, read by trace_finish afterwards, so
+// recording takes no lock
+typedef struct TraceThread {
+    uint64_t calls[TRACE_STAGE_COUNT];
+    uint64_t nanoseconds[TRACE_STAGE_COUNT];
+    TraceEvent* events;
+    size_t num_events;
+    size_t capacity;
+    size_t dropped;
+    unsigned int id;
+    int is_main;
+    struct TraceThread* next;
+} TraceThread;
+
+int trace_enabled = 0;
+
+static char* trace_path;
+static uint64_t trace_epoch;
+static TraceThread* threads;
+static unsigned int next_thread_id;
+static pthread_mutex_t threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t main_thread;
+static pthread_key_t thread_key;
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+
+static void create_thread_key(void){
+    pthread_key_create(&thread_key, NULL);
+}
+
+uint64_t trace_now(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+static TraceThread* current_thread(void){
+    TraceThread* thread = pthread_getspecific(thread_key);
+    if (thread) return thread;
+    thread = calloc(1, sizeof(TraceThread));
+    if (!thread) return NULL;
+    pthread_mutex_lock(&threads_lock);
+    thread->id = ++next_thread_id;
+    thread->is_main = pthread_equal(pthread_self(), main_thread);
+    thread->next = threads;
+    threads = thread;
+    pthread_mutex_unlock(&threads_lock);
+    pthread_setspecific(thread_key, thread);
+    return thread;
+}
+
+static TraceThread* add_to_counters(TraceStage stage, uint64_t start, uint64_t end){
+    TraceThread* thread = current_thread();
+    if (!thread) return NULL;
+    thread->calls[stage]++;
+    thread->nanoseconds[stage] += end - start;
+    return thread;
+}
+
+void trace_count(TraceStage stage, uint64_t start){
+    add_to_counters(stage, start, trace_now());
+}
+
+void trace_span(TraceStage stage, uint64_t start){
+    uint64_t end = trace_now();
+    TraceThread* thread = add_to_counters(stage, start, end);
+    if (!thread || !trace_path) return;
+
+    if (thread->num_events == thread->capacity) {
+        size_t capacity = thread->capacity ? thread->capacity * 2 : 1024;
+        TraceEvent* events = capacity <= TRACE_MAX_EVENTS
+            ? realloc(thread->events, capacity * sizeof(TraceEvent)) : NULL;
+        if (!events) {
+            thread->dropped++;
+            return;
+        }
+        thread->events = events;
+        thread->capacity = capacity;
+    }
+    TraceEvent* event = &thread->events[thread->num_events++];
+    event->start = start - trace_epoch;
+    event->duration = end - start;
+    event->stage = stage;
+}
+
+int trace_start(const char* path){
+#ifndef AXON_TRACE
+    (void)path;
+    fprintf(stderr, "Tracing is not built in; configure with -DENABLE_TRACE=ON\n");
+    return -1;
+#else
+    pthread_once(&thread_key_once, create_thread_key);
+    if (path) {
+        trace_path = strdup(path);
+        if (!trace_path) {
+            fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+            return -1;
+        }
+    }
+    main_thread = pthread_self();
+    trace_epoch = trace_now();
+    trace_enabled = 1;
+    return 0;
+#endif
+}
+
+static int write_trace(const char* path){
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to open trace file: %s\n", path);
+        return -1;
+    }
+    // Complete ("X") events in microseconds, plus a name for every thread
+    const char* separator = "";
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (TraceThread* thread = threads; thread; thread = thread->next) {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                "\"args\":{\"name\":\"%s %u\"}}", separator, thread->id,
+                thread->is_main ? "main" : "worker", thread->id);
+        separator = ",\n";
+        for (size_t i = 0; i < thread->num_events; i++) {
+            const TraceEvent* event = &thread->events[i];
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"axon\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                    "\"ts\":%.3f,\"dur\":%.3f}", stage_names[event->stage], thread->id,
+                    (double)event->start / 1000.0, (double)event->duration / 1000.0);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    int status = ferror(file) ? -1 : 0;
+    if (fclose(file) != 0) status = -1;
+    if (status != 0) fprintf(stderr, "Failed to write trace file: %s\n", path);
+    return status;
+}
+
+int trace_finish(FILE* info){
+    if (!trace_enabled) return 0;
+    trace_enabled = 0;
+
+    uint64_t calls[TRACE_STAGE_COUNT] = {0};
+    uint64_t nanoseconds[TRACE_STAGE_COUNT] = {0};
+    size_t dropped = 0;
+    for (TraceThread* thread = threads; thread; thread = thread->next) {
+        for (size_t s = 0; s < TRACE_STAGE_COUNT; s++) {
+            calls[s] += thread->calls[s];
+            nanoseconds[s] += thread->nanoseconds[s];
+        }
+        dropped += thread->dropped;
+    }
+    fprintf(info, "%-20s %12s %14s %10s\n", "stage", "calls", "total ms", "avg ns");
+    for (size_t s = 0; s < TRACE_STAGE_COUNT; s++) {
+        if (calls[s] == 0) continue;
+        fprintf(info, "%-20s %12llu %14.3f %10llu\n", stage_names[s], (unsigned long long)calls[s],
+                (double)nanoseconds[s] / 1e6, (unsigned long long)(nanoseconds[s] / calls[s]));
+    }
+    if (dropped > 0) fprintf(info, "%zu spans dropped (per-thread limit)\n", dropped);
+
+    int status = trace_path ? write_trace(trace_path) : 0;
+    while (threads) {
+        TraceThread* next = threads->next;
+        free(threads->events);
+        free(threads);
+        threads = next;
+    }
+    pthread_setspecific(thread_key, NULL);
+    free(trace_path);
+    trace_path = NULL;
+    return status;
+}
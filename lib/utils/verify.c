@@ -0,0 +1,194 @@
+#include "../../include/utils/verify.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "../../include/common/config.h"
+#include "../../include/common/failures.h"
+#include "../../include/crypto/cipher_context.h"
+#include "../../include/utils/buffer_pool.h"
+#include "../../include/utils/fileio.h"
+#include "../../include/utils/memory_budget.h"
+#include "../../include/utils/stream.h"
+#include "../../include/utils/thread_pool.h"
+
+typedef struct {
+    const char* path;
+    const GhashKey* key;
+    const char* prefix;  // stands in for the first prefix_len bytes of the range
+    size_t prefix_len;
+    unsigned long long offset;
+    unsigned long long length;
+    unsigned char y[GHASH_BLOCK_SIZE];
+    int status;
+} VerifySegment;
+
+// Every task opens its own handle, so segments are read without sharing
+// a file position
+static void hash_segment(void* arg){
+    VerifySegment* segment = arg;
+    segment->status = -1;
+    FILE* file = open_file(segment->path, "rb");
+    unsigned char* buffer = buffer_pool_get(STREAM_BUFFER_SIZE);
+
+    if (file && buffer && seek_file(file, segment->offset + segment->prefix_len) == 0) {
+        GhashState state;
+        unsigned long long remaining = segment->length - segment->prefix_len;
+        ghash_start(&state, segment->key);
+        ghash_update(&state, segment->prefix, segment->prefix_len);
+        while (remaining > 0) {
+            size_t want = remaining < STREAM_BUFFER_SIZE ? (size_t)remaining : STREAM_BUFFER_SIZE;
+            size_t got = fread(buffer, 1, want, file);
+            if (got == 0) break;
+            ghash_update(&state, buffer, got);
+            remaining -= got;
+        }
+        if (remaining == 0) {
+            ghash_flush(&state, segment->y);
+            segment->status = 0;
+        }
+    }
+    if (file) fclose(file);
+    buffer_pool_put(buffer, STREAM_BUFFER_SIZE);
+}
+
+// Header, payload length and trailer are checked before any hashing so a
+// wrong key or a truncated file is reported at once
+static int read_frame(const char* path, const StreamKeys* keys, unsigned long long file_size, ContainerHeader* found,
+                      unsigned long long* plain_length, char tag[MAC_TAG_HEX_SIZE + 1]){
+    unsigned char header_text[CONTAINER_HEADER_SIZE];
+    unsigned char trailer[MAC_TRAILER_SIZE];
+
+    FILE* file = open_file(path, "rb");
+    if (!file) return -1;
+    size_t got = fread(header_text, 1, CONTAINER_HEADER_SIZE, file);
+    int parsed = container_header_parse(header_text, got, found);
+    int status = -1;
+    if (parsed == 0) {
+        fprintf(stderr, "%s has no container header and cannot be verified\n", path);
+    } else if (parsed > 0 && !container_key_matches(found, &keys->header)) {
+        fprintf(stderr, WRONG_KEY_FAILURE);
+    } else if (parsed > 0 && !(found->flags & CONTAINER_FLAG_MAC)) {
+        fprintf(stderr, "%s was written without a MAC and cannot be verified\n", path);
+    } else if (parsed > 0) {
+        unsigned long long header_size = container_header_size(found);
+        if (file_size < header_size + MAC_TRAILER_SIZE
+            || seek_file(file, file_size - MAC_TRAILER_SIZE) != 0
+            || fread(trailer, 1, MAC_TRAILER_SIZE, file) != MAC_TRAILER_SIZE
+            || mac_parse_trailer(trailer, plain_length, tag) != 0) {
+            fprintf(stderr, "Missing or damaged MAC trailer\n");
+        } else if (file_size - header_size - MAC_TRAILER_SIZE
+                   != (unsigned long long)axon_encrypted_size((size_t)*plain_length)) {
+            fprintf(stderr, MAC_FAILURE);
+        } else {
+            status = 0;
+        }
+    }
+    fclose(file);
+    return status;
+}
+
+int verify_hash_range(const char* path, const GhashKey* key, const char* prefix, size_t prefix_len,
+                      unsigned long long length, size_t num_threads, unsigned char y_out[GHASH_BLOCK_SIZE]){
+    size_t count = (size_t)((length + VERIFY_SEGMENT_SIZE - 1) / VERIFY_SEGMENT_SIZE);
+    memset(y_out, 0, GHASH_BLOCK_SIZE);
+    if (count == 0) return 0;
+
+    VerifySegment* segments = calloc(count, sizeof(VerifySegment));
+    if (num_threads == 0) num_threads = default_thread_count();
+    if (num_threads > count) num_threads = count;
+    // More workers than buffers that fit would only queue on the budget
+    num_threads = memory_budget_fit(num_threads, buffer_pool_charge(STREAM_BUFFER_SIZE) + BUFSIZ);
+    ThreadPool* pool = segments ? thread_pool_create(num_threads) : NULL;
+    if (!pool) {
+        if (!segments) fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        free(segments);
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        segments[i].path = path;
+        segments[i].key = key;
+        segments[i].offset = (unsigned long long)i * VERIFY_SEGMENT_SIZE;
+        segments[i].length = length - segments[i].offset < VERIFY_SEGMENT_SIZE
+                                 ? length - segments[i].offset : VERIFY_SEGMENT_SIZE;
+        segments[i].status = -1;
+        if (i == 0) {
+            segments[i].prefix = prefix;
+            segments[i].prefix_len = prefix_len < segments[i].length ? prefix_len : (size_t)segments[i].length;
+        }
+        if (thread_pool_submit(pool, hash_segment, &segments[i]) != 0) break;
+    }
+    thread_pool_wait(pool);
+    thread_pool_destroy(pool);
+
+    // Horner's rule over the segments: Y = Y * H^blocks(segment) ^ Y_segment
+    int status = 0;
+    for (size_t i = 0; i < count; i++) {
+        unsigned char power[GHASH_BLOCK_SIZE];
+        if (segments[i].status != 0) {
+            fprintf(stderr, FILE_PROCESSING_FAILURE);
+            status = -1;
+            break;
+        }
+        ghash_power(key, (segments[i].length + GHASH_BLOCK_SIZE - 1) / GHASH_BLOCK_SIZE, power);
+        ghash_multiply(y_out, power);
+        for (size_t b = 0; b < GHASH_BLOCK_SIZE; b++) {
+            y_out[b] ^= segments[i].y[b];
+        }
+    }
+    free(segments);
+    return status;
+}
+
+int verify_container(const char* path, const StreamKeys* keys, size_t num_threads, ContainerHeader* found,
+                     VerifyResult* result){
+    struct stat info;
+    MacKey mac_key;
+    char file_key[BLOCK_SIZE];
+    char header_text[CONTAINER_HEADER_SIZE];
+    char tag[MAC_TAG_HEX_SIZE + 1];
+
+    memset(result, 0, sizeof(VerifyResult));
+    if (stat(path, &info) != 0 || !S_ISREG(info.st_mode)) {
+        fprintf(stderr, FILE_PROCESSING_FAILURE);
+        return -1;
+    }
+    result->file_size = (unsigned long long)info.st_size;
+    if (read_frame(path, keys, result->file_size, found, &result->plain_length, tag) != 0
+        || stream_file_key(keys, found, file_key) != 0) {
+        return -1;
+    }
+    mac_key_init(&mac_key, file_key);
+    memset(file_key, 0, sizeof(file_key));
+    container_header_format_authenticated(found, header_text);
+
+    // Everything up to the tag itself is authenticated; the key slot is
+    // read as the MAC saw it, blanked
+    unsigned long long message_length = result->file_size - (MAC_TRAILER_SIZE - MAC_AUTHENTICATED_PREFIX);
+    unsigned char y[GHASH_BLOCK_SIZE];
+    int status = verify_hash_range(path, &mac_key.hash_key, header_text, container_header_size(found),
+                                   message_length, num_threads, y);
+    if (status == 0) {
+        char expected[MAC_TAG_HEX_SIZE + 1];
+        mac_tag_from_hash(&mac_key, y, message_length, expected);
+        if (!mac_tags_equal(tag, expected)) {
+            fprintf(stderr, MAC_FAILURE);
+            status = -1;
+        }
+    }
+    result->segments = (size_t)((message_length + VERIFY_SEGMENT_SIZE - 1) / VERIFY_SEGMENT_SIZE);
+    mac_key_wipe(&mac_key);
+    return status;
+}
+
+int verify_file(const char* path, const char* password, size_t num_threads, VerifyResult* result){
+    StreamKeys keys;
+    ContainerHeader found;
+
+    memset(result, 0, sizeof(VerifyResult));
+    if (stream_keys_init(&keys, password) != 0) return -1;
+    int status = verify_container(path, &keys, num_threads, &found, result);
+    stream_keys_wipe(&keys);
+    return status;
+}
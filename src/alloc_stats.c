@@ -0,0 +1,41 @@
+#include "alloc_stats.h"
+#include <stddef.h>
+
+#ifdef AXON_COUNT_ALLOCS
+static unsigned long long allocations;
+static unsigned long long allocated_bytes;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+
+static void count_allocation(size_t size){
+    __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&allocated_bytes, size, __ATOMIC_RELAXED);
+}
+
+void* __wrap_malloc(size_t size){
+    count_allocation(size);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size){
+    count_allocation(count * size);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size){
+    count_allocation(size);
+    return __real_realloc(pointer, size);
+}
+
+void alloc_stats_get(long long* count, long long* bytes){
+    *count = (long long)__atomic_load_n(&allocations, __ATOMIC_RELAXED);
+    *bytes = (long long)__atomic_load_n(&allocated_bytes, __ATOMIC_RELAXED);
+}
+#else
+void alloc_stats_get(long long* count, long long* bytes){
+    *count = -1;
+    *bytes = -1;
+}
+#endif
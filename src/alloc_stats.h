@@ -0,0 +1,9 @@
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+// Counts of malloc, calloc and realloc calls made by axon itself. Only
+// builds linked with --wrap (GNU ld, see CMakeLists.txt) count; elsewhere
+// both stay at -1.
+void alloc_stats_get(long long* count, long long* bytes);
+
+#endif // ALLOC_STATS_H
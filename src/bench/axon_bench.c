@@ -0,0 +1,201 @@
+// axon_bench: times the cipher kernels one at a time and, where the host
+// allows perf_event_open, reports hardware counters next to throughput so
+// that SIMD variants can be compared on more than wall time.
+//
+//   axon_bench [--iterations=N] [--json] [kernel ...]
+//
+// Variants compiled without their extension forward to a lower one (see
+// diffusion_simd.c), and kernels the CPU cannot run are skipped.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../include/common/config.h"
+#include "../../include/common/optimization.h"
+#include "../../include/crypto/confusion.h"
+#include "../../include/crypto/diffusion.h"
+#include "../../include/crypto/diffusion_simd.h"
+#include "../../include/crypto/encryptor.h"
+#include "../../include/crypto/key_expansion.h"
+#include "../../include/utils/conversion.h"
+#include "../../include/utils/perf_counters.h"
+
+#define DEFAULT_ITERATIONS 200000
+
+extern void mix_columns_original(char** state);
+
+typedef struct {
+    char* state[STATE_SIZE];
+    char rows[STATE_SIZE][STATE_SIZE];
+    char key[BLOCK_SIZE + 1];
+    char expanded_key[EXPANDED_KEY_SIZE];
+    char hex[BLOCK_HEX_SIZE];
+} BenchInput;
+
+typedef struct {
+    const char* name;
+    void (*run)(BenchInput* input);
+    int (*supported)(const CPUFeatures* features);
+} BenchKernel;
+
+static void run_mix_columns_original(BenchInput* input){ mix_columns_original(input->state); }
+static void run_mix_columns_sse2(BenchInput* input){ mix_columns_sse2(input->state); }
+static void run_mix_columns_avx(BenchInput* input){ mix_columns_avx(input->state); }
+static void run_mix_columns_avx2(BenchInput* input){ mix_columns_avx2(input->state); }
+static void run_sub_bytes(BenchInput* input){ sub_bytes(input->state); }
+static void run_shift_rows(BenchInput* input){ shift_rows(input->state); }
+static void run_add_round_key(BenchInput* input){
+    add_round_key(input->state, (const uint8_t*)input->expanded_key);
+}
+static void run_key_expansion(BenchInput* input){
+    expand_key(input->key, BLOCK_SIZE, input->expanded_key, EXPANDED_KEY_SIZE);
+}
+static void run_hex(BenchInput* input){
+    bytes_to_hex_into((const unsigned char*)input->rows, BLOCK_SIZE, input->hex);
+}
+static void run_block(BenchInput* input){ single_state_encyption(input->state, input->key); }
+
+static int any_cpu(const CPUFeatures* features){ (void)features; return 1; }
+static int sse2_cpu(const CPUFeatures* features){ return HAS_SSE2(features); }
+static int avx_cpu(const CPUFeatures* features){ return HAS_AVX(features); }
+static int avx2_cpu(const CPUFeatures* features){ return HAS_AVX2(features); }
+
+static const BenchKernel kernels[] = {
+    {"mix_columns_original", run_mix_columns_original, any_cpu},
+    {"mix_columns_sse2", run_mix_columns_sse2, sse2_cpu},
+    {"mix_columns_avx", run_mix_columns_avx, avx_cpu},
+    {"mix_columns_avx2", run_mix_columns_avx2, avx2_cpu},
+    {"sub_bytes", run_sub_bytes, any_cpu},
+    {"shift_rows", run_shift_rows, any_cpu},
+    {"add_round_key", run_add_round_key, any_cpu},
+    {"key_expansion", run_key_expansion, any_cpu},
+    {"hex_conversion", run_hex, any_cpu},
+    {"block_encrypt", run_block, any_cpu},
+};
+
+static double now_seconds(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static void reset_input(BenchInput* input){
+    memset(input, 0, sizeof(BenchInput));
+    for (size_t i = 0; i < STATE_SIZE; i++) {
+        input->state[i] = input->rows[i];
+        for (size_t j = 0; j < STATE_SIZE; j++) {
+            input->rows[i][j] = (char)(i * STATE_SIZE + j + 1);
+        }
+    }
+    memcpy(input->key, "axon-bench-key16", BLOCK_SIZE);
+    expand_key(input->key, BLOCK_SIZE, input->expanded_key, EXPANDED_KEY_SIZE);
+}
+
+// Per-operation figures, or n/a where the counter is missing
+static void print_per_op(const PerfSample* sample, PerfCounter counter, double scale, size_t iterations){
+    if (sample->valid[counter]) printf(" %10.2f", (double)sample->value[counter] * scale / (double)iterations);
+    else printf(" %10s", "n/a");
+}
+
+static void print_text(const char* name, double seconds, size_t iterations, const PerfSample* sample){
+    printf("%-22s %9.1f %10.1f", name, seconds * 1e9 / (double)iterations,
+           (double)iterations * BLOCK_SIZE / 1e6 / seconds);
+    print_per_op(sample, PERF_CYCLES, 1.0, iterations);
+    if (sample->valid[PERF_CYCLES] && sample->valid[PERF_INSTRUCTIONS] && sample->value[PERF_CYCLES] > 0) {
+        printf(" %6.2f", (double)sample->value[PERF_INSTRUCTIONS] / (double)sample->value[PERF_CYCLES]);
+    } else {
+        printf(" %6s", "n/a");
+    }
+    print_per_op(sample, PERF_L1D_MISSES, 1000.0, iterations);
+    print_per_op(sample, PERF_LLC_MISSES, 1000.0, iterations);
+    print_per_op(sample, PERF_BRANCH_MISSES, 1000.0, iterations);
+    printf("\n");
+}
+
+static void print_json(const char* name, double seconds, size_t iterations, const PerfSample* sample){
+    printf("{\"kernel\":\"%s\",\"iterations\":%zu,\"ns_per_op\":%.3f,\"mb_per_second\":%.3f",
+           name, iterations, seconds * 1e9 / (double)iterations, (double)iterations * BLOCK_SIZE / 1e6 / seconds);
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        if (sample->valid[c]) printf(",\"%s\":%llu", perf_counter_name((PerfCounter)c), (unsigned long long)sample->value[c]);
+        else printf(",\"%s\":null", perf_counter_name((PerfCounter)c));
+    }
+    if (sample->valid[PERF_CYCLES] && sample->valid[PERF_INSTRUCTIONS] && sample->value[PERF_CYCLES] > 0) {
+        printf(",\"ipc\":%.3f", (double)sample->value[PERF_INSTRUCTIONS] / (double)sample->value[PERF_CYCLES]);
+    } else {
+        printf(",\"ipc\":null");
+    }
+    printf("}\n");
+}
+
+static int selected(const char* name, int argc, const char* argv[], int first_kernel){
+    if (first_kernel >= argc) return 1;
+    for (int i = first_kernel; i < argc; i++) {
+        if (strcmp(argv[i], name) == 0) return 1;
+    }
+    return 0;
+}
+
+int main(int argc, const char* argv[]) {
+    size_t iterations = DEFAULT_ITERATIONS;
+    int json = 0;
+    int first_kernel = 1;
+
+    for (; first_kernel < argc && strncmp(argv[first_kernel], "--", 2) == 0; first_kernel++) {
+        const char* arg = argv[first_kernel];
+        if (strncmp(arg, "--iterations=", 13) == 0) {
+            char* end = NULL;
+            iterations = strtoul(arg + 13, &end, 10);
+            if (!end || *end != '\0' || iterations == 0) {
+                fprintf(stderr, "Invalid iteration count: %s\n", arg + 13);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(arg, "--json") == 0) {
+            json = 1;
+        } else {
+            fprintf(stderr, "Usage: %s [--iterations=N] [--json] [kernel ...]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    init_optimization_settings(&g_opt_settings);
+    const CPUFeatures* features = &get_optimization_settings()->cpu_features;
+
+    PerfCounters counters;
+    if (perf_counters_open(&counters) < PERF_COUNTER_COUNT) {
+        fprintf(stderr, "Hardware counters: %d of %d available (perf_event_open restricted or unsupported)\n",
+                counters.opened, PERF_COUNTER_COUNT);
+    }
+    if (!json) {
+        printf("%-22s %9s %10s %10s %6s %10s %10s %10s\n", "kernel", "ns/op", "MB/s", "cycles/op", "IPC",
+               "L1D/1k", "LLC/1k", "brmiss/1k");
+    }
+
+    BenchInput input;
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        const BenchKernel* kernel = &kernels[k];
+        if (!selected(kernel->name, argc, argv, first_kernel)) continue;
+        if (!kernel->supported(features)) {
+            fprintf(stderr, "Skipping %s: not supported by this CPU\n", kernel->name);
+            continue;
+        }
+        reset_input(&input);
+        for (size_t i = 0; i < iterations / 10 + 1; i++) {
+            kernel->run(&input);
+        }
+
+        PerfSample sample;
+        perf_counters_start(&counters);
+        double started = now_seconds();
+        for (size_t i = 0; i < iterations; i++) {
+            kernel->run(&input);
+        }
+        double seconds = now_seconds() - started;
+        perf_counters_stop(&counters, &sample);
+
+        if (json) print_json(kernel->name, seconds, iterations, &sample);
+        else print_text(kernel->name, seconds, iterations, &sample);
+    }
+    perf_counters_close(&counters);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+#include "cli_options.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/utils/checkpoint.h"
+#include "../include/utils/memory_budget.h"
+
+static int parse_size(const char* value, size_t* out){
+    char* end = NULL;
+    unsigned long long parsed = strtoull(value, &end, 10);
+    if (end == value || *end != '\0') return -1;
+    *out = (size_t)parsed;
+    return 0;
+}
+
+// Options are --name=value and may appear anywhere; they are removed from
+// argv so the positional arguments keep their usual indexes
+int parse_cli_options(int* argc, const char* argv[], CliOptions* options){
+    memset(options, 0, sizeof(CliOptions));
+
+    int kept = 1;
+    for (int i = 1; i < *argc; i++) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--", 2) != 0) {
+            argv[kept++] = arg;
+            continue;
+        }
+        if (strncmp(arg, "--threads=", 10) == 0) {
+            if (parse_size(arg + 10, &options->threads) != 0) {
+                fprintf(stderr, "Invalid thread count: %s\n", arg + 10);
+                return -1;
+            }
+        } else if (strncmp(arg, "--member=", 9) == 0) {
+            options->member = arg + 9;
+        } else if (strncmp(arg, "--cache=", 8) == 0) {
+            options->cache = arg + 8;
+        } else if (strncmp(arg, "--cache-check=", 14) == 0) {
+            if (strcmp(arg + 14, "stat") == 0) {
+                options->cache_verify_hash = 0;
+            } else if (strcmp(arg + 14, "hash") == 0) {
+                options->cache_verify_hash = 1;
+            } else {
+                fprintf(stderr, "Invalid cache check: %s\n", arg + 14);
+                return -1;
+            }
+        } else if (strcmp(arg, "--checkpoint") == 0) {
+            options->checkpoint_interval = CHECKPOINT_DEFAULT_INTERVAL;
+        } else if (strncmp(arg, "--checkpoint=", 13) == 0) {
+            size_t megabytes = 0;
+            if (parse_size(arg + 13, &megabytes) != 0 || megabytes == 0) {
+                fprintf(stderr, "Invalid checkpoint interval: %s\n", arg + 13);
+                return -1;
+            }
+            options->checkpoint_interval = (unsigned long long)megabytes * 1024 * 1024;
+        } else if (strcmp(arg, "--resume") == 0) {
+            options->resume = 1;
+        } else if (strcmp(arg, "--sparse") == 0) {
+            options->sparse = 1;
+        } else if (strcmp(arg, "--compress") == 0) {
+            options->compress = 1;
+        } else if (strcmp(arg, "--trace") == 0) {
+            options->trace = 1;
+        } else if (strncmp(arg, "--trace=", 8) == 0 && arg[8] != '\0') {
+            options->trace = 1;
+            options->trace_file = arg + 8;
+        } else if (strcmp(arg, "--stats") == 0 || strcmp(arg, "--stats=text") == 0) {
+            options->stats = CLI_STATS_TEXT;
+        } else if (strcmp(arg, "--stats=json") == 0) {
+            options->stats = CLI_STATS_JSON;
+        } else if (strncmp(arg, "--metrics-file=", 15) == 0 && arg[15] != '\0') {
+            options->metrics_file = arg + 15;
+        } else if (strcmp(arg, "--progress") == 0) {
+            options->progress_interval = 1.0;
+        } else if (strncmp(arg, "--progress=", 11) == 0) {
+            char* end = NULL;
+            options->progress_interval = strtod(arg + 11, &end);
+            if (end == arg + 11 || *end != '\0' || !(options->progress_interval >= 0.05)) {
+                fprintf(stderr, "Invalid progress interval: %s\n", arg + 11);
+                return -1;
+            }
+        } else if (strncmp(arg, "--max-memory=", 13) == 0) {
+            if (memory_budget_parse(arg + 13, &options->max_memory) != 0) {
+                fprintf(stderr, "Invalid memory limit: %s\n", arg + 13);
+                return -1;
+            }
+        } else if (strncmp(arg, "--cpus=", 7) == 0 && arg[7] != '\0') {
+            options->cpus = arg + 7;
+        } else if (strcmp(arg, "--numa=local") == 0) {
+            options->numa_local = 1;
+        } else if (strcmp(arg, "--allow-unauthenticated") == 0) {
+            options->allow_unauthenticated = 1;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            return -1;
+        }
+    }
+    *argc = kept;
+    argv[kept] = NULL;
+    return 0;
+}
+
+void print_cli_options(void){
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --threads=N   Worker threads for batch mode (default: one per CPU)\n");
+    fprintf(stderr, "  --member=NAME Extract only this member of a bundle (destination may be -)\n");
+    fprintf(stderr, "  --cache=FILE  Batch mode: skip files unchanged since the run that wrote FILE\n");
+    fprintf(stderr, "  --cache-check=stat|hash\n");
+    fprintf(stderr, "                Trust size/mtime/inode alone (default) or also re-hash each source\n");
+    fprintf(stderr, "  --checkpoint[=MB]\n");
+    fprintf(stderr, "                File encryption: sync the output and save a checkpoint every MB (default 256)\n");
+    fprintf(stderr, "  --resume      Continue an interrupted checkpointed encryption\n");
+    fprintf(stderr, "  --sparse      File encryption: skip the holes of a sparse source (restored on decryption)\n");
+    fprintf(stderr, "  --compress    Encryption: compress the plaintext first (undone on decryption)\n");
+    fprintf(stderr, "  --trace[=FILE]\n");
+    fprintf(stderr, "                Time each stage, print the totals on exit and write FILE as Chrome trace JSON\n");
+    fprintf(stderr, "  --stats[=text|json]\n");
+    fprintf(stderr, "                Report bytes, time, throughput, memory and chosen kernels on stderr\n");
+    fprintf(stderr, "  --metrics-file=FILE\n");
+    fprintf(stderr, "                Write the same report to FILE as JSON\n");
+    fprintf(stderr, "  --progress[=SECONDS]\n");
+    fprintf(stderr, "                Report progress, throughput and ETA on stderr every SECONDS (default 1)\n");
+    fprintf(stderr, "  --max-memory=SIZE\n");
+    fprintf(stderr, "                Keep the process under SIZE bytes (K, M, G suffixes) by running fewer\n");
+    fprintf(stderr, "                workers and buffers, waiting for memory rather than exceeding it\n");
+    fprintf(stderr, "  --cpus=LIST   Pin workers to these CPUs, e.g. 0-7,16-23 (threads default to their count)\n");
+    fprintf(stderr, "  --numa=local  Keep every worker and its buffers on one NUMA node\n");
+    fprintf(stderr, "  --allow-unauthenticated\n");
+    fprintf(stderr, "                Decryption: accept legacy files that carry no MAC\n");
+}
@@ -0,0 +1,32 @@
+#ifndef CLI_OPTIONS_H
+#define CLI_OPTIONS_H
+
+#include <stddef.h>
+
+#define CLI_STATS_TEXT 1
+#define CLI_STATS_JSON 2
+
+typedef struct {
+    size_t threads;
+    const char* member;
+    const char* cache;
+    int cache_verify_hash;
+    unsigned long long checkpoint_interval;  // bytes; 0 when checkpointing is off
+    int resume;
+    int sparse;
+    int compress;
+    int trace;
+    const char* trace_file;  // Chrome trace-event JSON; NULL for counters only
+    int stats;               // 0, CLI_STATS_TEXT or CLI_STATS_JSON
+    const char* metrics_file;
+    double progress_interval; // seconds between progress reports; 0 when off
+    unsigned long long max_memory;  // bytes for the whole process; 0 for no limit
+    const char* cpus;        // CPU list workers are pinned to; NULL for any
+    int numa_local;
+    int allow_unauthenticated;
+} CliOptions;
+
+int parse_cli_options(int* argc, const char* argv[], CliOptions* options);
+void print_cli_options(void);
+
+#endif // CLI_OPTIONS_H
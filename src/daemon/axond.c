@@ -0,0 +1,589 @@
+// axond: resident job server so that small jobs do not pay process startup,
+// CPU feature detection and dispatch resolution on every invocation.
+//
+// Protocol (one request per line, fields separated by tabs, key last):
+//   ENCRYPT\t<source>\t<destination>\t<key>
+//   DECRYPT\t<source>\t<destination>\t<key>
+//   ENCRYPT_FD\t<key>     (input and output descriptors passed via SCM_RIGHTS)
+//   DECRYPT_FD\t<key>
+//   PING
+// Replies:
+//   ACCEPTED <id>             once the job is queued
+//   DONE <id> OK|FAILED       when the job finishes (may arrive out of order)
+//   ERROR <message>           for malformed requests
+//   PONG
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "../../include/common/config.h"
+#include "../../include/common/failures.h"
+#include "../../include/common/optimization.h"
+#include "../../include/crypto/diffusion_simd.h"
+#include "../../include/crypto/password_simd.h"
+#include "../../include/utils/fileio.h"
+#include "../../include/utils/memory_budget.h"
+#include "../../include/utils/stream.h"
+#include "../../include/utils/thread_pool.h"
+
+#define AXOND_SOCKET_NAME "axond.sock"
+#define AXOND_PATH_MAX 4096
+#define AXOND_MAX_CLIENTS 64
+#define AXOND_LINE_MAX 4096
+#define AXOND_MAX_PASSED_FDS 16
+#define AXOND_POLL_TIMEOUT_MS 500
+// A client with this much unsent output is not read from until it catches up
+#define AXOND_OUTPUT_HIGH_WATER (64 * 1024)
+
+typedef struct {
+    int fd;
+    char buffer[AXOND_LINE_MAX];
+    size_t buffered;
+    int passed_fds[AXOND_MAX_PASSED_FDS];
+    size_t num_passed_fds;
+    int draining; // no more requests are read; it goes once its replies are out
+    // Replies are appended to queued under lock by whichever thread makes
+    // them; only the poll loop writes, from sending, without the lock
+    char* queued;
+    size_t queued_len;
+    size_t queued_capacity;
+    char* sending;
+    size_t sending_len;
+    size_t sending_capacity;
+    size_t sent;
+    int refs; // the poll loop holds one, every in-flight job holds one
+    pthread_mutex_t lock;
+} Client;
+
+typedef struct {
+    unsigned long id;
+    int encrypt;
+    char* source;
+    char* destination;
+    int in_fd;
+    int out_fd;
+    char* password;
+    Client* client;
+} Job;
+
+static volatile sig_atomic_t running = 1;
+// Written by workers to wake the poll loop for their replies
+static int wake_fds[2] = {-1, -1};
+
+static void handle_signal(int signum){
+    (void)signum;
+    running = 0;
+}
+
+static void wake_poll_loop(void){
+    char byte = 0;
+    // A full pipe already has a wakeup pending
+    if (write(wake_fds[1], &byte, 1) < 0) return;
+}
+
+static int set_nonblocking(int fd){
+    int flags = fcntl(fd, F_GETFL);
+    return flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0 ? -1 : 0;
+}
+
+static void client_reply(Client* client, const char* message){
+    size_t len = strlen(message);
+    int queued = 1;
+    pthread_mutex_lock(&client->lock);
+    if (client->queued_len + len > client->queued_capacity) {
+        size_t capacity = client->queued_capacity ? client->queued_capacity : 256;
+        while (capacity < client->queued_len + len) capacity *= 2;
+        char* grown = realloc(client->queued, capacity);
+        if (grown) {
+            client->queued = grown;
+            client->queued_capacity = capacity;
+        } else {
+            queued = 0;
+        }
+    }
+    if (queued) {
+        memcpy(client->queued + client->queued_len, message, len);
+        client->queued_len += len;
+    }
+    pthread_mutex_unlock(&client->lock);
+    if (!queued) {
+        // Hang up rather than leave the client waiting for a lost reply
+        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+        shutdown(client->fd, SHUT_RDWR);
+    }
+    wake_poll_loop();
+}
+
+// Bytes not yet written; busy is set while jobs still hold the client
+static size_t client_pending(Client* client, int* busy){
+    pthread_mutex_lock(&client->lock);
+    size_t pending = client->queued_len + client->sending_len - client->sent;
+    *busy = client->refs > 1;
+    pthread_mutex_unlock(&client->lock);
+    return pending;
+}
+
+// Writes what the socket takes without blocking; 0 while it can still be written to
+static int flush_client(Client* client){
+    for (;;) {
+        if (client->sent == client->sending_len) {
+            pthread_mutex_lock(&client->lock);
+            char* buffer = client->sending;
+            size_t capacity = client->sending_capacity;
+            client->sending = client->queued;
+            client->sending_len = client->queued_len;
+            client->sending_capacity = client->queued_capacity;
+            client->queued = buffer;
+            client->queued_len = 0;
+            client->queued_capacity = capacity;
+            pthread_mutex_unlock(&client->lock);
+            client->sent = 0;
+            if (client->sending_len == 0) return 0;
+        }
+        ssize_t n = write(client->fd, client->sending + client->sent, client->sending_len - client->sent);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+        if (n <= 0) return -1; // client went away, its results are dropped
+        client->sent += (size_t)n;
+    }
+}
+
+static void client_release(Client* client){
+    pthread_mutex_lock(&client->lock);
+    int refs = --client->refs;
+    pthread_mutex_unlock(&client->lock);
+    if (refs > 0) {
+        // A draining client may be waiting on this job to go
+        wake_poll_loop();
+        return;
+    }
+
+    for (size_t i = 0; i < client->num_passed_fds; i++) {
+        close(client->passed_fds[i]);
+    }
+    close(client->fd);
+    pthread_mutex_destroy(&client->lock);
+    free(client->queued);
+    free(client->sending);
+    free(client);
+}
+
+static void free_job(Job* job){
+    if (job->password) {
+        memset(job->password, 0, strlen(job->password));
+        free(job->password);
+    }
+    free(job->source);
+    free(job->destination);
+    free(job);
+}
+
+static void run_job(void* arg){
+    Job* job = arg;
+    FILE* in = NULL;
+    FILE* out = NULL;
+    AtomicFile output;
+    memset(&output, 0, sizeof(output));
+
+    if (job->source) {
+        // Clients polling the destination never see a half-written file
+        in = open_stream(job->source, "rb");
+        AxonCipherMode mode = job->encrypt ? AXON_ENCRYPT : AXON_DECRYPT;
+        if (in && atomic_open(&output, job->destination, stream_output_size(mode, job->source)) == 0) {
+            out = output.file;
+        }
+    } else {
+        in = fdopen(job->in_fd, "rb");
+        if (!in) close(job->in_fd);
+        out = fdopen(job->out_fd, "wb");
+        if (!out) close(job->out_fd);
+    }
+
+    int status = EXIT_FAILURE;
+    if (in && out) {
+        status = job->encrypt ? stream_encrypt(in, out, job->password)
+                              : stream_decrypt(in, out, job->password);
+    }
+    if (in) close_stream(in);
+    if (job->source) {
+        if (status == EXIT_SUCCESS && atomic_commit(&output) != 0) status = EXIT_FAILURE;
+        atomic_abort(&output);
+    } else if (out && close_stream(out) != 0) {
+        status = EXIT_FAILURE;
+    }
+
+    char reply[64];
+    snprintf(reply, sizeof(reply), "DONE %lu %s\n", job->id,
+             status == EXIT_SUCCESS ? "OK" : "FAILED");
+    client_reply(job->client, reply);
+    client_release(job->client);
+    free_job(job);
+}
+
+static char* next_field(char** cursor){
+    char* field = *cursor;
+    if (!field) return NULL;
+    char* tab = strchr(field, '\t');
+    if (tab) {
+        *tab = '\0';
+        *cursor = tab + 1;
+    } else {
+        *cursor = NULL;
+    }
+    return field;
+}
+
+static void handle_request(Client* client, char* line, ThreadPool* pool, unsigned long* next_id){
+    char* cursor = line;
+    char* command = next_field(&cursor);
+
+    if (strcmp(command, "PING") == 0) {
+        client_reply(client, "PONG\n");
+        return;
+    }
+
+    int encrypt = strncmp(command, "ENCRYPT", 7) == 0;
+    if (!encrypt && strncmp(command, "DECRYPT", 7) != 0) {
+        client_reply(client, "ERROR unknown command\n");
+        return;
+    }
+    int by_fd = strcmp(command + 7, "_FD") == 0;
+    if (!by_fd && command[7] != '\0') {
+        client_reply(client, "ERROR unknown command\n");
+        return;
+    }
+
+    Job* job = calloc(1, sizeof(Job));
+    if (!job) {
+        client_reply(client, "ERROR out of memory\n");
+        return;
+    }
+    job->encrypt = encrypt;
+    job->in_fd = -1;
+    job->out_fd = -1;
+
+    if (by_fd) {
+        if (client->num_passed_fds < 2) {
+            client_reply(client, "ERROR expected two passed file descriptors\n");
+            free(job);
+            return;
+        }
+        job->in_fd = client->passed_fds[0];
+        job->out_fd = client->passed_fds[1];
+        client->num_passed_fds -= 2;
+        memmove(client->passed_fds, client->passed_fds + 2, client->num_passed_fds * sizeof(int));
+    } else {
+        char* source = next_field(&cursor);
+        char* destination = next_field(&cursor);
+        if (!source || !destination || !cursor) {
+            client_reply(client, "ERROR expected source, destination and key\n");
+            free(job);
+            return;
+        }
+        if (strcmp(source, STDIO_PATH) == 0 || strcmp(destination, STDIO_PATH) == 0) {
+            client_reply(client, "ERROR use ENCRYPT_FD/DECRYPT_FD to stream through descriptors\n");
+            free(job);
+            return;
+        }
+        job->source = strdup(source);
+        job->destination = strdup(destination);
+    }
+    // The key is the remainder of the line so it may itself contain tabs
+    job->password = cursor ? strdup(cursor) : NULL;
+    if (!job->password || (!by_fd && (!job->source || !job->destination))) {
+        client_reply(client, "ERROR missing key or out of memory\n");
+        if (job->in_fd >= 0) close(job->in_fd);
+        if (job->out_fd >= 0) close(job->out_fd);
+        free_job(job);
+        return;
+    }
+
+    job->id = (*next_id)++;
+    job->client = client;
+    pthread_mutex_lock(&client->lock);
+    client->refs++;
+    pthread_mutex_unlock(&client->lock);
+
+    char reply[64];
+    snprintf(reply, sizeof(reply), "ACCEPTED %lu\n", job->id);
+    client_reply(client, reply);
+
+    if (thread_pool_submit(pool, run_job, job) != 0) {
+        snprintf(reply, sizeof(reply), "DONE %lu FAILED\n", job->id);
+        client_reply(client, reply);
+        if (job->in_fd >= 0) close(job->in_fd);
+        if (job->out_fd >= 0) close(job->out_fd);
+        client_release(client);
+        free_job(job);
+    }
+}
+
+// Returns 0 while the client stays connected; at end of input it drains
+static int read_client(Client* client, ThreadPool* pool, unsigned long* next_id){
+    char control[CMSG_SPACE(AXOND_MAX_PASSED_FDS * sizeof(int))];
+    struct iovec iov;
+    struct msghdr msg;
+
+    iov.iov_base = client->buffer + client->buffered;
+    iov.iov_len = sizeof(client->buffer) - client->buffered;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n = recvmsg(client->fd, &msg, 0);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+    if (n < 0) return -1;
+    if (n == 0) {
+        // A half-closed client still gets the replies to what it sent
+        client->draining = 1;
+        return 0;
+    }
+
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        int* fds = (int*)CMSG_DATA(cmsg);
+        for (size_t i = 0; i < count; i++) {
+            if (client->num_passed_fds < AXOND_MAX_PASSED_FDS) {
+                client->passed_fds[client->num_passed_fds++] = fds[i];
+            } else {
+                close(fds[i]);
+            }
+        }
+    }
+
+    client->buffered += (size_t)n;
+    char* line = client->buffer;
+    char* newline;
+    while ((newline = memchr(line, '\n', client->buffered - (size_t)(line - client->buffer))) != NULL) {
+        *newline = '\0';
+        if (newline > line && newline[-1] == '\r') newline[-1] = '\0';
+        if (*line != '\0') handle_request(client, line, pool, next_id);
+        line = newline + 1;
+    }
+    size_t remaining = client->buffered - (size_t)(line - client->buffer);
+    memmove(client->buffer, line, remaining);
+    client->buffered = remaining;
+
+    if (client->buffered == sizeof(client->buffer)) {
+        client_reply(client, "ERROR request line too long\n");
+        client->draining = 1;
+    }
+    return 0;
+}
+
+// $XDG_RUNTIME_DIR belongs to the user alone; /tmp is shared, so the name
+// there carries the uid
+static void default_socket_path(char* path, size_t size){
+    const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir && *runtime_dir) {
+        snprintf(path, size, "%s/%s", runtime_dir, AXOND_SOCKET_NAME);
+    } else {
+        snprintf(path, size, "/tmp/axond-%lu.sock", (unsigned long)getuid());
+    }
+}
+
+// Only a socket nobody answers on is replaced, never a running server's
+// or anything that is not a socket
+static int remove_stale_socket(const char* socket_path, const struct sockaddr_un* addr){
+    struct stat info;
+    if (lstat(socket_path, &info) != 0) return 0;
+    if (!S_ISSOCK(info.st_mode)) {
+        fprintf(stderr, "%s exists and is not a socket\n", socket_path);
+        return -1;
+    }
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe < 0) {
+        perror("socket");
+        return -1;
+    }
+    int connected = connect(probe, (const struct sockaddr*)addr, sizeof(*addr)) == 0;
+    int error = errno;
+    close(probe);
+    if (connected) {
+        fprintf(stderr, "axond is already listening on %s\n", socket_path);
+        return -1;
+    }
+    if (error != ECONNREFUSED) {
+        fprintf(stderr, "%s: %s\n", socket_path, strerror(error));
+        return -1;
+    }
+    if (unlink(socket_path) != 0 && errno != ENOENT) {
+        perror(socket_path);
+        return -1;
+    }
+    return 0;
+}
+
+static int open_listener(const char* socket_path){
+    struct sockaddr_un addr;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", socket_path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    if (remove_stale_socket(socket_path, &addr) != 0) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, AXOND_MAX_CLIENTS) != 0) {
+        perror(socket_path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void print_usage(const char* program_name){
+    fprintf(stderr, "Usage: %s [socket_path] [worker_threads] [max_memory]\n", program_name);
+    fprintf(stderr, "  socket_path     Unix domain socket to listen on (default $XDG_RUNTIME_DIR/%s,\n", AXOND_SOCKET_NAME);
+    fprintf(stderr, "                  or /tmp/axond-<uid>.sock without it)\n");
+    fprintf(stderr, "  worker_threads  Number of workers (default: one per online CPU)\n");
+    fprintf(stderr, "  max_memory      Memory limit with K, M or G suffix; jobs wait for buffers beyond it\n");
+}
+
+int main(int argc, const char* argv[]){
+    if (argc > 4) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    char default_path[AXOND_PATH_MAX];
+    default_socket_path(default_path, sizeof(default_path));
+    const char* socket_path = argc > 1 ? argv[1] : default_path;
+    size_t num_workers = argc > 2 ? (size_t)strtoul(argv[2], NULL, 10) : 0;
+    unsigned long long max_memory = 0;
+    if (argc > 3 && (memory_budget_parse(argv[3], &max_memory) != 0 || memory_budget_init(max_memory) != 0)) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Resolve every kernel once up front; workers only ever see warm dispatch
+    init_optimization_settings(&g_opt_settings);
+    init_diffusion_simd();
+    init_password_simd();
+
+    if (pipe(wake_fds) != 0 || set_nonblocking(wake_fds[0]) != 0 || set_nonblocking(wake_fds[1]) != 0) {
+        perror("pipe");
+        return EXIT_FAILURE;
+    }
+    ThreadPool* pool = thread_pool_create(num_workers);
+    if (!pool) return EXIT_FAILURE;
+
+    int listen_fd = open_listener(socket_path);
+    if (listen_fd < 0) {
+        thread_pool_destroy(pool);
+        return EXIT_FAILURE;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+    fprintf(stderr, "axond listening on %s with %zu workers\n", socket_path, thread_pool_size(pool));
+
+    Client* clients[AXOND_MAX_CLIENTS] = {0};
+    struct pollfd poll_fds[AXOND_MAX_CLIENTS + 2];
+    size_t polled[AXOND_MAX_CLIENTS]; // client slot behind poll_fds[p + 2]
+    unsigned long next_id = 1;
+
+    while (running) {
+        size_t num_poll = 0;
+        poll_fds[num_poll].fd = listen_fd;
+        poll_fds[num_poll++].events = POLLIN;
+        poll_fds[num_poll].fd = wake_fds[0];
+        poll_fds[num_poll++].events = POLLIN;
+        for (size_t i = 0; i < AXOND_MAX_CLIENTS; i++) {
+            if (!clients[i]) continue;
+            int busy = 0;
+            size_t pending = client_pending(clients[i], &busy);
+            if (clients[i]->draining && pending == 0 && !busy) {
+                client_release(clients[i]);
+                clients[i] = NULL;
+                continue;
+            }
+            short events = 0;
+            if (!clients[i]->draining && pending < AXOND_OUTPUT_HIGH_WATER) events |= POLLIN;
+            if (pending > 0) events |= POLLOUT;
+            polled[num_poll - 2] = i;
+            poll_fds[num_poll].fd = clients[i]->fd;
+            poll_fds[num_poll++].events = events;
+        }
+
+        int ready = poll(poll_fds, num_poll, AXOND_POLL_TIMEOUT_MS);
+        if (ready < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+        if (ready <= 0) continue;
+
+        if (poll_fds[1].revents & POLLIN) {
+            char drained[64];
+            while (read(wake_fds[0], drained, sizeof(drained)) > 0) continue;
+        }
+
+        if (poll_fds[0].revents & POLLIN) {
+            int client_fd = accept(listen_fd, NULL, NULL);
+            size_t slot = 0;
+            while (slot < AXOND_MAX_CLIENTS && clients[slot]) slot++;
+            if (client_fd >= 0 && (slot == AXOND_MAX_CLIENTS || set_nonblocking(client_fd) != 0)) {
+                close(client_fd);
+            } else if (client_fd >= 0) {
+                Client* client = calloc(1, sizeof(Client));
+                if (!client) {
+                    fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
+                    close(client_fd);
+                } else {
+                    client->fd = client_fd;
+                    client->refs = 1;
+                    pthread_mutex_init(&client->lock, NULL);
+                    clients[slot] = client;
+                }
+            }
+        }
+
+        for (size_t p = 2; p < num_poll; p++) {
+            short revents = poll_fds[p].revents;
+            Client* client = clients[polled[p - 2]];
+            int alive = !(revents & POLLERR);
+            if (alive && ((revents & POLLIN) || ((revents & POLLHUP) && !client->draining))) {
+                alive = read_client(client, pool, &next_id) == 0;
+            } else if (revents & POLLHUP) {
+                alive = 0; // gone for good, nobody is left to read the replies
+            }
+            // Replies to what was just read usually go out right away
+            if (alive) alive = flush_client(client) == 0;
+            if (!alive) {
+                client_release(client);
+                clients[polled[p - 2]] = NULL;
+            }
+        }
+    }
+
+    fprintf(stderr, "axond shutting down, finishing queued jobs\n");
+    close(listen_fd);
+    unlink(socket_path);
+    thread_pool_destroy(pool);
+    for (size_t i = 0; i < AXOND_MAX_CLIENTS; i++) {
+        if (!clients[i]) continue;
+        flush_client(clients[i]); // best effort, a client that is not reading loses the rest
+        client_release(clients[i]);
+    }
+    close(wake_fds[0]);
+    close(wake_fds[1]);
+    return EXIT_SUCCESS;
+}
@@ -2,25 +2,45 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <stdint.h>
+#include <sys/stat.h>
 #include <time.h>
 #include "../include/common/config.h"
 #include "../include/common/failures.h"
-#include "../include/utils/memory.h"
-#include "../include/crypto/password.h"
-#include "../include/utils/conversion.h"
-#include "../include/crypto/encryptor.h"
-#include "../include/crypto/decryptor.h"
-#include "../include/crypto/chunked_file.h"
-#include "../include/crypto/key_expansion.h"
-#include "../include/crypto/confusion.h"
 #include "../include/common/optimization.h"
+#include "../include/crypto/container.h"
 #include "../include/crypto/diffusion_simd.h"
-
-#define STATE_SIZE 4
+#include "../include/utils/stream.h"
+#include "../include/utils/batch.h"
+#include "../include/utils/batch_cache.h"
+#include "../include/utils/bundle.h"
+#include "../include/utils/checkpoint.h"
+#include "../include/utils/in_place.h"
+#include "../include/utils/incremental.h"
+#include "../include/utils/memory_budget.h"
+#include "../include/utils/parallel_decrypt.h"
+#include "../include/utils/progress.h"
+#include "../include/utils/sparse.h"
+#include "../include/utils/stats.h"
+#include "../include/utils/thread_pool.h"
+#include "../include/utils/topology.h"
+#include "../include/utils/trace.h"
+#include "../include/utils/verify.h"
+#include "alloc_stats.h"
+#include "cli_options.h"
 
 void print_usage(const char* program_name) {
-    fprintf(stderr, "Usage: %s <source_file> <destination_file> <key> <e/d> [optimization_level]\n", program_name);
+    fprintf(stderr, "Usage: %s [options] <source_file> <destination_file> <key> <e/d> [optimization_level]\n", program_name);
+    fprintf(stderr, "       %s [options] batch <source_dir|file_list> <destination_dir> <key> <e/d> [optimization_level]\n", program_name);
+    fprintf(stderr, "       %s [options] bundle <source_dir|file_list> <bundle_file> <key> e [optimization_level]\n", program_name);
+    fprintf(stderr, "       %s [options] bundle <bundle_file> <destination_dir> <key> d [optimization_level]\n", program_name);
+    fprintf(stderr, "       %s [options] incremental <source_file> <store_dir> <key> e [optimization_level]\n", program_name);
+    fprintf(stderr, "       %s [options] incremental <store_dir> <destination_file> <key> d [optimization_level]\n", program_name);
+    fprintf(stderr, "       %s [options] verify <encrypted_file> <key>\n", program_name);
+    fprintf(stderr, "       %s rekey <encrypted_file> <old_key> <new_key>\n", program_name);
+    fprintf(stderr, "       %s [options] in-place <file> <key> <e/d>\n", program_name);
+    fprintf(stderr, "Use - as source_file or destination_file to read stdin or write stdout\n");
+    fprintf(stderr, "A batch file_list has one source path per line, optionally followed by a tab and its destination\n");
+    print_cli_options();
     fprintf(stderr, "Optimization levels:\n");
     fprintf(stderr, "  0 - No SIMD (scalar code)\n");
     fprintf(stderr, "  1 - SSE2\n");
@@ -29,33 +49,292 @@ void print_usage(const char* program_name) {
     fprintf(stderr, "  auto - Automatic selection based on CPU (default)\n");
 }
 
-int main(int argc, const char* argv[]) {
+static double wall_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+// The total is the source's size when it is a regular file; batch mode
+// fills it in once the plan is known and anything else runs without one.
+// Runners stop it before their summary so the two never share a line.
+static int start_progress(const char* source, const CliOptions* options) {
+    if (options->progress_interval <= 0) return 0;
+    struct stat info;
+    unsigned long long total = 0;
+    if (source && strcmp(source, STDIO_PATH) != 0 && stat(source, &info) == 0 && S_ISREG(info.st_mode)) {
+        total = (unsigned long long)info.st_size;
+    }
+    return progress_start(total, options->progress_interval, stderr);
+}
+
+static int run_batch(const char* argv[], const CliOptions* options, FILE* info) {
+    int encrypting = strcmp(argv[4], "e") == 0;
+    if (!encrypting && strcmp(argv[4], "d") != 0) {
+        fprintf(stderr, "Invalid operation\n");
+        return EXIT_FAILURE;
+    }
+
+    double start_time = wall_seconds();
+    BatchPlan plan;
+    if (batch_plan_load(&plan, argv[1], argv[2]) != 0) {
+        fprintf(stderr, FILE_PROCESSING_FAILURE);
+        return EXIT_FAILURE;
+    }
+
+    AxonCipherMode mode = encrypting ? AXON_ENCRYPT : AXON_DECRYPT;
+    BatchCache cache;
+    memset(&cache, 0, sizeof(cache));
+    if (options->cache) {
+        if (batch_cache_load(&cache, options->cache, mode, argv[3]) != 0) {
+            batch_plan_free(&plan);
+            return EXIT_FAILURE;
+        }
+        batch_cache_apply(&cache, &plan, options->cache_verify_hash);
+    }
+    if (options->progress_interval > 0) {
+        unsigned long long total = 0;
+        for (size_t i = 0; i < plan.count; i++) {
+            if (plan.entries[i].status != BATCH_ENTRY_SKIPPED) total += plan.entries[i].size;
+        }
+        progress_set_total(total);
+    }
+
+    BatchResult result;
+    int status = batch_run(&plan, mode, argv[3], options->threads, &result);
+    if (status == 0 && options->cache) {
+        batch_cache_record(&cache, &plan, options->cache_verify_hash);
+        if (batch_cache_save(&cache, options->cache) != 0) status = -1;
+    }
+    batch_cache_free(&cache);
+    batch_plan_free(&plan);
+    if (status != 0) return EXIT_FAILURE;
+
+    double elapsed = wall_seconds() - start_time;
+    progress_stop();
+    fprintf(info, "Batch %s finished: %zu succeeded, %zu failed, %zu unchanged\n",
+            encrypting ? "encryption" : "decryption", result.succeeded, result.failed, result.skipped);
+    fprintf(info, "Processed %llu bytes in %.5f seconds\n", result.bytes, elapsed);
+    return result.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int run_bundle(const char* argv[], const CliOptions* options, FILE* info) {
+    int encrypting = strcmp(argv[4], "e") == 0;
+    if (!encrypting && strcmp(argv[4], "d") != 0) {
+        fprintf(stderr, "Invalid operation\n");
+        return EXIT_FAILURE;
+    }
+
+    double start_time = wall_seconds();
+    BatchResult result;
+    int status = encrypting ? bundle_pack(argv[1], argv[2], argv[3], &result)
+                            : bundle_extract(argv[1], argv[2], options->member, argv[3], &result);
+    if (status != 0) return EXIT_FAILURE;
+
+    double elapsed = wall_seconds() - start_time;
+    progress_stop();
+    fprintf(info, "Bundle %s finished: %zu succeeded, %zu failed\n",
+            encrypting ? "packing" : "extraction", result.succeeded, result.failed);
+    fprintf(info, "Processed %llu bytes in %.5f seconds\n", result.bytes, elapsed);
+    return result.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int run_incremental(const char* argv[], FILE* info) {
+    int encrypting = strcmp(argv[4], "e") == 0;
+    if (!encrypting && strcmp(argv[4], "d") != 0) {
+        fprintf(stderr, "Invalid operation\n");
+        return EXIT_FAILURE;
+    }
+
+    double start_time = wall_seconds();
+    IncrementalResult result;
+    int status = encrypting ? incremental_encrypt(argv[1], argv[2], argv[3], &result)
+                            : incremental_decrypt(argv[1], argv[2], argv[3], &result);
+    if (status != 0) return EXIT_FAILURE;
+
+    double elapsed = wall_seconds() - start_time;
+    progress_stop();
+    if (encrypting) {
+        fprintf(info, "Incremental encryption finished: %zu chunks, %zu reused, %zu written, %zu removed\n",
+                result.chunks, result.reused, result.written, result.removed);
+        fprintf(info, "Read %llu bytes, wrote %llu bytes in %.5f seconds\n",
+                result.bytes_in, result.bytes_written, elapsed);
+    } else {
+        fprintf(info, "Incremental decryption finished: %zu chunks, %llu bytes in %.5f seconds\n",
+                result.chunks, result.bytes_written, elapsed);
+    }
+    return EXIT_SUCCESS;
+}
+
+static int run_checkpointed(const char* argv[], const CliOptions* options, FILE* info) {
+    if (strcmp(argv[4], "e") != 0 || strcmp(argv[1], STDIO_PATH) == 0 || strcmp(argv[2], STDIO_PATH) == 0) {
+        fprintf(stderr, "--checkpoint and --resume apply to file-to-file encryption only\n");
+        return EXIT_FAILURE;
+    }
+    CheckpointOptions checkpoint_options;
+    checkpoint_options.interval = options->checkpoint_interval;
+    checkpoint_options.resume = options->resume;
+    checkpoint_options.threads = options->threads;
+
+    double start_time = wall_seconds();
+    CheckpointResult result;
+    if (checkpoint_encrypt(argv[1], argv[2], argv[3], &checkpoint_options, &result) != 0) {
+        return EXIT_FAILURE;
+    }
+    double elapsed = wall_seconds() - start_time;
+    progress_stop();
+    if (result.resumed_at > 0) fprintf(info, "Resumed at byte %llu\n", result.resumed_at);
+    fprintf(info, "Encryption completed successfully! Output written to: %s\n", argv[2]);
+    fprintf(info, "Encrypted %llu bytes with %zu checkpoints in %.5f seconds\n",
+            result.bytes, result.checkpoints, elapsed);
+    return EXIT_SUCCESS;
+}
+
+static int run_sparse(const char* argv[], FILE* info) {
+    if (strcmp(argv[4], "e") != 0 || strcmp(argv[1], STDIO_PATH) == 0 || strcmp(argv[2], STDIO_PATH) == 0) {
+        fprintf(stderr, "--sparse applies to file-to-file encryption; decryption restores holes on its own\n");
+        return EXIT_FAILURE;
+    }
+    double start_time = wall_seconds();
+    SparseResult result;
+    if (sparse_encrypt(argv[1], argv[2], argv[3], &result) != 0) return EXIT_FAILURE;
+    double elapsed = wall_seconds() - start_time;
+    progress_stop();
+    fprintf(info, "Encryption completed successfully! Output written to: %s\n", argv[2]);
+    fprintf(info, "Encrypted %llu data bytes in %zu extents of a %llu byte file in %.5f seconds\n",
+            result.data_bytes, result.extents, result.apparent_size, elapsed);
+    return EXIT_SUCCESS;
+}
+
+// Returns -1 when the file has to be streamed instead
+static int run_parallel_decrypt(const char* argv[], size_t threads, FILE* info) {
+    double start_time = wall_seconds();
+    ParallelResult result;
+    int status = parallel_decrypt_file(argv[1], argv[2], argv[3], threads, &result);
+    if (status > 0) return -1;
+    if (status != 0) return EXIT_FAILURE;
+    double elapsed = wall_seconds() - start_time;
+    progress_stop();
+    fprintf(info, "Decryption completed successfully! Output written to: %s\n", argv[2]);
+    fprintf(info, "Decrypted %llu bytes in %zu regions in %.5f seconds\n", result.plain_length, result.regions, elapsed);
+    return EXIT_SUCCESS;
+}
+
+static int run_verify(const char* path, const char* password, const CliOptions* options) {
+    double start_time = wall_seconds();
+    VerifyResult result;
+    if (verify_file(path, password, options->threads, &result) != 0) {
+        fprintf(stderr, "Verification failed: %s\n", path);
+        return EXIT_FAILURE;
+    }
+    double elapsed = wall_seconds() - start_time;
+    progress_stop();
+    fprintf(stdout, "Verified %s: %llu bytes of plaintext, %zu segments\n", path, result.plain_length, result.segments);
+    fprintf(stdout, "Checked %llu bytes in %.5f seconds\n", result.file_size, elapsed);
+    return EXIT_SUCCESS;
+}
+
+static int run_in_place(const char* argv[], const CliOptions* options) {
+    int encrypting = strcmp(argv[4], "e") == 0;
+    if (!encrypting && strcmp(argv[4], "d") != 0) {
+        fprintf(stderr, "Invalid operation\n");
+        return EXIT_FAILURE;
+    }
+    double start_time = wall_seconds();
+    InPlaceResult result;
+    int status = encrypting ? in_place_encrypt(argv[2], argv[3], &result)
+                            : in_place_decrypt(argv[2], argv[3], options->threads, &result);
+    if (status != 0) {
+        fprintf(stderr, "In-place %s failed: %s\n",
+                encrypting ? "encryption" : "decryption", argv[2]);
+        return EXIT_FAILURE;
+    }
+    double elapsed = wall_seconds() - start_time;
+    progress_stop();
+    fprintf(stdout, "%s completed successfully! Rewrote %s in place\n", encrypting ? "Encryption" : "Decryption", argv[2]);
+    fprintf(stdout, "%s%llu bytes of plaintext in %zu windows in %.5f seconds; the file is now %llu bytes\n",
+            result.resumed ? "Resumed; " : "", result.plain_length, result.windows, elapsed, result.file_size);
+    return EXIT_SUCCESS;
+}
+
+static int run_command(int argc, const char* argv[], const CliOptions* options) {
     int forced_level = -1;
+    const char* program_name = argv[0];
+
+    // verify only needs the file and the key
+    if (argc > 1 && strcmp(argv[1], "verify") == 0) {
+        if (argc != 4) {
+            print_usage(program_name);
+            return EXIT_FAILURE;
+        }
+        init_optimization_settings(&g_opt_settings);
+        init_diffusion_simd();
+        if (start_progress(argv[2], options) != 0) return EXIT_FAILURE;
+        return run_verify(argv[2], argv[3], options);
+    }
+
+    // in-place rewrites one file, so it has no destination
+    if (argc > 1 && strcmp(argv[1], "in-place") == 0) {
+        if (argc != 5) {
+            print_usage(program_name);
+            return EXIT_FAILURE;
+        }
+        init_optimization_settings(&g_opt_settings);
+        init_diffusion_simd();
+        if (start_progress(argv[2], options) != 0) return EXIT_FAILURE;
+        return run_in_place(argv, options);
+    }
+
+    // rekey only rewrites the header, so it needs no optimization settings
+    if (argc > 1 && strcmp(argv[1], "rekey") == 0) {
+        if (argc != 5) {
+            print_usage(program_name);
+            return EXIT_FAILURE;
+        }
+        if (container_rekey(argv[2], argv[3], argv[4]) != 0) {
+            fprintf(stderr, "Rekey failed: %s\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+        fprintf(stdout, "Rekeyed %s\n", argv[2]);
+        return EXIT_SUCCESS;
+    }
+
+    // Subcommands take the usual positional arguments after their name
+    const char* command = NULL;
+    if (argc > 1 && (strcmp(argv[1], "batch") == 0 || strcmp(argv[1], "bundle") == 0
+                     || strcmp(argv[1], "incremental") == 0)) {
+        command = argv[1];
+        argv++;
+        argc--;
+    }
     
     if (argc < 5 || argc > 6) {
-        print_usage(argv[0]);
+        print_usage(program_name);
         return EXIT_FAILURE;
     }
+
+    // Keep stdout clean for the payload when it is the destination
+    FILE* info = strcmp(argv[2], STDIO_PATH) == 0 ? stderr : stdout;
     
     if (argc == 6) {
         if (strcmp(argv[5], "0") == 0) {
             forced_level = OPT_LEVEL_NONE;
-            printf("Forcing optimization level: NONE (scalar code)\n");
+            fprintf(info, "Forcing optimization level: NONE (scalar code)\n");
         } else if (strcmp(argv[5], "1") == 0) {
             forced_level = OPT_LEVEL_SSE2;
-            printf("Forcing optimization level: SSE2\n");
+            fprintf(info, "Forcing optimization level: SSE2\n");
         } else if (strcmp(argv[5], "2") == 0) {
             forced_level = OPT_LEVEL_AVX;
-            printf("Forcing optimization level: AVX\n");
+            fprintf(info, "Forcing optimization level: AVX\n");
         } else if (strcmp(argv[5], "3") == 0) {
             forced_level = OPT_LEVEL_AVX2;
-            printf("Forcing optimization level: AVX2\n");
+            fprintf(info, "Forcing optimization level: AVX2\n");
         } else if (strcmp(argv[5], "auto") == 0) {
             forced_level = -1;
-            printf("Using automatic optimization level selection\n");
+            fprintf(info, "Using automatic optimization level selection\n");
         } else {
             fprintf(stderr, "Invalid optimization level: %s\n", argv[5]);
-            print_usage(argv[0]);
+            print_usage(program_name);
             return EXIT_FAILURE;
         }
     }
@@ -64,157 +343,103 @@ int main(int argc, const char* argv[]) {
     
     if (forced_level >= 0) {
         g_opt_settings.current_level = forced_level;
-        printf("Optimization level overridden to: %d\n", forced_level);
+        fprintf(info, "Optimization level overridden to: %d\n", forced_level);
     }
     
     init_diffusion_simd();
 
-    clock_t start_time = clock();
+    if (options->compress && (command != NULL || options->sparse || options->checkpoint_interval > 0
+                             || options->resume || strcmp(argv[4], "e") != 0)) {
+        fprintf(stderr, "--compress applies to plain encryption; decryption decompresses on its own\n");
+        return EXIT_FAILURE;
+    }
 
-    if (argc != 5 && argc != 6) {
-        print_usage(argv[0]);
+    if (start_progress(command != NULL && strcmp(command, "batch") == 0 ? NULL : argv[1], options) != 0) {
         return EXIT_FAILURE;
     }
 
-    int status = EXIT_SUCCESS;
-    
-    char **state = allocate_matrix_memory(STATE_SIZE, STATE_SIZE);
-    init_state(argv[1], state);
+    if (command != NULL) {
+        if (strcmp(command, "bundle") == 0) return run_bundle(argv, options, info);
+        if (strcmp(command, "incremental") == 0) return run_incremental(argv, info);
+        return run_batch(argv, options, info);
+    }
 
-    char* final_pass = validate_password(argv[3]);
-    char **password = allocate_matrix_memory(STATE_SIZE, STATE_SIZE);
+    if (options->sparse && (options->checkpoint_interval > 0 || options->resume)) {
+        fprintf(stderr, "--sparse cannot be combined with --checkpoint or --resume\n");
+        return EXIT_FAILURE;
+    }
+    if (options->sparse) return run_sparse(argv, info);
+    if (options->checkpoint_interval > 0 || options->resume) return run_checkpointed(argv, options, info);
 
-    for (size_t i = 0; i < STATE_SIZE; i++){
-        for (size_t j = 0; j < STATE_SIZE; j++){
-           state[i][j] ^= final_pass[i * STATE_SIZE + j];
-        }
+    // Every file mode runs through the stream engine, which frames the
+    // ciphertext with the container header and rejects a wrong key up front
+    int encrypting = strcmp(argv[4], "e") == 0;
+    if (!encrypting && strcmp(argv[4], "d") != 0) {
+        fprintf(stderr, "Invalid operation\n");
+        return EXIT_FAILURE;
+    }
+    // Decryption needs no chain from earlier blocks, so a file on disk can
+    // be split across threads and written in place
+    if (!encrypting && strcmp(argv[1], STDIO_PATH) != 0 && strcmp(argv[2], STDIO_PATH) != 0) {
+        size_t threads = options->threads ? options->threads : default_thread_count();
+        int status = threads > 1 ? run_parallel_decrypt(argv, threads, info) : -1;
+        if (status >= 0) return status;
     }
-    char* flat_state = malloc(STATE_SIZE * STATE_SIZE * sizeof(char));
-    if (flat_state == NULL) {
-        fprintf(stderr, MEMORY_ALLOCATION_FAILURE);
-        free_matrix_memory(password, STATE_SIZE);
-        free_matrix_memory(state, STATE_SIZE);
+    // The output is written beside the destination and renamed over it on
+    // success, so a failed run (e.g. a wrong key) leaves it untouched
+    FILE* in = open_stream(argv[1], "rb");
+    AtomicFile out;
+    unsigned long long expected = options->compress ? 0
+                                : stream_output_size(encrypting ? AXON_ENCRYPT : AXON_DECRYPT, argv[1]);
+    if (!in || atomic_open(&out, argv[2], expected) != 0) {
+        if (in) close_stream(in);
+        fprintf(stderr, FILE_PROCESSING_FAILURE);
         return EXIT_FAILURE;
     }
-
-    for (size_t i = 0; i < STATE_SIZE; i++) {
-        for (size_t j = 0; j < STATE_SIZE; j++) {
-            flat_state[i * STATE_SIZE + j] = state[i][j];
-        }
+    int status = encrypting ? stream_encrypt_flags(in, out.file, argv[3], options->compress ? CONTAINER_FLAG_COMPRESSED : 0)
+                            : stream_decrypt(in, out.file, argv[3]);
+    close_stream(in);
+    if (status == EXIT_SUCCESS && atomic_commit(&out) != 0) status = EXIT_FAILURE;
+    atomic_abort(&out);
+    progress_stop();
+    if (status == EXIT_SUCCESS) {
+        fprintf(info, "%s completed successfully! Output written to: %s\n",
+                encrypting ? "Encryption" : "Decryption",
+                strcmp(argv[2], STDIO_PATH) == 0 ? "stdout" : argv[2]);
     }
+    return status;
+}
 
-    char* hexarg = bytes_to_hex((unsigned char*)flat_state, STATE_SIZE * STATE_SIZE);
-    write_file(argv[2], hexarg, STATE_SIZE * STATE_SIZE * 2);
+int main(int argc, const char* argv[]) {
+    CliOptions options;
 
-    free_matrix_memory(password, STATE_SIZE);
-    free_matrix_memory(state, STATE_SIZE);
-    
+    if (parse_cli_options(&argc, argv, &options) != 0) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (options.max_memory && memory_budget_init(options.max_memory) != 0) return EXIT_FAILURE;
+    if ((options.cpus || options.numa_local) && placement_configure(options.cpus, options.numa_local) != 0) {
+        return EXIT_FAILURE;
+    }
+    if (options.trace && trace_start(options.trace_file) != 0) return EXIT_FAILURE;
+    stream_allow_unauthenticated(options.allow_unauthenticated);
+    stats_start();
 
-    if(strcmp(argv[4], "e") == 0){
-        ChunkedFile chunked_file = file_chunker(argv[1]);
-        if (!chunked_file.state || chunked_file.num_state == 0) {
-            fprintf(stderr, FILE_PROCESSING_FAILURE);
-            return EXIT_FAILURE;
-        }
-        char* final_pass = validate_password(argv[3]);
-        if (!final_pass) {
-            fprintf(stderr, PASSWORD_VAL_FAILURE);
-            for (size_t i = 0; i < chunked_file.num_state; i++) {
-                free_matrix_memory(chunked_file.state[i], STATE_SIZE);
-            }
-            free(chunked_file.state);
-            return EXIT_FAILURE;
-        }
-        char** encrypted_content = chain_encryptor(chunked_file.state, final_pass, STATE_SIZE, chunked_file.num_state);
-        if (!encrypted_content) {
-            fprintf(stderr, ENCRYPTION_FAILURE);
-            for (size_t i = 0; i < chunked_file.num_state; i++) {
-                free_matrix_memory(chunked_file.state[i], STATE_SIZE);
-            }
-            free(chunked_file.state);
-            free(final_pass);
-            return EXIT_FAILURE;
-        }
-        int write_result = chunk_writer(argv[2], encrypted_content, chunked_file.num_state);
-        if (write_result != 0) {
-            fprintf(stderr, FILE_WRITE_FAILURE);
-            status = EXIT_FAILURE;
-        } else {
-            printf("Encryption completed successfully! File saved to: %s\n", argv[2]);
-            double processing_time = (double)(clock() - start_time) / CLOCKS_PER_SEC;
-            printf("Processing time: %.5f seconds\n", processing_time);
-        }
-        
-        for (size_t i = 0; i < chunked_file.num_state; i++) {
-            free_matrix_memory(chunked_file.state[i], STATE_SIZE);
-            free(encrypted_content[i]);
-        }
-        free(chunked_file.state);
-        free(encrypted_content);
-        free(final_pass);
-    }
-    else if(strcmp(argv[4], "d") == 0){
-        char* encrypted_content = read_file(argv[1]);
-        if (!encrypted_content) {
-            fprintf(stderr, FILE_PROCESSING_FAILURE);
-            return EXIT_FAILURE;
-        }
-        
-        size_t num_chunks = 0;
-        char** encrypted_chunks = parse_encrypted_file(encrypted_content, &num_chunks);
-        if (!encrypted_chunks) {
-            fprintf(stderr, FILE_PROCESSING_FAILURE);
-            free(encrypted_content);
-            return EXIT_FAILURE;
-        }
-        
-        char* final_pass = validate_password(argv[3]);
-        if (!final_pass) {
-            fprintf(stderr, PASSWORD_VAL_FAILURE);
-            for (size_t i = 0; i < num_chunks; i++) {
-                free(encrypted_chunks[i]);
-            }
-            free(encrypted_chunks);
-            free(encrypted_content);
-            return EXIT_FAILURE;
-        }
-        
-        char** decrypted_content = chain_decryptor(encrypted_chunks, final_pass, STATE_SIZE, num_chunks);
-        if (!decrypted_content) {
-            fprintf(stderr, "Decryption failed\n");
-            for (size_t i = 0; i < num_chunks; i++) {
-                free(encrypted_chunks[i]); 
-            }
-            free(encrypted_chunks);
-            free(encrypted_content);
-            free(final_pass);
-            return EXIT_FAILURE;
-        }
-        
-        int write_result = chunk_writer(argv[2], (char**)decrypted_content, num_chunks);
-        if (write_result == -1) {
-            fprintf(stderr, FILE_WRITE_FAILURE);
+    int status = run_command(argc, argv, &options);
+    progress_stop();
+
+    if (options.trace && trace_finish(stderr) != 0) status = EXIT_FAILURE;
+    if (options.stats || options.metrics_file) {
+        RunStats stats;
+        stats_collect(&stats);
+        alloc_stats_get(&stats.mallocs, &stats.malloc_bytes);
+        // On stderr: stdout may be carrying the payload
+        fflush(stdout);
+        if (options.stats == CLI_STATS_TEXT) stats_print_text(&stats, status, stderr);
+        if (options.stats == CLI_STATS_JSON) stats_print_json(&stats, status, stderr);
+        if (options.metrics_file && stats_write_json(&stats, status, options.metrics_file) != 0) {
             status = EXIT_FAILURE;
-        } else {
-            printf("Decryption completed successfully! File saved to: %s\n", argv[2]);
-            double processing_time = (double)(clock() - start_time) / CLOCKS_PER_SEC;
-            printf("Processing time: %.5f seconds\n", processing_time);
-        }
-        
-        for (size_t i = 0; i < num_chunks; i++) {
-            free(encrypted_chunks[i]); 
-            free(decrypted_content[i]);
         }
-        free(encrypted_chunks);
-        free(decrypted_content);
-        free(encrypted_content);
-        free(final_pass);
     }
-    else{
-        printf("%s\n\n\n", argv[4]);
-        fprintf(stderr, "Invalid operation\n");
-        status = EXIT_FAILURE;
-    }
-
     return status;
-}
\ No newline at end of file
+}
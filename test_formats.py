@@ -0,0 +1,270 @@
+#!/usr/bin/env python3
+
+import os
+import shutil
+import signal
+import subprocess
+import time
+import argparse
+
+PASSWORD = "password123"
+WRONG_PASSWORD = "password124"
+TEST_DIR = "./axon_test/formats"
+
+failures = []
+
+def check(condition, name):
+    """Record one named check."""
+    print(f"{'ok  ' if condition else 'FAIL'} {name}")
+    if not condition:
+        failures.append(name)
+
+def run(axon_path, *args):
+    """Run Axon and return whether it succeeded."""
+    result = subprocess.run([axon_path, *args], stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    return result.returncode == 0
+
+def read(path):
+    with open(path, 'rb') as f:
+        return f.read()
+
+def write(path, data):
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, 'wb') as f:
+        f.write(data)
+
+def remove(*paths):
+    for path in paths:
+        if os.path.isdir(path):
+            shutil.rmtree(path)
+        elif os.path.exists(path):
+            os.remove(path)
+
+def flip_byte(path, offset):
+    """Flip the bits of one byte; a negative offset counts from the end."""
+    with open(path, 'r+b') as f:
+        f.seek(offset, os.SEEK_END if offset < 0 else os.SEEK_SET)
+        position = f.tell()
+        byte = f.read(1)
+        f.seek(position)
+        f.write(bytes([byte[0] ^ 0xff]))
+
+def create_payloads():
+    """Files whose plaintext ends in NUL bytes were cut short by the old buffer API."""
+    return {
+        "empty": b"",
+        "one_nul": b"\0",
+        "trailing_nuls": b"axon\0\0\0\0\0",
+        "all_nuls": b"\0" * 4096,
+        "block_of_nuls": b"x" * 16 + b"\0" * 16,
+        "text": b"The quick brown fox jumps over the lazy dog.\n" * 2000,
+        "binary": os.urandom(200000) + b"\0" * 77,
+    }
+
+def create_sparse_file(path, size_mb):
+    """Data at the start and in the middle, a hole up to the end."""
+    remove(path)
+    with open(path, 'wb') as f:
+        f.write(os.urandom(70000))
+        f.seek(size_mb * 1024 * 1024 // 2)
+        f.write(b"middle" * 1000)
+        f.truncate(size_mb * 1024 * 1024)
+
+def test_stream(axon_path, payloads, options=(), label="stream"):
+    """Encrypt and decrypt each payload as a single container."""
+    for name, data in payloads.items():
+        source = f"{TEST_DIR}/{label}_{name}.bin"
+        encrypted = source + ".enc"
+        decrypted = source + ".dec"
+        write(source, data)
+        remove(encrypted, decrypted)
+        ok = run(axon_path, *options, source, encrypted, PASSWORD, "e") \
+            and run(axon_path, encrypted, decrypted, PASSWORD, "d")
+        check(ok and read(decrypted) == data, f"{label} round trip: {name}")
+
+    data = payloads["trailing_nuls"]
+    encrypted = f"{TEST_DIR}/{label}_trailing_nuls.bin.enc"
+    decrypted = f"{TEST_DIR}/{label}_rejected.dec"
+    remove(decrypted)
+    check(not run(axon_path, encrypted, decrypted, WRONG_PASSWORD, "d"), f"{label} rejects a wrong key")
+    flip_byte(encrypted, -60)
+    check(not run(axon_path, encrypted, decrypted, PASSWORD, "d"), f"{label} rejects a modified ciphertext")
+    check(not run(axon_path, "verify", encrypted, PASSWORD), f"{label} verify rejects a modified ciphertext")
+    check(not os.path.exists(decrypted) or read(decrypted) != data, f"{label} leaves no plaintext behind")
+
+def test_sparse(axon_path, size_mb):
+    source = f"{TEST_DIR}/sparse.img"
+    encrypted = source + ".enc"
+    decrypted = source + ".dec"
+    create_sparse_file(source, size_mb)
+    remove(encrypted, decrypted)
+    ok = run(axon_path, "--sparse", source, encrypted, PASSWORD, "e") \
+        and run(axon_path, encrypted, decrypted, PASSWORD, "d")
+    check(ok and read(decrypted) == read(source), "sparse round trip ending in a hole")
+    check(ok and os.path.getsize(encrypted) < os.path.getsize(source), "sparse output skips the holes")
+    flip_byte(encrypted, -60)
+    check(not run(axon_path, encrypted, decrypted + "2", PASSWORD, "d"), "sparse rejects a modified ciphertext")
+
+def test_checkpoint(axon_path, size_mb):
+    """Kill a checkpointed run after its first checkpoint, then resume it."""
+    source = f"{TEST_DIR}/checkpoint.bin"
+    encrypted = source + ".enc"
+    decrypted = source + ".dec"
+    write(source, os.urandom(size_mb * 1024 * 1024 - 3) + b"\0\0\0")
+    remove(encrypted, decrypted, encrypted + ".ckpt")
+    process = subprocess.Popen([axon_path, "--checkpoint=1", source, encrypted, PASSWORD, "e"],
+                               stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    while process.poll() is None and not os.path.exists(encrypted + ".ckpt"):
+        time.sleep(0.01)
+    interrupted = process.poll() is None
+    if interrupted:
+        process.send_signal(signal.SIGKILL)
+    process.wait()
+    if interrupted:
+        ok = run(axon_path, "--checkpoint=1", "--resume", source, encrypted, PASSWORD, "e")
+        check(ok, "checkpoint resume after a kill")
+    else:
+        print("     (the run finished before its first checkpoint; resume not exercised)")
+    ok = run(axon_path, encrypted, decrypted, PASSWORD, "d")
+    check(ok and read(decrypted) == read(source), "checkpoint round trip")
+    check(not os.path.exists(encrypted + ".ckpt"), "checkpoint removed once complete")
+
+def test_in_place(axon_path, payloads):
+    """The journal format: rewrite the file itself, both ways."""
+    for name in ("trailing_nuls", "binary", "text"):
+        data = payloads[name]
+        path = f"{TEST_DIR}/in_place_{name}.bin"
+        write(path, data)
+        remove(path + ".journal")
+        encrypted = run(axon_path, "in-place", path, PASSWORD, "e") and read(path) != data
+        check(encrypted and not os.path.exists(path + ".journal"), f"in-place encrypt: {name}")
+        check(run(axon_path, "in-place", path, PASSWORD, "d") and read(path) == data, f"in-place round trip: {name}")
+
+    path = f"{TEST_DIR}/in_place_tampered.bin"
+    write(path, payloads["binary"])
+    run(axon_path, "in-place", path, PASSWORD, "e")
+    flip_byte(path, 1000)
+    before = read(path)
+    check(not run(axon_path, "in-place", path, PASSWORD, "d"), "in-place rejects a modified ciphertext")
+    check(read(path) == before, "in-place leaves a rejected file untouched")
+
+def test_bundle(axon_path, payloads):
+    source = f"{TEST_DIR}/bundle_src"
+    bundle = f"{TEST_DIR}/files.axb"
+    extracted = f"{TEST_DIR}/bundle_out"
+    remove(source, bundle, extracted)
+    for name, data in payloads.items():
+        write(f"{source}/{name}.bin", data)
+    write(f"{source}/nested/deeper.bin", payloads["trailing_nuls"])
+
+    ok = run(axon_path, "bundle", source, bundle, PASSWORD, "e") \
+        and run(axon_path, "bundle", bundle, extracted, PASSWORD, "d")
+    for name, data in payloads.items():
+        path = f"{extracted}/{name}.bin"
+        check(ok and os.path.exists(path) and read(path) == data, f"bundle round trip: {name}")
+    check(ok and read(f"{extracted}/nested/deeper.bin") == payloads["trailing_nuls"], "bundle keeps directories")
+
+    member = subprocess.run([axon_path, "--member=trailing_nuls.bin", "bundle", bundle, "-", PASSWORD, "d"],
+                            capture_output=True)
+    check(member.returncode == 0 and member.stdout == payloads["trailing_nuls"], "bundle extracts one member")
+
+    remove(extracted)
+    check(not run(axon_path, "bundle", bundle, extracted, WRONG_PASSWORD, "d"), "bundle rejects a wrong key")
+    flip_byte(bundle, -20)
+    remove(extracted)
+    check(not run(axon_path, "bundle", bundle, extracted, PASSWORD, "d"), "bundle rejects a modified index")
+
+    # Members follow the header; the first one is rejected before it is written
+    remove(bundle, extracted)
+    run(axon_path, "bundle", source, bundle, PASSWORD, "e")
+    flip_byte(bundle, 200)
+    check(not run(axon_path, "bundle", bundle, extracted, PASSWORD, "d"), "bundle rejects a modified member")
+
+def test_incremental(axon_path, payloads):
+    source = f"{TEST_DIR}/incremental.bin"
+    store = f"{TEST_DIR}/store"
+    restored = f"{TEST_DIR}/incremental.dec"
+    remove(store, restored)
+    data = payloads["binary"] + payloads["text"] + b"\0" * 9
+    write(source, data)
+    ok = run(axon_path, "incremental", source, store, PASSWORD, "e") \
+        and run(axon_path, "incremental", store, restored, PASSWORD, "d")
+    check(ok and read(restored) == data, "incremental round trip")
+
+    # A second run after a small edit reuses the unchanged chunks
+    data = data[:1000] + b"edited" + data[1006:]
+    write(source, data)
+    remove(restored)
+    ok = run(axon_path, "incremental", source, store, PASSWORD, "e") \
+        and run(axon_path, "incremental", store, restored, PASSWORD, "d")
+    check(ok and read(restored) == data, "incremental round trip after an edit")
+
+    remove(restored)
+    check(not run(axon_path, "incremental", store, restored, WRONG_PASSWORD, "d"), "incremental rejects a wrong key")
+    chunks = sorted(os.path.join(root, name) for root, _, names in os.walk(store)
+                    for name in names if name.endswith(".enc"))
+    flip_byte(chunks[0], -1)
+    check(not run(axon_path, "incremental", store, restored, PASSWORD, "d"), "incremental rejects a modified chunk")
+
+def test_batch(axon_path, payloads):
+    source = f"{TEST_DIR}/batch_src"
+    encrypted = f"{TEST_DIR}/batch_enc"
+    decrypted = f"{TEST_DIR}/batch_dec"
+    remove(source, encrypted, decrypted)
+    for name, data in payloads.items():
+        write(f"{source}/{name}.bin", data)
+    ok = run(axon_path, "--threads=4", "batch", source, encrypted, PASSWORD, "e") \
+        and run(axon_path, "--threads=4", "batch", encrypted, decrypted, PASSWORD, "d")
+    for name, data in payloads.items():
+        path = f"{decrypted}/{name}.bin"
+        check(ok and os.path.exists(path) and read(path) == data, f"batch round trip: {name}")
+
+def test_memory_limit(axon_path, payloads):
+    """Batch runs under budgets around one lane of buffers must finish or refuse, never hang."""
+    source = f"{TEST_DIR}/limit_src"
+    remove(source)
+    for i in range(12):
+        write(f"{source}/file{i}.bin", payloads["trailing_nuls"] * (i * 500 + 1))
+    for threads in ("1", "4"):
+        for limit in ("2400K", "2800K", "2850K", "2900K", "3M", "3200K", "4M", "8M"):
+            destination = f"{TEST_DIR}/limit_{threads}_{limit}"
+            remove(destination)
+            name = f"batch under --max-memory={limit} with {threads} threads"
+            try:
+                result = subprocess.run([axon_path, f"--threads={threads}", f"--max-memory={limit}", "batch",
+                                         source, destination, PASSWORD, "e"],
+                                        stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, timeout=60)
+            except subprocess.TimeoutExpired:
+                check(False, f"{name} finishes")
+                continue
+            refused = result.returncode != 0 and (b"--max-memory is too small" in result.stderr
+                                                  or b"leaves nothing for buffers" in result.stderr)
+            written = os.path.isdir(destination) and len(os.listdir(destination)) == 12
+            check(refused or written, f"{name} finishes or refuses")
+            if written:
+                restored = destination + "_dec"
+                remove(restored)
+                ok = run(axon_path, "batch", destination, restored, PASSWORD, "d")
+                check(ok and all(read(f"{restored}/file{i}.bin") == read(f"{source}/file{i}.bin")
+                                 for i in range(12)), f"{name} round trip")
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Round-trip and tamper tests for every Axon format")
+    parser.add_argument("--axon", required=True, help="Path to Axon executable")
+    parser.add_argument("--size", type=int, default=4, help="Size in MB of the sparse and checkpoint files")
+    args = parser.parse_args()
+
+    os.makedirs(TEST_DIR, exist_ok=True)
+    payloads = create_payloads()
+    test_stream(args.axon, payloads)
+    test_stream(args.axon, payloads, ("--compress",), "compressed")
+    test_sparse(args.axon, args.size)
+    test_checkpoint(args.axon, args.size)
+    test_in_place(args.axon, payloads)
+    test_bundle(args.axon, payloads)
+    test_incremental(args.axon, payloads)
+    test_batch(args.axon, payloads)
+    test_memory_limit(args.axon, payloads)
+
+    print(f"\n{len(failures)} failed" if failures else "\nAll checks passed")
+    raise SystemExit(1 if failures else 0)
@@ -99,6 +99,30 @@ def benchmark_optimization_levels(axon_path, size_mb):
     
     return results
 
+def benchmark_kernels(bench_path, iterations):
+    """Run axon_bench and print per-kernel throughput with hardware counters."""
+    import json
+    print(f"\n=== Kernel benchmark ({iterations} iterations) ===\n")
+    output = subprocess.run([bench_path, "--json", f"--iterations={iterations}"],
+                            check=True, capture_output=True, text=True)
+    if output.stderr:
+        print(output.stderr.strip())
+
+    def fmt(value, spec):
+        return "n/a" if value is None else format(value, spec)
+
+    print(f"{'Kernel':<22} {'MB/s':>10} {'Cycles/op':>10} {'IPC':>6} {'L1D miss':>10} {'LLC miss':>10} {'Br miss':>10}")
+    print("-" * 84)
+    results = []
+    for line in output.stdout.splitlines():
+        row = json.loads(line)
+        results.append(row)
+        cycles = row["cycles"] / row["iterations"] if row["cycles"] is not None else None
+        print(f"{row['kernel']:<22} {row['mb_per_second']:>10.1f} {fmt(cycles, '.1f'):>10} "
+              f"{fmt(row['ipc'], '.2f'):>6} {fmt(row['l1d_misses'], 'd'):>10} "
+              f"{fmt(row['llc_misses'], 'd'):>10} {fmt(row['branch_misses'], 'd'):>10}")
+    return results
+
 def create_benchmark_chart(results, size_mb):
     """Create a bar chart comparing the benchmark results."""
     try:
@@ -142,9 +166,14 @@ if __name__ == "__main__":
                         help="Optimization level (0=None, 1=SSE2, 2=AVX, 3=AVX2, auto=Automatic)")
     parser.add_argument("--benchmark", action="store_true", 
                         help="Run benchmarks for all optimization levels")
+    parser.add_argument("--kernel-bench", metavar="AXON_BENCH",
+                        help="Also run this axon_bench binary for per-kernel hardware counters")
+    parser.add_argument("--iterations", type=int, default=200000, help="Kernel benchmark iterations")
     args = parser.parse_args()
     
     if args.benchmark:
         benchmark_optimization_levels(args.axon, args.size)
     else:
-        test_axon(args.axon, args.size, args.opt_level)
\ No newline at end of file
+        test_axon(args.axon, args.size, args.opt_level)
+    if args.kernel_bench:
+        benchmark_kernels(args.kernel_bench, args.iterations)
\ No newline at end of file
@@ -0,0 +1,140 @@
+// test_cipher_api: round trips through the in-memory library API
+// (cipher_context.h), run by ctest.
+//
+// The sealed buffer form must give back exactly what was sealed, trailing
+// NUL bytes included, and reject a wrong password or any modified byte.
+// The incremental form must not depend on how the input is sliced.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/common/config.h"
+#include "../include/crypto/cipher_context.h"
+
+#define PASSWORD "password123"
+#define WRONG_PASSWORD "password124"
+#define MAX_PLAIN 100000
+
+static int failures;
+
+static void check(int condition, const char* what, size_t n){
+    if (!condition) {
+        fprintf(stderr, "FAIL %s (%zu bytes)\n", what, n);
+        failures++;
+    }
+}
+
+// Deterministic bytes with no NUL in them; callers add the NULs they want
+static void fill(unsigned char* data, size_t n, unsigned int seed){
+    unsigned int x = seed * 2654435761u + 1;
+    for (size_t i = 0; i < n; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        data[i] = (unsigned char)(x % 255 + 1);
+    }
+}
+
+static void test_sealed(size_t n, size_t trailing_nuls){
+    unsigned char* plain = malloc(n + 1);
+    unsigned char* sealed = malloc(axon_sealed_size(n));
+    unsigned char* opened = malloc(n + 1);
+    size_t sealed_len = 0;
+    size_t opened_len = 0;
+    fill(plain, n, (unsigned int)n);
+    memset(plain + n - trailing_nuls, 0, trailing_nuls);
+
+    int status = axon_encrypt_buffer(plain, n, PASSWORD, sealed, axon_sealed_size(n), &sealed_len);
+    check(status == 0 && sealed_len == axon_sealed_size(n), "encrypt_buffer", n);
+    status = axon_decrypt_buffer(sealed, sealed_len, PASSWORD, opened, n + 1, &opened_len);
+    check(status == 0 && opened_len == n && memcmp(opened, plain, n) == 0, "decrypt_buffer round trip", n);
+
+    check(axon_decrypt_buffer(sealed, sealed_len, WRONG_PASSWORD, opened, n + 1, &opened_len) != 0,
+          "decrypt_buffer rejects a wrong password", n);
+    check(axon_decrypt_buffer(sealed, sealed_len - 1, PASSWORD, opened, n + 1, &opened_len) != 0,
+          "decrypt_buffer rejects a truncated buffer", n);
+    // One byte in the header, the payload and the MAC trailer
+    size_t offsets[3] = {20, sealed_len / 2, sealed_len - 2};
+    for (size_t i = 0; i < 3; i++) {
+        sealed[offsets[i]] ^= 0x01;
+        check(axon_decrypt_buffer(sealed, sealed_len, PASSWORD, opened, n + 1, &opened_len) != 0,
+              "decrypt_buffer rejects a modified byte", n);
+        sealed[offsets[i]] ^= 0x01;
+    }
+    check(axon_encrypt_buffer(plain, n, PASSWORD, sealed, axon_sealed_size(n) - 1, &sealed_len) != 0,
+          "encrypt_buffer rejects a short output", n);
+    free(plain);
+    free(sealed);
+    free(opened);
+}
+
+// Feeds in to a context in slices of slice bytes; returns the output length
+static size_t run_sliced(AxonCipherMode mode, const char* password, const unsigned char* in, size_t in_len,
+                         size_t slice, unsigned char* out, size_t out_capacity){
+    AxonCipherContext ctx;
+    size_t total = 0;
+    size_t produced = 0;
+    if (axon_cipher_init(&ctx, mode, password) != 0) return (size_t)-1;
+    for (size_t done = 0; done < in_len; done += slice) {
+        size_t len = in_len - done < slice ? in_len - done : slice;
+        if (axon_cipher_update(&ctx, in + done, len, out + total, out_capacity - total, &produced) != 0) {
+            return (size_t)-1;
+        }
+        total += produced;
+    }
+    if (axon_cipher_final(&ctx, out + total, out_capacity - total, &produced) != 0) return (size_t)-1;
+    axon_cipher_wipe(&ctx);
+    return total + produced;
+}
+
+static void test_incremental(size_t n, size_t trailing_nuls){
+    static const size_t slices[] = {1, 3, 7, 15, 16, 17, 31, 32, 33, 100, 4096};
+    size_t cipher_capacity = axon_encrypted_size(n) + BLOCK_HEX_SIZE;
+    unsigned char* plain = malloc(n + 1);
+    unsigned char* whole = malloc(cipher_capacity);
+    unsigned char* sliced = malloc(cipher_capacity);
+    unsigned char* opened = malloc(n + BLOCK_SIZE);
+    fill(plain, n, (unsigned int)n + 7);
+    memset(plain + n - trailing_nuls, 0, trailing_nuls);
+
+    size_t whole_len = run_sliced(AXON_ENCRYPT, PASSWORD, plain, n, n ? n : 1, whole, cipher_capacity);
+    check(whole_len == axon_encrypted_size(n), "cipher_update output size", n);
+    // The bare chain carries no length: final drops the zero padding of the
+    // last block, and with it any NULs the plaintext itself ended in
+    size_t kept = n - trailing_nuls;
+    for (size_t i = 0; i < sizeof(slices) / sizeof(slices[0]); i++) {
+        size_t len = run_sliced(AXON_ENCRYPT, PASSWORD, plain, n, slices[i], sliced, cipher_capacity);
+        check(len == whole_len && memcmp(sliced, whole, whole_len) == 0, "cipher_update slicing", n);
+        len = run_sliced(AXON_DECRYPT, PASSWORD, whole, whole_len, slices[i], opened, n + BLOCK_SIZE);
+        check(len == kept && memcmp(opened, plain, kept) == 0, "cipher_update decrypt slicing", n);
+    }
+    if (n >= BLOCK_SIZE) {
+        size_t len = run_sliced(AXON_DECRYPT, WRONG_PASSWORD, whole, whole_len, 7, opened, n + BLOCK_SIZE);
+        check(len != kept || memcmp(opened, plain, kept) != 0, "cipher_update wrong password differs", n);
+    }
+    free(plain);
+    free(whole);
+    free(sliced);
+    free(opened);
+}
+
+int main(void){
+    for (size_t n = 0; n <= 70; n++) {
+        test_sealed(n, 0);
+        if (n > 0) test_sealed(n, n % 5 + 1 < n ? n % 5 + 1 : n);
+        test_incremental(n, 0);
+    }
+    // The regression: NULs at the end of the last block were dropped
+    test_sealed(9, 3);
+    test_sealed(32, 16);
+    test_sealed(4096, 4096);
+    test_sealed(MAX_PLAIN, 77);
+    test_incremental(1000, 3);
+    test_incremental(MAX_PLAIN, 0);
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("All cipher API checks passed\n");
+    return EXIT_SUCCESS;
+}